@@ -57,6 +57,7 @@
 #include "openmm/LangevinIntegrator.h"
 #include "openmm/MonteCarloBarostat.h"
 #include "openmm/PeriodicTorsionForce.h"
+#include "openmm/PositionRestraintForce.h"
 #include "openmm/RBTorsionForce.h"
 #include "openmm/RMSDForce.h"
 #include "openmm/NonbondedForce.h"
@@ -1027,6 +1028,41 @@ public:
     virtual void copyParametersToContext(ContextImpl& context, const RMSDForce& force) = 0;
 };
 
+/**
+ * This kernel is invoked by PositionRestraintForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CalcPositionRestraintForceKernel : public KernelImpl {
+public:
+    static std::string Name() {
+        return "CalcPositionRestraintForce";
+    }
+    CalcPositionRestraintForceKernel(std::string name, const Platform& platform) : KernelImpl(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the PositionRestraintForce this kernel will be used for
+     */
+    virtual void initialize(const System& system, const PositionRestraintForce& force) = 0;
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double execute(ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the PositionRestraintForce to copy the parameters from
+     */
+    virtual void copyParametersToContext(ContextImpl& context, const PositionRestraintForce& force) = 0;
+};
+
 /**
  * This kernel is invoked by VerletIntegrator to take one time step.
  */
@@ -1507,8 +1543,9 @@ public:
      * @param numParticles the number of particles in the system
      * @param alpha        the Ewald blending parameter
      * @param deterministic whether it should attempt to make the resulting forces deterministic
+     * @param order        the order of the B-splines used to interpolate onto the grid
      */
-    virtual void initialize(int gridx, int gridy, int gridz, int numParticles, double alpha, bool deterministic) = 0;
+    virtual void initialize(int gridx, int gridy, int gridz, int numParticles, double alpha, bool deterministic, int order) = 0;
     /**
      * Begin computing the force and energy.
      *
@@ -1580,8 +1617,9 @@ public:
      * @param numParticles the number of particles in the system
      * @param alpha        the Ewald blending parameter
      * @param deterministic whether it should attempt to make the resulting forces deterministic
+     * @param order        the order of the B-splines used to interpolate onto the grid
      */
-    virtual void initialize(int gridx, int gridy, int gridz, int numParticles, double alpha, bool deterministic) = 0;
+    virtual void initialize(int gridx, int gridy, int gridz, int numParticles, double alpha, bool deterministic, int order) = 0;
     /**
      * Begin computing the force and energy.
      *
@@ -1608,6 +1646,98 @@ public:
     virtual void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const = 0;
 };
 
+/**
+ * This kernel performs both the electrostatic and the dispersion reciprocal space calculations
+ * for LJPME.  It is an alternative to using a CalcPmeReciprocalForceKernel and a
+ * CalcDispersionPmeReciprocalForceKernel, which lets an implementation share work between
+ * the two calculations, such as finding where each particle lies on the grids.
+ */
+class CalcLJPmeReciprocalForceKernel : public KernelImpl {
+public:
+    class IO;
+    static std::string Name() {
+        return "CalcLJPmeReciprocalForce";
+    }
+    CalcLJPmeReciprocalForceKernel(std::string name, const Platform& platform) : KernelImpl(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     * 
+     * @param gridx           the x size of the electrostatic PME grid
+     * @param gridy           the y size of the electrostatic PME grid
+     * @param gridz           the z size of the electrostatic PME grid
+     * @param dispersionGridx the x size of the dispersion PME grid
+     * @param dispersionGridy the y size of the dispersion PME grid
+     * @param dispersionGridz the z size of the dispersion PME grid
+     * @param numParticles    the number of particles in the system
+     * @param alpha           the Ewald blending parameter for electrostatics
+     * @param dispersionAlpha the Ewald blending parameter for dispersion
+     * @param deterministic   whether it should attempt to make the resulting forces deterministic
+     * @param order           the order of the B-splines used to interpolate onto the grids
+     */
+    virtual void initialize(int gridx, int gridy, int gridz, int dispersionGridx, int dispersionGridy, int dispersionGridz,
+            int numParticles, double alpha, double dispersionAlpha, bool deterministic, int order) = 0;
+    /**
+     * Begin computing the force and energy.
+     *
+     * @param io                  an object that coordinates data transfer
+     * @param periodicBoxVectors  the vectors defining the periodic box (measured in nm)
+     * @param includeEnergy       true if potential energy should be computed
+     */
+    virtual void beginComputation(IO& io, const Vec3* periodicBoxVectors, bool includeEnergy) = 0;
+    /**
+     * Finish computing the force and energy.
+     * 
+     * @param io   an object that coordinates data transfer
+     * @return the sum of the electrostatic and dispersion reciprocal space energies
+     */
+    virtual double finishComputation(IO& io) = 0;
+    /**
+     * Get the parameters being used for electrostatic PME.
+     * 
+     * @param alpha   the separation parameter
+     * @param nx      the number of grid points along the X axis
+     * @param ny      the number of grid points along the Y axis
+     * @param nz      the number of grid points along the Z axis
+     */
+    virtual void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const = 0;
+    /**
+     * Get the parameters being used for dispersion PME.
+     * 
+     * @param alpha   the separation parameter
+     * @param nx      the number of grid points along the X axis
+     * @param ny      the number of grid points along the Y axis
+     * @param nz      the number of grid points along the Z axis
+     */
+    virtual void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const = 0;
+};
+
+/**
+ * Any class that uses CalcLJPmeReciprocalForceKernel should create an implementation of this
+ * class, then pass it to the kernel to manage communication with it.
+ */
+class CalcLJPmeReciprocalForceKernel::IO {
+public:
+    /**
+     * Get a pointer to the atom charges and positions.  This array should contain four
+     * elements for each atom: x, y, z, and q in that order.
+     */
+    virtual float* getPosq() = 0;
+    /**
+     * Get a pointer to the dispersion coefficients.  This array should contain one element
+     * for each atom, the value that the dispersion PME calculation spreads onto its grid.
+     */
+    virtual float* getDispersionCoefficients() = 0;
+    /**
+     * Record the forces calculated by the kernel.
+     * 
+     * @param force    an array containing four elements for each atom.  The first three
+     *                 are the x, y, and z components of the total force, while the fourth
+     *                 element should be ignored.
+     */
+    virtual void setForce(float* force) = 0;
+};
+
 } // namespace OpenMM
 
 #endif /*OPENMM_KERNELS_H_*/
@@ -0,0 +1,178 @@
+#ifndef OPENMM_POSITIONRESTRAINTFORCE_H_
+#define OPENMM_POSITIONRESTRAINTFORCE_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "Force.h"
+#include "Vec3.h"
+#include <string>
+#include <vector>
+#include "internal/windowsExport.h"
+
+namespace OpenMM {
+
+/**
+ * This class restrains particles to reference positions.  The energy of each restraint is
+ *
+ * E = 0.5*s*k*max(0, r-r0)^2
+ *
+ * where r is the distance between the particle and its reference position, k is the force
+ * constant, r0 is the flat-bottom radius, and s is a global scale factor.  When r0 is 0, this
+ * is an ordinary harmonic restraint.  Otherwise the particle can move freely inside a sphere of
+ * radius r0, and is only restrained when it leaves it.
+ *
+ * The scale factor is a Context parameter, whose name is given by getScaleParameterName().  By default
+ * it is called "restraintScale" and has the value 1.  Changing it with Context::setParameter() is an inexpensive way to turn
+ * restraints on and off, or to gradually release them during equilibration.
+ *
+ * To use this class, create a PositionRestraintForce object, then call addRestraint() once for
+ * each restrained particle.  After a restraint has been added, you can modify its parameters by
+ * calling setRestraintParameters().  This will have no effect on Contexts that already exist
+ * unless you call updateParametersInContext().
+ *
+ * This computes the same energy as a CustomExternalForce with the expression
+ * "0.5*s*k*max(0, periodicdistance(x, y, z, x0, y0, z0)-r0)^2", but is much faster.
+ */
+
+class OPENMM_EXPORT PositionRestraintForce : public Force {
+public:
+    /**
+     * Create a PositionRestraintForce.
+     */
+    PositionRestraintForce();
+    /**
+     * Get the number of restraints that have been added.
+     */
+    int getNumRestraints() const {
+        return restraints.size();
+    }
+    /**
+     * Get the name of the Context parameter that scales the force constants of all restraints.
+     */
+    const std::string& getScaleParameterName() const;
+    /**
+     * Set the name of the Context parameter that scales the force constants of all restraints.
+     * Forces that use the same name share the same scale factor.
+     */
+    void setScaleParameterName(const std::string& name);
+    /**
+     * Get the default value of the scale factor.
+     */
+    double getDefaultScale() const;
+    /**
+     * Set the default value of the scale factor.  This will affect any new Contexts you create,
+     * but will have no effect on existing ones.
+     */
+    void setDefaultScale(double scale);
+    /**
+     * Add a restraint to the force.
+     *
+     * @param particle   the index of the particle to restrain
+     * @param position   the reference position of the particle, measured in nm
+     * @param k          the force constant, measured in kJ/mol/nm^2
+     * @param radius     the flat-bottom radius, measured in nm.  If this is 0, the restraint is purely harmonic.
+     * @return the index of the restraint that was added
+     */
+    int addRestraint(int particle, const Vec3& position, double k, double radius=0.0);
+    /**
+     * Get the parameters for a restraint.
+     *
+     * @param index          the index of the restraint for which to get parameters
+     * @param[out] particle  the index of the particle that is restrained
+     * @param[out] position  the reference position of the particle, measured in nm
+     * @param[out] k         the force constant, measured in kJ/mol/nm^2
+     * @param[out] radius    the flat-bottom radius, measured in nm
+     */
+    void getRestraintParameters(int index, int& particle, Vec3& position, double& k, double& radius) const;
+    /**
+     * Set the parameters for a restraint.
+     *
+     * @param index      the index of the restraint for which to set parameters
+     * @param particle   the index of the particle to restrain
+     * @param position   the reference position of the particle, measured in nm
+     * @param k          the force constant, measured in kJ/mol/nm^2
+     * @param radius     the flat-bottom radius, measured in nm.  If this is 0, the restraint is purely harmonic.
+     */
+    void setRestraintParameters(int index, int particle, const Vec3& position, double k, double radius=0.0);
+    /**
+     * Update the per-restraint parameters in a Context to match those stored in this Force object.  This method
+     * provides an efficient method to update certain parameters in an existing Context without needing to reinitialize it.
+     * Simply call setRestraintParameters() to modify this object's parameters, then call updateParametersInContext()
+     * to copy them over to the Context.
+     *
+     * This method can update the reference positions, force constants, and radii of restraints.  The set of particles
+     * that are restrained cannot be changed, nor can new restraints be added.
+     */
+    void updateParametersInContext(Context& context);
+    /**
+     * Set whether this force should apply periodic boundary conditions when calculating the distance between
+     * a particle and its reference position.
+     */
+    void setUsesPeriodicBoundaryConditions(bool periodic);
+    /**
+     * Returns whether or not this force makes use of periodic boundary
+     * conditions.
+     *
+     * @returns true if force uses PBC and false otherwise
+     */
+    bool usesPeriodicBoundaryConditions() const;
+protected:
+    ForceImpl* createImpl() const;
+private:
+    class RestraintInfo;
+    std::vector<RestraintInfo> restraints;
+    std::string scaleParameter;
+    double defaultScale;
+    bool usePeriodic;
+};
+
+/**
+ * This is an internal class used to record information about a restraint.
+ * @private
+ */
+class PositionRestraintForce::RestraintInfo {
+public:
+    int particle;
+    Vec3 position;
+    double k, radius;
+    RestraintInfo() {
+        particle = -1;
+        k = radius = 0.0;
+    }
+    RestraintInfo(int particle, const Vec3& position, double k, double radius) :
+        particle(particle), position(position), k(k), radius(radius) {
+    }
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_POSITIONRESTRAINTFORCE_H_*/
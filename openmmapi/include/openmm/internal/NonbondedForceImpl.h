@@ -38,6 +38,7 @@
 #include <utility>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace OpenMM {
 
@@ -71,14 +72,17 @@ public:
     static void calcEwaldParameters(const System& system, const NonbondedForce& force, double& alpha, int& kmaxx, int& kmaxy, int& kmaxz);
     /**
      * This is a utility routine that calculates the values to use for alpha and grid size when using
-     * Particle Mesh Ewald.
+     * Particle Mesh Ewald.  The grid size depends on the order of the B-splines used for interpolation:
+     * higher orders allow a coarser grid for the same accuracy.
      */
-    static void calcPMEParameters(const System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj);
+    static void calcPMEParameters(const System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj, int order=5);
     /**
      * Compute the coefficient which, when divided by the periodic box volume, gives the
-     * long range dispersion correction to the energy.
+     * long range dispersion correction to the energy.  Parameter offsets are evaluated
+     * using the default values of the global parameters.
      */
     static double calcDispersionCorrection(const System& system, const NonbondedForce& force);
+    class DispersionCorrection;
 private:
     class ErrorFunction;
     class EwaldErrorFunction;
@@ -88,6 +92,42 @@ private:
     Kernel kernel;
 };
 
+/**
+ * This class computes the coefficient for the long range dispersion correction, and updates it
+ * efficiently as the values of global parameters change.  Particles whose sigma and epsilon do not
+ * depend on any global parameter are grouped into classes, and the interactions between those classes
+ * are summed once when the object is created.  Only the interactions involving the remaining particles
+ * are recomputed when parameters change.
+ */
+class OPENMM_EXPORT NonbondedForceImpl::DispersionCorrection {
+public:
+    DispersionCorrection(const System& system, const NonbondedForce& force);
+    /**
+     * Get the names of the global parameters the coefficient depends on.
+     */
+    const std::vector<std::string>& getParameterNames() const {
+        return parameterNames;
+    }
+    /**
+     * Get the coefficient which, when divided by the periodic box volume, gives the long range
+     * dispersion correction to the energy.
+     *
+     * @param parameterValues   the values of the global parameters, in the order returned by getParameterNames()
+     */
+    double getCoefficient(const std::vector<double>& parameterValues);
+private:
+    void addInteraction(double sigma, double epsilon, double count, double sums[3]) const;
+    bool isPeriodic, useSwitch;
+    double cutoff, switchDist, numParticles, coefficient;
+    double fixedSums[3];
+    std::vector<double> fixedSigma, fixedEpsilon, fixedCount;
+    std::vector<double> variableSigma, variableEpsilon;
+    std::vector<std::vector<std::pair<int, std::pair<double, double> > > > variableOffsets;
+    std::vector<std::string> parameterNames;
+    std::vector<double> lastValues;
+    bool hasCoefficient;
+};
+
 } // namespace OpenMM
 
 #endif /*OPENMM_NONBONDEDFORCEIMPL_H_*/
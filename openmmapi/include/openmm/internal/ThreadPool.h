@@ -59,13 +59,26 @@ public:
      *
      * @param numThreads  the number of worker threads to create.  If this is 0 (the default), the
      *                    number of threads is set equal to the number of logical CPU cores available
+     * @param processors  the logical processors to bind the worker threads to.  Thread i is bound to
+     *                    processors[i%processors.size()].  If this is empty (the default), the threads
+     *                    are not bound and the operating system may move them between processors.
+     *                    Binding is only supported on Linux, and is ignored on other platforms.
+     * @param shared      if true, this pool shares the processors with every other shared ThreadPool in the
+     *                    process.  Tasks submitted to shared pools are started in the order they were submitted,
+     *                    and each one waits until enough processors are free to run all of its threads, so the
+     *                    total number of busy worker threads does not exceed the number of logical CPU cores.
+     *                    A pool with more threads than cores runs its tasks alone.
      */
-    ThreadPool(int numThreads=0);
+    ThreadPool(int numThreads=0, const std::vector<int>& processors=std::vector<int>(), bool shared=false);
     ~ThreadPool();
     /**
      * Get the number of worker threads in the pool.
      */
     int getNumThreads() const;
+    /**
+     * Get whether this pool shares processors with the other shared ThreadPools in the process.
+     */
+    bool isShared() const;
     /**
      * Execute a Task in parallel on the worker threads.
      */
@@ -89,8 +102,11 @@ public:
      */
     void resumeThreads();
 private:
-    bool isDeleted;
-    int numThreads, waitCount;
+    class SharedScheduler;
+    void startTask();
+    void threadFinishedTask();
+    bool isDeleted, shared;
+    int numThreads, waitCount, finishedCount;
     std::vector<pthread_t> thread;
     std::vector<ThreadData*> threadData;
     pthread_cond_t startCondition, endCondition;
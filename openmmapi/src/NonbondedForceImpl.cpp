@@ -156,7 +156,7 @@ void NonbondedForceImpl::calcEwaldParameters(const System& system, const Nonbond
         kmaxz++;
 }
 
-void NonbondedForceImpl::calcPMEParameters(const System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj) {
+void NonbondedForceImpl::calcPMEParameters(const System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj, int order) {
     if (lj)
         force.getLJPMEParameters(alpha, xsize, ysize, zsize);
     else
@@ -166,19 +166,30 @@ void NonbondedForceImpl::calcPMEParameters(const System& system, const Nonbonded
         system.getDefaultPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
         double tol = force.getEwaldErrorTolerance();
         alpha = (1.0/force.getCutoffDistance())*std::sqrt(-log(2.0*tol));
+
+        // The grid spacing needed to reach the tolerance depends on the B-spline order.  The estimate
+        // for order 5 is the original one.  The others were fit to the error measured against a
+        // converged calculation, and scaled to be as conservative as the one for order 5.
+
+        if (order < 4 || order > 8)
+            throw OpenMMException("NonbondedForce: The PME interpolation order must be between 4 and 8");
+        static const double gridDenominator[] = {5.26, 3.0, 3.45, 1.94, 1.72};
+        static const double gridExponent[] = {0.35, 0.2, 0.19, 0.11, 0.085};
+        double denominator = gridDenominator[order-4]*pow(tol, gridExponent[order-4]);
         if (lj) {
-            xsize = (int) ceil(alpha*boxVectors[0][0]/(3*pow(tol, 0.2)));
-            ysize = (int) ceil(alpha*boxVectors[1][1]/(3*pow(tol, 0.2)));
-            zsize = (int) ceil(alpha*boxVectors[2][2]/(3*pow(tol, 0.2)));
+            xsize = (int) ceil(alpha*boxVectors[0][0]/denominator);
+            ysize = (int) ceil(alpha*boxVectors[1][1]/denominator);
+            zsize = (int) ceil(alpha*boxVectors[2][2]/denominator);
         }
         else {
-            xsize = (int) ceil(2*alpha*boxVectors[0][0]/(3*pow(tol, 0.2)));
-            ysize = (int) ceil(2*alpha*boxVectors[1][1]/(3*pow(tol, 0.2)));
-            zsize = (int) ceil(2*alpha*boxVectors[2][2]/(3*pow(tol, 0.2)));
+            xsize = (int) ceil(2*alpha*boxVectors[0][0]/denominator);
+            ysize = (int) ceil(2*alpha*boxVectors[1][1]/denominator);
+            zsize = (int) ceil(2*alpha*boxVectors[2][2]/denominator);
         }
-        xsize = max(xsize, 6);
-        ysize = max(ysize, 6);
-        zsize = max(zsize, 6);
+        int minSize = max(6, order+1);
+        xsize = max(xsize, minSize);
+        ysize = max(ysize, minSize);
+        zsize = max(zsize, minSize);
     }
 }
 
@@ -233,79 +244,120 @@ double NonbondedForceImpl::evalIntegral(double r, double rs, double rc, double s
 }
 
 double NonbondedForceImpl::calcDispersionCorrection(const System& system, const NonbondedForce& force) {
-    if (force.getNonbondedMethod() == NonbondedForce::NoCutoff || force.getNonbondedMethod() == NonbondedForce::CutoffNonPeriodic)
-        return 0.0;
+    DispersionCorrection correction(system, force);
+    map<string, double> defaultValues;
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        defaultValues[force.getGlobalParameterName(i)] = force.getGlobalParameterDefaultValue(i);
+    vector<double> values;
+    for (const string& name : correction.getParameterNames())
+        values.push_back(defaultValues[name]);
+    return correction.getCoefficient(values);
+}
 
-    // Record sigma and epsilon for every particle, including the default value
-    // for every offset parameter.
+NonbondedForceImpl::DispersionCorrection::DispersionCorrection(const System& system, const NonbondedForce& force) : hasCoefficient(false) {
+    isPeriodic = (force.getNonbondedMethod() != NonbondedForce::NoCutoff && force.getNonbondedMethod() != NonbondedForce::CutoffNonPeriodic);
+    useSwitch = force.getUseSwitchingFunction();
+    cutoff = force.getCutoffDistance();
+    switchDist = force.getSwitchingDistance();
+    numParticles = (double) system.getNumParticles();
+    coefficient = 0.0;
 
-    vector<double> sigma(force.getNumParticles()), epsilon(force.getNumParticles());
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge;
-        force.getParticleParameters(i, charge, sigma[i], epsilon[i]);
-    }
-    map<string, double> param;
-    for (int i = 0; i < force.getNumGlobalParameters(); i++)
-        param[force.getGlobalParameterName(i)] = force.getGlobalParameterDefaultValue(i);
+    // Find the particles whose sigma or epsilon depends on a global parameter.  Offsets that only
+    // affect the charge are ignored.
+
+    map<int, int> variableIndex;
     for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
         string parameter;
         int index;
         double chargeScale, sigmaScale, epsilonScale;
         force.getParticleParameterOffset(i, parameter, index, chargeScale, sigmaScale, epsilonScale);
-        sigma[index] += param[parameter]*sigmaScale;
-        epsilon[index] += param[parameter]*epsilonScale;
+        if (sigmaScale == 0.0 && epsilonScale == 0.0)
+            continue;
+        auto paramPos = find(parameterNames.begin(), parameterNames.end(), parameter);
+        int paramIndex = paramPos-parameterNames.begin();
+        if (paramPos == parameterNames.end())
+            parameterNames.push_back(parameter);
+        if (variableIndex.find(index) == variableIndex.end()) {
+            double charge, sigma, epsilon;
+            force.getParticleParameters(index, charge, sigma, epsilon);
+            variableIndex[index] = variableSigma.size();
+            variableSigma.push_back(sigma);
+            variableEpsilon.push_back(epsilon);
+            variableOffsets.push_back(vector<pair<int, pair<double, double> > >());
+        }
+        variableOffsets[variableIndex[index]].push_back(make_pair(paramIndex, make_pair(sigmaScale, epsilonScale)));
     }
 
-    // Identify all particle classes (defined by sigma and epsilon), and count the number of
-    // particles in each class.
+    // Identify the classes (defined by sigma and epsilon) of all other particles, and count the number
+    // of particles in each class.
 
     map<pair<double, double>, int> classCounts;
     for (int i = 0; i < force.getNumParticles(); i++) {
-        pair<double, double> key = make_pair(sigma[i], epsilon[i]);
-        map<pair<double, double>, int>::iterator entry = classCounts.find(key);
-        if (entry == classCounts.end())
-            classCounts[key] = 1;
-        else
-            entry->second++;
+        if (variableIndex.find(i) != variableIndex.end())
+            continue;
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i, charge, sigma, epsilon);
+        classCounts[make_pair(sigma, epsilon)]++;
+    }
+    for (auto& entry : classCounts) {
+        fixedSigma.push_back(entry.first.first);
+        fixedEpsilon.push_back(entry.first.second);
+        fixedCount.push_back(entry.second);
     }
 
-    // Loop over all pairs of classes to compute the coefficient.
-
-    double sum1 = 0, sum2 = 0, sum3 = 0;
-    bool useSwitch = force.getUseSwitchingFunction();
-    double cutoff = force.getCutoffDistance();
-    double switchDist = force.getSwitchingDistance();
-    for (map<pair<double, double>, int>::const_iterator entry = classCounts.begin(); entry != classCounts.end(); ++entry) {
-        double sigma = entry->first.first;
-        double epsilon = entry->first.second;
-        double count = (double) entry->second;
-        count *= (count + 1) / 2;
-        double sigma2 = sigma*sigma;
-        double sigma6 = sigma2*sigma2*sigma2;
-        sum1 += count*epsilon*sigma6*sigma6;
-        sum2 += count*epsilon*sigma6;
-        if (useSwitch)
-            sum3 += count*epsilon*(evalIntegral(cutoff, switchDist, cutoff, sigma)-evalIntegral(switchDist, switchDist, cutoff, sigma));
+    // Sum the interactions between pairs of fixed classes.
+
+    for (int i = 0; i < 3; i++)
+        fixedSums[i] = 0.0;
+    for (int i = 0; i < fixedSigma.size(); i++) {
+        addInteraction(fixedSigma[i], fixedEpsilon[i], fixedCount[i]*(fixedCount[i]+1)/2, fixedSums);
+        for (int j = 0; j < i; j++)
+            addInteraction(0.5*(fixedSigma[i]+fixedSigma[j]), sqrt(fixedEpsilon[i]*fixedEpsilon[j]), fixedCount[i]*fixedCount[j], fixedSums);
     }
-    for (map<pair<double, double>, int>::const_iterator class1 = classCounts.begin(); class1 != classCounts.end(); ++class1)
-        for (map<pair<double, double>, int>::const_iterator class2 = classCounts.begin(); class2 != class1; ++class2) {
-            double sigma = 0.5*(class1->first.first+class2->first.first);
-            double epsilon = sqrt(class1->first.second*class2->first.second);
-            double count = (double) class1->second;
-            count *= (double) class2->second;
-            double sigma2 = sigma*sigma;
-            double sigma6 = sigma2*sigma2*sigma2;
-            sum1 += count*epsilon*sigma6*sigma6;
-            sum2 += count*epsilon*sigma6;
-            if (useSwitch)
-                sum3 += count*epsilon*(evalIntegral(cutoff, switchDist, cutoff, sigma)-evalIntegral(switchDist, switchDist, cutoff, sigma));
+}
+
+void NonbondedForceImpl::DispersionCorrection::addInteraction(double sigma, double epsilon, double count, double sums[3]) const {
+    double sigma2 = sigma*sigma;
+    double sigma6 = sigma2*sigma2*sigma2;
+    sums[0] += count*epsilon*sigma6*sigma6;
+    sums[1] += count*epsilon*sigma6;
+    if (useSwitch)
+        sums[2] += count*epsilon*(evalIntegral(cutoff, switchDist, cutoff, sigma)-evalIntegral(switchDist, switchDist, cutoff, sigma));
+}
+
+double NonbondedForceImpl::DispersionCorrection::getCoefficient(const vector<double>& parameterValues) {
+    if (!isPeriodic)
+        return 0.0;
+    if (hasCoefficient && parameterValues == lastValues)
+        return coefficient;
+
+    // Compute the current parameters of the variable particles.
+
+    int numVariable = variableSigma.size();
+    vector<double> sigma(variableSigma), epsilon(variableEpsilon);
+    for (int i = 0; i < numVariable; i++)
+        for (auto& offset : variableOffsets[i]) {
+            double value = parameterValues[offset.first];
+            sigma[i] += value*offset.second.first;
+            epsilon[i] += value*offset.second.second;
         }
-    double numParticles = (double) system.getNumParticles();
+
+    // Add their interactions with the fixed classes and with each other.
+
+    double sums[3] = {fixedSums[0], fixedSums[1], fixedSums[2]};
+    for (int i = 0; i < numVariable; i++) {
+        for (int j = 0; j < fixedSigma.size(); j++)
+            addInteraction(0.5*(sigma[i]+fixedSigma[j]), sqrt(epsilon[i]*fixedEpsilon[j]), fixedCount[j], sums);
+        for (int j = 0; j <= i; j++)
+            addInteraction(0.5*(sigma[i]+sigma[j]), sqrt(epsilon[i]*epsilon[j]), 1.0, sums);
+    }
     double numInteractions = (numParticles*(numParticles+1))/2;
-    sum1 /= numInteractions;
-    sum2 /= numInteractions;
-    sum3 /= numInteractions;
-    return 8*numParticles*numParticles*M_PI*(sum1/(9*pow(cutoff, 9))-sum2/(3*pow(cutoff, 3))+sum3);
+    for (int i = 0; i < 3; i++)
+        sums[i] /= numInteractions;
+    coefficient = 8*numParticles*numParticles*M_PI*(sums[0]/(9*pow(cutoff, 9))-sums[1]/(3*pow(cutoff, 3))+sums[2]);
+    lastValues = parameterValues;
+    hasCoefficient = true;
+    return coefficient;
 }
 
 void NonbondedForceImpl::updateParametersInContext(ContextImpl& context) {
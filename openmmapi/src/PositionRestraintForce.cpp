@@ -0,0 +1,93 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/PositionRestraintForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/internal/PositionRestraintForceImpl.h"
+
+using namespace OpenMM;
+using namespace std;
+
+PositionRestraintForce::PositionRestraintForce() : scaleParameter("restraintScale"), defaultScale(1.0), usePeriodic(false) {
+}
+
+const string& PositionRestraintForce::getScaleParameterName() const {
+    return scaleParameter;
+}
+
+void PositionRestraintForce::setScaleParameterName(const string& name) {
+    scaleParameter = name;
+}
+
+double PositionRestraintForce::getDefaultScale() const {
+    return defaultScale;
+}
+
+void PositionRestraintForce::setDefaultScale(double scale) {
+    defaultScale = scale;
+}
+
+int PositionRestraintForce::addRestraint(int particle, const Vec3& position, double k, double radius) {
+    restraints.push_back(RestraintInfo(particle, position, k, radius));
+    return restraints.size()-1;
+}
+
+void PositionRestraintForce::getRestraintParameters(int index, int& particle, Vec3& position, double& k, double& radius) const {
+    ASSERT_VALID_INDEX(index, restraints);
+    particle = restraints[index].particle;
+    position = restraints[index].position;
+    k = restraints[index].k;
+    radius = restraints[index].radius;
+}
+
+void PositionRestraintForce::setRestraintParameters(int index, int particle, const Vec3& position, double k, double radius) {
+    ASSERT_VALID_INDEX(index, restraints);
+    restraints[index].particle = particle;
+    restraints[index].position = position;
+    restraints[index].k = k;
+    restraints[index].radius = radius;
+}
+
+ForceImpl* PositionRestraintForce::createImpl() const {
+    return new PositionRestraintForceImpl(*this);
+}
+
+void PositionRestraintForce::updateParametersInContext(Context& context) {
+    dynamic_cast<PositionRestraintForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
+}
+
+void PositionRestraintForce::setUsesPeriodicBoundaryConditions(bool periodic) {
+    usePeriodic = periodic;
+}
+
+bool PositionRestraintForce::usesPeriodicBoundaryConditions() const {
+    return usePeriodic;
+}
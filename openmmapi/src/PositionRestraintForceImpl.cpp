@@ -0,0 +1,95 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/internal/PositionRestraintForceImpl.h"
+#include "openmm/kernels.h"
+#include <sstream>
+
+using namespace OpenMM;
+using namespace std;
+
+PositionRestraintForceImpl::PositionRestraintForceImpl(const PositionRestraintForce& owner) : owner(owner) {
+}
+
+PositionRestraintForceImpl::~PositionRestraintForceImpl() {
+}
+
+void PositionRestraintForceImpl::initialize(ContextImpl& context) {
+    kernel = context.getPlatform().createKernel(CalcPositionRestraintForceKernel::Name(), context);
+
+    // Check for errors in the specification of restraints.
+
+    const System& system = context.getSystem();
+    for (int i = 0; i < owner.getNumRestraints(); i++) {
+        int particle;
+        Vec3 position;
+        double k, radius;
+        owner.getRestraintParameters(i, particle, position, k, radius);
+        if (particle < 0 || particle >= system.getNumParticles()) {
+            stringstream msg;
+            msg << "PositionRestraintForce: Illegal particle index for a restraint: ";
+            msg << particle;
+            throw OpenMMException(msg.str());
+        }
+        if (radius < 0) {
+            stringstream msg;
+            msg << "PositionRestraintForce: Flat-bottom radius cannot be negative: ";
+            msg << radius;
+            throw OpenMMException(msg.str());
+        }
+    }
+    kernel.getAs<CalcPositionRestraintForceKernel>().initialize(context.getSystem(), owner);
+}
+
+double PositionRestraintForceImpl::calcForcesAndEnergy(ContextImpl& context, bool includeForces, bool includeEnergy, int groups) {
+    if ((groups&(1<<owner.getForceGroup())) != 0)
+        return kernel.getAs<CalcPositionRestraintForceKernel>().execute(context, includeForces, includeEnergy);
+    return 0.0;
+}
+
+map<string, double> PositionRestraintForceImpl::getDefaultParameters() {
+    map<string, double> parameters;
+    parameters[owner.getScaleParameterName()] = owner.getDefaultScale();
+    return parameters;
+}
+
+vector<string> PositionRestraintForceImpl::getKernelNames() {
+    vector<string> names;
+    names.push_back(CalcPositionRestraintForceKernel::Name());
+    return names;
+}
+
+void PositionRestraintForceImpl::updateParametersInContext(ContextImpl& context) {
+    kernel.getAs<CalcPositionRestraintForceKernel>().copyParametersToContext(context, owner);
+    context.systemChanged();
+}
@@ -31,11 +31,66 @@
 
 #include "openmm/internal/ThreadPool.h"
 #include "openmm/internal/hardware.h"
+#include <algorithm>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 using namespace std;
 
 namespace OpenMM {
 
+/**
+ * This decides when tasks submitted to shared ThreadPools may start.  Each task needs one processor for each
+ * of its pool's threads, and holds them until all of its threads have finished.  Tasks are started strictly
+ * in the order they were submitted, so a pool with many threads cannot be starved by pools with few.
+ */
+class ThreadPool::SharedScheduler {
+public:
+    SharedScheduler() : numProcessors(getNumProcessors()), numAvailable(numProcessors), nextTicket(0), nextToStart(0) {
+        pthread_cond_init(&condition, NULL);
+        pthread_mutex_init(&lock, NULL);
+    }
+    static SharedScheduler& getInstance() {
+        static SharedScheduler scheduler;
+        return scheduler;
+    }
+    /**
+     * Get the number of processors a pool with the specified number of threads holds while running a task.
+     */
+    int getProcessorsForThreads(int numThreads) const {
+        return min(numThreads, numProcessors);
+    }
+    /**
+     * Block until the processors for a task are available, then claim them.
+     */
+    void acquire(int numThreads) {
+        int required = getProcessorsForThreads(numThreads);
+        pthread_mutex_lock(&lock);
+        long long ticket = nextTicket++;
+        while (ticket != nextToStart || numAvailable < required)
+            pthread_cond_wait(&condition, &lock);
+        numAvailable -= required;
+        nextToStart++;
+        pthread_cond_broadcast(&condition);
+        pthread_mutex_unlock(&lock);
+    }
+    /**
+     * Return the processors claimed by a task.
+     */
+    void release(int numThreads) {
+        pthread_mutex_lock(&lock);
+        numAvailable += getProcessorsForThreads(numThreads);
+        pthread_cond_broadcast(&condition);
+        pthread_mutex_unlock(&lock);
+    }
+private:
+    int numProcessors, numAvailable;
+    long long nextTicket, nextToStart;
+    pthread_cond_t condition;
+    pthread_mutex_t lock;
+};
+
 class ThreadPool::ThreadData {
 public:
     ThreadData(ThreadPool& owner, int index) : owner(owner), index(index), isDeleted(false) {
@@ -45,6 +100,8 @@ public:
             owner.currentTask->execute(owner, index);
         else
             owner.currentFunction(owner, index);
+        if (owner.shared)
+            owner.threadFinishedTask();
     }
     ThreadPool& owner;
     int index;
@@ -67,7 +124,7 @@ static void* threadBody(void* args) {
     return 0;
 }
 
-ThreadPool::ThreadPool(int numThreads) : currentTask(NULL) {
+ThreadPool::ThreadPool(int numThreads, const vector<int>& processors, bool shared) : shared(shared), finishedCount(0), currentTask(NULL) {
     if (numThreads <= 0)
         numThreads = getNumProcessors();
     this->numThreads = numThreads;
@@ -82,6 +139,14 @@ ThreadPool::ThreadPool(int numThreads) : currentTask(NULL) {
         data->isDeleted = false;
         threadData.push_back(data);
         pthread_create(&thread[i], NULL, threadBody, data);
+#ifdef __linux__
+        if (processors.size() > 0 && processors[i%processors.size()] < CPU_SETSIZE) {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(processors[i%processors.size()], &cpuSet);
+            pthread_setaffinity_np(thread[i], sizeof(cpu_set_t), &cpuSet);
+        }
+#endif
     }
     while (waitCount < numThreads)
         pthread_cond_wait(&endCondition, &lock);
@@ -105,17 +170,38 @@ int ThreadPool::getNumThreads() const {
     return numThreads;
 }
 
+bool ThreadPool::isShared() const {
+    return shared;
+}
+
 void ThreadPool::execute(Task& task) {
+    startTask();
     currentTask = &task;
     resumeThreads();
 }
 
 void ThreadPool::execute(function<void (ThreadPool&, int)> task) {
+    startTask();
     currentTask = NULL;
     currentFunction = task;
     resumeThreads();
 }
 
+void ThreadPool::startTask() {
+    if (shared) {
+        SharedScheduler::getInstance().acquire(numThreads);
+        finishedCount = 0;
+    }
+}
+
+void ThreadPool::threadFinishedTask() {
+    pthread_mutex_lock(&lock);
+    bool allFinished = (++finishedCount == numThreads);
+    pthread_mutex_unlock(&lock);
+    if (allFinished)
+        SharedScheduler::getInstance().release(numThreads);
+}
+
 void ThreadPool::syncThreads() {
     pthread_mutex_lock(&lock);
     waitCount++;
@@ -42,9 +42,11 @@
 #include "CpuLangevinMiddleDynamics.h"
 #include "CpuNeighborList.h"
 #include "CpuNonbondedForce.h"
+#include "CpuNonbondedTreecode.h"
 #include "CpuPlatform.h"
 #include "openmm/kernels.h"
 #include "openmm/System.h"
+#include "openmm/internal/NonbondedForceImpl.h"
 #include <array>
 #include <tuple>
 
@@ -267,14 +269,38 @@ public:
     void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
 private:
     class PmeIO;
+    class LJPmeIO;
+    class PmePostComputation;
     void computeParameters(ContextImpl& context, bool offsetsOnly);
+    void computeParticleParameters(int index);
+    void computeExceptionParameters(int index);
+    void computeSelfEnergy(double sumSquaredCharges, double sumSquaredC6);
+    void setPmeGrid(ContextImpl& context, const std::array<int, 3>& grid);
+    void recordPmeTiming(ContextImpl& context, double time);
+    void createOptimizedLJPme(ContextImpl& context);
+    /**
+     * Start computing reciprocal space with the optimized kernel.  It runs in the background until
+     * finishOptimizedPme() is called.
+     */
+    void beginOptimizedPme(const Vec3* boxVectors, bool includeEnergy);
+    /**
+     * Wait for the optimized reciprocal space computation to finish.  If recordForces is true, its
+     * forces are added to the force buffers and its energy is returned.  Otherwise they are discarded.
+     */
+    double finishOptimizedPme(bool recordForces);
     CpuPlatform::PlatformData& data;
-    int numParticles, num14, chargePosqIndex, ljPosqIndex;
+    int numParticles, num14, chargePosqIndex;
     std::vector<std::vector<int> > bonded14IndexArray;
     std::vector<std::vector<double> > bonded14ParamArray;
     double nonbondedCutoff, switchingDistance, rfDielectric, ewaldAlpha, ewaldDispersionAlpha, ewaldSelfEnergy, dispersionCoefficient;
+    double fixedSumSquaredCharges, fixedSumSquaredC6;
     int kmax[3], gridSize[3], dispersionGridSize[3];
     bool useSwitchingFunction, exceptionsArePeriodic, useOptimizedPme, hasInitializedPme, hasInitializedDispersionPme, hasParticleOffsets, hasExceptionOffsets;
+    bool isTuningPme, hasPendingPme;
+    int pmeTuningSamples;
+    std::vector<std::array<int, 3> > pmeTuningGrids;
+    std::vector<double> pmeTuningTimes;
+    std::vector<int> offsetParticleIndices, offsetExceptionIndices;
     std::vector<std::set<int> > exclusions;
     std::vector<std::pair<float, float> > particleParams;
     std::vector<float> C6params;
@@ -285,7 +311,12 @@ private:
     std::vector<double> paramValues;
     NonbondedMethod nonbondedMethod;
     CpuNonbondedForce* nonbonded;
-    Kernel optimizedPme, optimizedDispersionPme;
+    CpuNonbondedTreecode* treecode;
+    NonbondedForceImpl::DispersionCorrection* dispersionCorrection;
+    Kernel optimizedPme, optimizedLJPme;
+    AlignedArray<float> pmePosq;
+    PmeIO* pmeio;
+    LJPmeIO* ljpmeio;
     CpuBondForce bondForce;
 };
 
@@ -500,6 +531,49 @@ private:
     CpuGayBerneForce* ixn;
 };
 
+/**
+ * This kernel is invoked by PositionRestraintForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcPositionRestraintForceKernel : public CalcPositionRestraintForceKernel {
+public:
+    CpuCalcPositionRestraintForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcPositionRestraintForceKernel(name, platform), data(data), usePeriodic(false) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the PositionRestraintForce this kernel will be used for
+     */
+    void initialize(const System& system, const PositionRestraintForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the PositionRestraintForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const PositionRestraintForce& force);
+private:
+    void computeRestraints(int start, int end, const std::vector<Vec3>& posData, std::vector<Vec3>& forceData, const Vec3* boxVectors,
+            float scale, bool includeForces, double& energy);
+    CpuPlatform::PlatformData& data;
+    std::vector<int> restraintIndex, particles, threadStart;
+    std::vector<Vec3> referencePos;
+    std::vector<float> k, radius;
+    std::vector<double> threadEnergy;
+    std::string scaleParameter;
+    bool usePeriodic;
+};
+
 /**
  * This kernel is invoked by LangevinIntegrator to take one time step.
  */
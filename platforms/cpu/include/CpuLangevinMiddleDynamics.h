@@ -28,6 +28,7 @@
 
 #include "ReferenceLangevinMiddleDynamics.h"
 #include "CpuRandom.h"
+#include "CpuSETTLE.h"
 #include "openmm/internal/ThreadPool.h"
 #include "sfmt/SFMT.h"
 
@@ -52,6 +53,21 @@ public:
      */
     ~CpuLangevinMiddleDynamics();
 
+    /**
+     * Advance the system by one time step.  If the only constraints are rigid waters handled by CpuSETTLE,
+     * each thread performs every phase of the step (kick, velocity constraints, drift and noise, position
+     * constraints) for a fixed set of atom blocks in a single pass, without synchronizing between phases.
+     * Otherwise the phases are executed separately, alternating with the constraint algorithm.
+     *
+     * @param context             the context this integrator is updating
+     * @param atomCoordinates     atom coordinates
+     * @param velocities          velocities
+     * @param masses              atom masses
+     * @param tolerance           the constraint tolerance
+     */
+    void update(OpenMM::ContextImpl& context, std::vector<OpenMM::Vec3>& atomCoordinates,
+                std::vector<OpenMM::Vec3>& velocities, std::vector<double>& masses, double tolerance);
+
     /**
      * First update step.
      * 
@@ -91,6 +107,9 @@ private:
     void threadUpdate1(int threadIndex);
     void threadUpdate2(int threadIndex);
     void threadUpdate3(int threadIndex);
+    void createBlocks(const OpenMM::CpuSETTLE* settle);
+    void threadUpdateFused(int threadIndex, const OpenMM::CpuSETTLE* settle, std::vector<OpenMM::Vec3>& atomCoordinates,
+                           std::vector<OpenMM::Vec3>& velocities, std::vector<OpenMM::Vec3>& forces);
     OpenMM::ThreadPool& threads;
     OpenMM::CpuRandom& random;
     std::vector<OpenMM_SFMT::SFMT> threadRandom;
@@ -101,6 +120,10 @@ private:
     OpenMM::Vec3* forces;
     double* inverseMasses;
     OpenMM::Vec3* xPrime;
+    // Blocks of atoms (and the waters they contain) for the fused update.
+    std::vector<int> blockAtomStart, blockClusterStart;
+    const OpenMM::CpuSETTLE* blockSettle;
+    bool hasBlocks;
 };
 
 } // namespace OpenMM
@@ -109,10 +109,11 @@ class CpuNonbondedForce {
 
          @param alpha    the Ewald separation parameter
          @param gridSize the dimensions of the mesh
+         @param order    the B-spline interpolation order
 
          --------------------------------------------------------------------------------------- */
 
-      void setUsePME(float alpha, int meshSize[3]);
+      void setUsePME(float alpha, int meshSize[3], int order);
 
       /**---------------------------------------------------------------------------------------
 
@@ -120,10 +121,11 @@ class CpuNonbondedForce {
 
          @param alpha    the Ewald separation parameter
          @param gridSize the dimensions of the mesh
+         @param order    the B-spline interpolation order
 
          --------------------------------------------------------------------------------------- */
 
-      void setUseLJPME(float alpha, int meshSize[3]);
+      void setUseLJPME(float alpha, int meshSize[3], int order);
 
       /**---------------------------------------------------------------------------------------
 
@@ -133,6 +135,19 @@ class CpuNonbondedForce {
 
       void setPeriodicExceptions(bool periodic);
 
+      /**---------------------------------------------------------------------------------------
+
+         Set the arrays in which to record which blocks of atoms each thread adds forces to.
+         If this is not set, every thread is assumed to touch every atom.
+
+         @param touchedBlocks  touchedBlocks[thread][block] is set to 1 when a thread adds a
+                               force to any atom in the block
+         @param blockSize      the number of atoms in each block, which must be a power of 2
+
+         --------------------------------------------------------------------------------------- */
+
+      void setForceBlockTracking(std::vector<std::vector<char> >& touchedBlocks, int blockSize);
+
       /**---------------------------------------------------------------------------------------
       
          Calculate Ewald ixn
@@ -193,7 +208,7 @@ protected:
         float krf, crf;
         float alphaEwald, alphaDispersionEwald;
         int numRx, numRy, numRz;
-        int meshDim[3], dispersionMeshDim[3];
+        int meshDim[3], dispersionMeshDim[3], pmeOrder, dispersionPmeOrder;
         std::vector<float> erfcTable, ewaldScaleTable;
         std::vector<float> exptermsTable, dExptermsTable;
         float ewaldDX, ewaldDXInv, erfcDXInv, exptermsDX, exptermsDXInv;
@@ -206,6 +221,8 @@ protected:
         float const *C6params;
         std::set<int> const* exclusions;
         std::vector<AlignedArray<float> >* threadForce;
+        std::vector<std::vector<char> >* touchedBlocks;
+        int touchedBlockShift;
         bool includeEnergy;
         float inverseRcut6;
         float inverseRcut6Expterm;
@@ -226,6 +243,18 @@ protected:
          --------------------------------------------------------------------------------------- */
           
       void calculateOneIxn(int atom1, int atom2, float* forces, double* totalEnergy, const fvec4& boxSize, const fvec4& invBoxSize);
+
+      /**---------------------------------------------------------------------------------------
+
+         Record which blocks of atoms a thread adds forces to when it processes one neighbor
+         list block.
+
+         @param blockIndex       the index of the neighbor list block
+         @param touched          the array of flags for the thread's blocks of atoms
+
+         --------------------------------------------------------------------------------------- */
+
+      void recordTouchedBlocks(int blockIndex, char* touched) const;
             
       /**---------------------------------------------------------------------------------------
       
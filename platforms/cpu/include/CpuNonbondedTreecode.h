@@ -0,0 +1,131 @@
+
+/* Portions copyright (c) 2026 Stanford University and Simbios.
+ * Contributors: Pande Group
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENMM_CPU_NONBONDED_TREECODE_H__
+#define OPENMM_CPU_NONBONDED_TREECODE_H__
+
+#include "AlignedArray.h"
+#include "openmm/internal/ThreadPool.h"
+#include <atomic>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the nonbonded interactions of a NonbondedForce that uses NoCutoff
+ * with a Barnes-Hut treecode, reducing the cost from O(N^2) to O(N log N).  The particles
+ * are sorted into a binary tree by recursively splitting them at the median of the longest
+ * axis of their bounding box.  Each particle interacts directly with particles in nearby
+ * leaf nodes, and with the multipole expansions of nodes that are far enough away.
+ * Coulomb interactions are expanded up to quadrupoles.  Lennard-Jones interactions are
+ * expanded to first order, which is possible because the Lorentz-Berthelot combining rule
+ * makes (sigma_i+sigma_j)^n separable into a sum of products of per-particle terms.  The
+ * tree is walked once for each leaf, and the resulting interaction lists are shared by all
+ * its atoms.
+ *
+ * Excluded pairs are always computed in the near field, where they can be skipped.
+ */
+class CpuNonbondedTreecode {
+public:
+    /**
+     * Create a CpuNonbondedTreecode.
+     *
+     * @param openingAngle    a node is treated as a single multipole expansion if its width
+     *                        divided by its distance from the particle is less than this.
+     *                        Smaller values are more accurate but slower.
+     */
+    CpuNonbondedTreecode(float openingAngle);
+
+    ~CpuNonbondedTreecode();
+
+    /**
+     * Calculate the LJ and Coulomb interactions.
+     *
+     * @param numberOfAtoms    number of atoms
+     * @param posq             atom coordinates and charges
+     * @param atomParameters   atom parameters (sigma/2, 2*sqrt(epsilon))
+     * @param exclusions       atom exclusion indices
+     *                         exclusions[atomIndex] contains the list of exclusions for that atom
+     * @param threadForce      force array for each thread (forces added)
+     * @param totalEnergy      total energy
+     * @param threads          the thread pool to use
+     */
+    void computeForce(int numberOfAtoms, const float* posq, const std::vector<std::pair<float, float> >& atomParameters,
+            const std::vector<std::set<int> >& exclusions, std::vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads);
+
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputeForce(ThreadPool& threads, int threadIndex);
+
+private:
+    struct Node;
+    struct InteractionList;
+    float openingAngle;
+    double maxExclusionDistance;
+    std::vector<Node> nodes;
+    std::vector<int> leaves, sortedAtoms, atomPosition;
+    std::vector<float> sortedX, sortedY, sortedZ, sortedCharge, sortedSigma, sortedEpsilon;
+    std::vector<double> threadEnergy;
+    std::vector<std::vector<float> > threadIncluded;
+    // The following variables are used to make information accessible to the individual threads.
+    int numberOfAtoms;
+    float const* posq;
+    std::pair<float, float> const* atomParameters;
+    std::set<int> const* exclusions;
+    std::vector<AlignedArray<float> >* threadForce;
+    bool includeEnergy;
+    std::atomic<int> atomicCounter;
+
+    static const int MaxLeafSize;
+
+    /**
+     * Build the subtree for a range of the sorted atoms, and compute its multipole moments.
+     */
+    void buildNode(int nodeIndex, int start, int end);
+
+    /**
+     * Find the nodes that atoms in a leaf should interact with through multipole expansions, and
+     * the leaves they should interact with directly.
+     */
+    void buildInteractionList(const Node& target, InteractionList& list) const;
+
+    /**
+     * Compute the forces and (half of the) energies from the multipole expansions for the atoms in a leaf.
+     */
+    void computeFarFieldIxn(const Node& leaf, const InteractionList& list, float* forces, double& energy) const;
+
+    /**
+     * Compute the force and (half of the) energy from the near field for the atom at a position in the tree order.
+     */
+    void computeNearFieldIxn(int position, const InteractionList& list, const std::vector<float>& included, float* forces, double& energy) const;
+};
+
+} // namespace OpenMM
+
+// ---------------------------------------------------------------------------------------
+
+#endif // OPENMM_CPU_NONBONDED_TREECODE_H__
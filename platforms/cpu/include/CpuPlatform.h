@@ -77,6 +77,66 @@ public:
         static const std::string key = "DeterministicForces";
         return key;
     }
+    /**
+     * This is the name of the parameter for requesting that the PME grid be tuned at runtime.  If this is
+     * "true", the first force evaluations time several grids that are at least as accurate as the default one,
+     * and the fastest is used from then on.
+     */
+    static const std::string& CpuTunePme() {
+        static const std::string key = "TunePme";
+        return key;
+    }
+    /**
+     * This is the name of the parameter for selecting the order of the B-splines used to interpolate onto
+     * the PME grid.  It may be between 4 and 8.  Higher orders allow a coarser grid for the same accuracy,
+     * but make spreading charges and interpolating forces more expensive.
+     */
+    static const std::string& CpuPmeOrder() {
+        static const std::string key = "PmeOrder";
+        return key;
+    }
+    /**
+     * This is the name of the parameter for computing NonbondedForces that use NoCutoff with a Barnes-Hut
+     * treecode.  If this is "0", all pairs of particles are computed directly.  Otherwise it is the opening
+     * angle, which must be between 0 and 1: a group of particles is approximated by its multipole expansion
+     * if its width divided by its distance is less than this.  Smaller values are more accurate but slower.
+     */
+    static const std::string& CpuTreecodeOpeningAngle() {
+        static const std::string key = "TreecodeOpeningAngle";
+        return key;
+    }
+    /**
+     * This is the name of the parameter for binding worker threads to logical processors.  It is a comma
+     * separated list of processor indices or ranges, such as "0-7,16-23".  Thread i is bound to the i'th
+     * processor in the list, wrapping around if there are more threads than processors.  If this is empty
+     * (the default), threads are not bound.
+     */
+    static const std::string& CpuAffinity() {
+        static const std::string key = "CpuAffinity";
+        return key;
+    }
+    /**
+     * This is the name of the parameter for selecting where per-thread memory is placed.  If this is "local",
+     * each worker thread allocates and first touches the buffers it works on, so on NUMA systems they are
+     * placed on the memory node closest to it.  This is most useful in combination with CpuAffinity.  If this
+     * is "none" (the default), buffers are allocated by the thread that creates the Context.
+     */
+    static const std::string& CpuNumaPolicy() {
+        static const std::string key = "NumaPolicy";
+        return key;
+    }
+    /**
+     * This is the name of the parameter for requesting that this Context share processors with other Contexts
+     * in the same process.  If this is "true", tasks from all Contexts that set it are started in the order they
+     * are submitted, and no more worker threads run at once than there are logical CPU cores.  The Threads
+     * parameter sets how many of those cores each of this Context's tasks uses.  The default value is taken
+     * from the OPENMM_CPU_SHARED_THREAD_POOL environment variable, which also controls whether the PME
+     * reciprocal space threads take part.
+     */
+    static const std::string& CpuSharedThreadPool() {
+        static const std::string key = "SharedThreadPool";
+        return key;
+    }
     /**
      * We cannot use the standard mechanism for platform data, because that is already used by the superclass.
      * Instead, we maintain a table of ContextImpls to PlatformDatas.
@@ -89,21 +149,63 @@ private:
 
 class CpuPlatform::PlatformData {
 public:
-    PlatformData(int numParticles, int numThreads, bool deterministicForces);
+    class ForcePostComputation;
+    PlatformData(int numParticles, int numThreads, bool deterministicForces, bool tunePme, int pmeOrder, double treecodeOpeningAngle,
+            const std::vector<int>& processors, bool localMemory, bool sharedThreadPool);
     ~PlatformData();
     void requestNeighborList(double cutoffDistance, double padding, bool useExclusions, const std::vector<std::set<int> >& exclusionList);
     int requestPosqIndex();
+    /**
+     * Record that a thread may have added forces to any particle.  Kernels that add to threadForce must
+     * either call this or set the entries of threadForceBlocks for the blocks they touch.
+     */
+    void touchAllForceBlocks(int threadIndex);
+    /**
+     * Record that every thread may have added forces to any particle.
+     */
+    void touchAllForceBlocks();
+    /**
+     * Add a ForcePostComputation to be executed at the end of every force computation.  The
+     * PlatformData takes over ownership of it, and deletes it when the Context is destroyed.
+     */
+    void addPostComputation(ForcePostComputation* computation);
+    /**
+     * threadForce is divided into blocks of this many particles.  Only blocks that a thread has touched
+     * are summed and cleared at the end of a force computation.
+     */
+    static const int ForceBlockSize = 32;
     AlignedArray<float> posq;
     std::vector<AlignedArray<float> > threadForce;
+    std::vector<std::vector<char> > threadForceBlocks;
     ThreadPool threads;
     bool isPeriodic;
     CpuRandom random;
     std::map<std::string, std::string> propertyValues;
     CpuNeighborList* neighborList;
     double cutoff, paddedCutoff;
-    bool anyExclusions, deterministicForces;
-    int currentPosqIndex, nextPosqIndex;
+    bool anyExclusions, deterministicForces, tunePme;
+    int currentPosqIndex, nextPosqIndex, pmeOrder;
+    double treecodeOpeningAngle;
     std::vector<std::set<int> > exclusions;
+    std::vector<ForcePostComputation*> postComputations;
+};
+
+/**
+ * This abstract class defines a function to be executed at the end of force computation, after every
+ * force kernel has been executed but before the forces computed by different threads are summed.  Kernels
+ * that leave work running in the background use it to wait for that work and record its results.
+ */
+class CpuPlatform::PlatformData::ForcePostComputation {
+public:
+    virtual ~ForcePostComputation() {
+    }
+    /**
+     * @param includeForces  whether forces should be computed
+     * @param includeEnergy  whether potential energy should be computed
+     * @param groups         a set of bit flags for which force groups to include
+     * @return an optional contribution to add to the potential energy.
+     */
+    virtual double computeForceAndEnergy(bool includeForces, bool includeEnergy, int groups) = 0;
 };
 
 } // namespace OpenMM
@@ -41,12 +41,13 @@
 namespace OpenMM {
 
 /**
- * This class uses multiple ReferenceSETTLEAlgorithm objects to execute the algorithm in parallel.
+ * This class executes the SETTLE algorithm in parallel.  The clusters are divided into blocks that are
+ * processed by different threads.  Within a block, waters are gathered into SIMD vectors (4 or 8 at a
+ * time, depending on whether AVX is available) and the analytic solution is applied to all of them at once.
  */
 class OPENMM_EXPORT_CPU CpuSETTLE : public ReferenceConstraintAlgorithm {
 public:
     CpuSETTLE(const System& system, const ReferenceSETTLEAlgorithm& settle, ThreadPool& threads);
-    ~CpuSETTLE();
 
     /**
      * Apply the constraint algorithm.
@@ -67,8 +68,52 @@ public:
      * @param tolerance        the constraint tolerance
      */
     void applyToVelocities(std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& velocities, std::vector<double>& inverseMasses, double tolerance);
+
+    /**
+     * Get the number of clusters.  Clusters are sorted by the index of their first atom.
+     */
+    int getNumClusters() const;
+
+    /**
+     * Get the atoms in a cluster.
+     */
+    void getClusterAtoms(int index, int& atom1, int& atom2, int& atom3) const;
+
+    /**
+     * Apply the constraint algorithm to a range of clusters on the calling thread.  This allows
+     * an integrator to constrain the waters owned by each thread as part of its own loop.
+     *
+     * @param start            the index of the first cluster to process
+     * @param end              the index after the last cluster to process
+     * @param atomCoordinates  the original atom coordinates
+     * @param atomCoordinatesP the new atom coordinates
+     */
+    void applyToClusters(int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& atomCoordinatesP) const;
+
+    /**
+     * Apply the constraint algorithm to the velocities of a range of clusters on the calling thread.
+     *
+     * @param start            the index of the first cluster to process
+     * @param end              the index after the last cluster to process
+     * @param atomCoordinates  the atom coordinates
+     * @param velocities       the velocities to modify
+     * @param inverseMasses    1/mass
+     */
+    void applyToClusterVelocities(int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& velocities,
+                                  const std::vector<double>& inverseMasses) const;
+
+    /**
+     * The parameters of all clusters, stored as structures of arrays.  The per-cluster constants are padded
+     * at the end so a full SIMD vector can be loaded starting at any cluster.
+     */
+    struct ClusterData {
+        std::vector<int> atom1, atom2, atom3;
+        std::vector<float> mass1, mass2, mass3, invTotalMass, distance2, ra, rb, rc;
+    };
 private:
-    std::vector<ReferenceSETTLEAlgorithm*> threadSettle;
+    ClusterData clusters;
+    std::vector<int> blockStart;
+    bool useAvx;
     ThreadPool& threads;
 };
 
@@ -0,0 +1,278 @@
+#ifndef OPENMM_CPUSETTLEFVEC_H_
+#define OPENMM_CPUSETTLEFVEC_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2017 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuSETTLE.h"
+#include "openmm/internal/vectorize.h"
+#include <algorithm>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * Apply SETTLE to the positions of the clusters in [start, end).  Waters are processed in groups the
+ * width of FVEC.  Coordinates relative to the first atom of each water are gathered into structure of
+ * arrays form, the analytic solution is evaluated for the whole group at once, and the results are
+ * scattered back.
+ */
+template <class FVEC>
+void settlePositionsFvec(const CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<Vec3>& atomCoordinates, std::vector<Vec3>& atomCoordinatesP) {
+    const int width = sizeof(FVEC)/sizeof(float);
+    float lanes[15][width];
+    for (int first = start; first < end; first += width) {
+        int numInGroup = std::min(width, end-first);
+
+        // Gather the waters.  Unused lanes repeat the first one.
+
+        for (int k = 0; k < width; k++) {
+            int index = first + (k < numInGroup ? k : 0);
+            const Vec3& apos0 = atomCoordinates[clusters.atom1[index]];
+            const Vec3& apos1 = atomCoordinates[clusters.atom2[index]];
+            const Vec3& apos2 = atomCoordinates[clusters.atom3[index]];
+            Vec3 b0 = apos1-apos0;
+            Vec3 c0 = apos2-apos0;
+            Vec3 p0 = atomCoordinatesP[clusters.atom1[index]]-apos0;
+            Vec3 p1 = atomCoordinatesP[clusters.atom2[index]]-apos1;
+            Vec3 p2 = atomCoordinatesP[clusters.atom3[index]]-apos2;
+            for (int j = 0; j < 3; j++) {
+                lanes[j][k] = (float) b0[j];
+                lanes[3+j][k] = (float) c0[j];
+                lanes[6+j][k] = (float) p0[j];
+                lanes[9+j][k] = (float) p1[j];
+                lanes[12+j][k] = (float) p2[j];
+            }
+        }
+        FVEC xb0(lanes[0]), yb0(lanes[1]), zb0(lanes[2]);
+        FVEC xc0(lanes[3]), yc0(lanes[4]), zc0(lanes[5]);
+        FVEC xp0(lanes[6]), yp0(lanes[7]), zp0(lanes[8]);
+        FVEC xp1(lanes[9]), yp1(lanes[10]), zp1(lanes[11]);
+        FVEC xp2(lanes[12]), yp2(lanes[13]), zp2(lanes[14]);
+        FVEC m0(&clusters.mass1[first]), m1(&clusters.mass2[first]), m2(&clusters.mass3[first]);
+        FVEC invTotalMass(&clusters.invTotalMass[first]), distance2(&clusters.distance2[first]);
+        FVEC ra(&clusters.ra[first]), rb(&clusters.rb[first]), rc(&clusters.rc[first]);
+
+        // Apply the SETTLE algorithm.  See ReferenceSETTLEAlgorithm for details.
+
+        FVEC xcom = (xp0*m0 + (xb0+xp1)*m1 + (xc0+xp2)*m2) * invTotalMass;
+        FVEC ycom = (yp0*m0 + (yb0+yp1)*m1 + (yc0+yp2)*m2) * invTotalMass;
+        FVEC zcom = (zp0*m0 + (zb0+zp1)*m1 + (zc0+zp2)*m2) * invTotalMass;
+
+        FVEC xa1 = xp0 - xcom;
+        FVEC ya1 = yp0 - ycom;
+        FVEC za1 = zp0 - zcom;
+        FVEC xb1 = xb0 + xp1 - xcom;
+        FVEC yb1 = yb0 + yp1 - ycom;
+        FVEC zb1 = zb0 + zp1 - zcom;
+        FVEC xc1 = xc0 + xp2 - xcom;
+        FVEC yc1 = yc0 + yp2 - ycom;
+        FVEC zc1 = zc0 + zp2 - zcom;
+
+        FVEC xaksZd = yb0*zc0 - zb0*yc0;
+        FVEC yaksZd = zb0*xc0 - xb0*zc0;
+        FVEC zaksZd = xb0*yc0 - yb0*xc0;
+        FVEC xaksXd = ya1*zaksZd - za1*yaksZd;
+        FVEC yaksXd = za1*xaksZd - xa1*zaksZd;
+        FVEC zaksXd = xa1*yaksZd - ya1*xaksZd;
+        FVEC xaksYd = yaksZd*zaksXd - zaksZd*yaksXd;
+        FVEC yaksYd = zaksZd*xaksXd - xaksZd*zaksXd;
+        FVEC zaksYd = xaksZd*yaksXd - yaksZd*xaksXd;
+
+        FVEC axlng = sqrt(xaksXd*xaksXd + yaksXd*yaksXd + zaksXd*zaksXd);
+        FVEC aylng = sqrt(xaksYd*xaksYd + yaksYd*yaksYd + zaksYd*zaksYd);
+        FVEC azlng = sqrt(xaksZd*xaksZd + yaksZd*yaksZd + zaksZd*zaksZd);
+        FVEC trns11 = xaksXd / axlng;
+        FVEC trns21 = yaksXd / axlng;
+        FVEC trns31 = zaksXd / axlng;
+        FVEC trns12 = xaksYd / aylng;
+        FVEC trns22 = yaksYd / aylng;
+        FVEC trns32 = zaksYd / aylng;
+        FVEC trns13 = xaksZd / azlng;
+        FVEC trns23 = yaksZd / azlng;
+        FVEC trns33 = zaksZd / azlng;
+
+        FVEC xb0d = trns11*xb0 + trns21*yb0 + trns31*zb0;
+        FVEC yb0d = trns12*xb0 + trns22*yb0 + trns32*zb0;
+        FVEC xc0d = trns11*xc0 + trns21*yc0 + trns31*zc0;
+        FVEC yc0d = trns12*xc0 + trns22*yc0 + trns32*zc0;
+        FVEC za1d = trns13*xa1 + trns23*ya1 + trns33*za1;
+        FVEC xb1d = trns11*xb1 + trns21*yb1 + trns31*zb1;
+        FVEC yb1d = trns12*xb1 + trns22*yb1 + trns32*zb1;
+        FVEC zb1d = trns13*xb1 + trns23*yb1 + trns33*zb1;
+        FVEC xc1d = trns11*xc1 + trns21*yc1 + trns31*zc1;
+        FVEC yc1d = trns12*xc1 + trns22*yc1 + trns32*zc1;
+        FVEC zc1d = trns13*xc1 + trns23*yc1 + trns33*zc1;
+
+        FVEC sinphi = za1d / ra;
+        FVEC cosphi = sqrt(1.0f - sinphi*sinphi);
+        FVEC sinpsi = (zb1d - zc1d) / (2.0f*rc*cosphi);
+        FVEC cospsi = sqrt(1.0f - sinpsi*sinpsi);
+
+        FVEC ya2d = ra*cosphi;
+        FVEC xb2d = -rc*cospsi;
+        FVEC yb2d = -rb*cosphi - rc*sinpsi*sinphi;
+        FVEC yc2d = -rb*cosphi + rc*sinpsi*sinphi;
+        FVEC xb2d2 = xb2d*xb2d;
+        FVEC hh2 = 4.0f*xb2d2 + (yb2d-yc2d)*(yb2d-yc2d) + (zb1d-zc1d)*(zb1d-zc1d);
+        FVEC deltx = 2.0f*xb2d + sqrt(4.0f*xb2d2 - hh2 + distance2*distance2);
+        xb2d -= deltx*0.5f;
+
+        FVEC alpha = xb2d*(xb0d-xc0d) + yb0d*yb2d + yc0d*yc2d;
+        FVEC beta = xb2d*(yc0d-yb0d) + xb0d*yb2d + xc0d*yc2d;
+        FVEC gamma = xb0d*yb1d - xb1d*yb0d + xc0d*yc1d - xc1d*yc0d;
+        FVEC al2be2 = alpha*alpha + beta*beta;
+        FVEC sintheta = (alpha*gamma - beta*sqrt(al2be2 - gamma*gamma)) / al2be2;
+
+        FVEC costheta = sqrt(1.0f - sintheta*sintheta);
+        FVEC xa3d = -ya2d*sintheta;
+        FVEC ya3d = ya2d*costheta;
+        FVEC za3d = za1d;
+        FVEC xb3d = xb2d*costheta - yb2d*sintheta;
+        FVEC yb3d = xb2d*sintheta + yb2d*costheta;
+        FVEC zb3d = zb1d;
+        FVEC xc3d = -xb2d*costheta - yc2d*sintheta;
+        FVEC yc3d = -xb2d*sintheta + yc2d*costheta;
+        FVEC zc3d = zc1d;
+
+        (xcom + trns11*xa3d + trns12*ya3d + trns13*za3d).store(lanes[6]);
+        (ycom + trns21*xa3d + trns22*ya3d + trns23*za3d).store(lanes[7]);
+        (zcom + trns31*xa3d + trns32*ya3d + trns33*za3d).store(lanes[8]);
+        (xcom + trns11*xb3d + trns12*yb3d + trns13*zb3d - xb0).store(lanes[9]);
+        (ycom + trns21*xb3d + trns22*yb3d + trns23*zb3d - yb0).store(lanes[10]);
+        (zcom + trns31*xb3d + trns32*yb3d + trns33*zb3d - zb0).store(lanes[11]);
+        (xcom + trns11*xc3d + trns12*yc3d + trns13*zc3d - xc0).store(lanes[12]);
+        (ycom + trns21*xc3d + trns22*yc3d + trns23*zc3d - yc0).store(lanes[13]);
+        (zcom + trns31*xc3d + trns32*yc3d + trns33*zc3d - zc0).store(lanes[14]);
+
+        // Record the new positions.
+
+        for (int k = 0; k < numInGroup; k++) {
+            int atom1 = clusters.atom1[first+k], atom2 = clusters.atom2[first+k], atom3 = clusters.atom3[first+k];
+            atomCoordinatesP[atom1] = atomCoordinates[atom1]+Vec3(lanes[6][k], lanes[7][k], lanes[8][k]);
+            atomCoordinatesP[atom2] = atomCoordinates[atom2]+Vec3(lanes[9][k], lanes[10][k], lanes[11][k]);
+            atomCoordinatesP[atom3] = atomCoordinates[atom3]+Vec3(lanes[12][k], lanes[13][k], lanes[14][k]);
+        }
+    }
+}
+
+/**
+ * Apply SETTLE to the velocities of the clusters in [start, end), processing waters in groups the width
+ * of FVEC.
+ */
+template <class FVEC>
+void settleVelocitiesFvec(const CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<Vec3>& atomCoordinates, std::vector<Vec3>& velocities, const std::vector<double>& inverseMasses) {
+    const int width = sizeof(FVEC)/sizeof(float);
+    float lanes[21][width];
+    for (int first = start; first < end; first += width) {
+        int numInGroup = std::min(width, end-first);
+
+        // Gather the waters.  Unused lanes repeat the first one.
+
+        for (int k = 0; k < width; k++) {
+            int index = first + (k < numInGroup ? k : 0);
+            int atom1 = clusters.atom1[index], atom2 = clusters.atom2[index], atom3 = clusters.atom3[index];
+            Vec3 ab = atomCoordinates[atom2]-atomCoordinates[atom1];
+            Vec3 bc = atomCoordinates[atom3]-atomCoordinates[atom2];
+            Vec3 ca = atomCoordinates[atom1]-atomCoordinates[atom3];
+            for (int j = 0; j < 3; j++) {
+                lanes[j][k] = (float) ab[j];
+                lanes[3+j][k] = (float) bc[j];
+                lanes[6+j][k] = (float) ca[j];
+                lanes[9+j][k] = (float) velocities[atom1][j];
+                lanes[12+j][k] = (float) velocities[atom2][j];
+                lanes[15+j][k] = (float) velocities[atom3][j];
+            }
+            lanes[18][k] = (float) inverseMasses[atom1];
+            lanes[19][k] = (float) inverseMasses[atom2];
+            lanes[20][k] = (float) inverseMasses[atom3];
+        }
+        FVEC xAB(lanes[0]), yAB(lanes[1]), zAB(lanes[2]);
+        FVEC xBC(lanes[3]), yBC(lanes[4]), zBC(lanes[5]);
+        FVEC xCA(lanes[6]), yCA(lanes[7]), zCA(lanes[8]);
+        FVEC xv0(lanes[9]), yv0(lanes[10]), zv0(lanes[11]);
+        FVEC xv1(lanes[12]), yv1(lanes[13]), zv1(lanes[14]);
+        FVEC xv2(lanes[15]), yv2(lanes[16]), zv2(lanes[17]);
+        FVEC invMass0(lanes[18]), invMass1(lanes[19]), invMass2(lanes[20]);
+        FVEC mA(&clusters.mass1[first]), mB(&clusters.mass2[first]), mC(&clusters.mass3[first]);
+
+        // Solve for the constraint impulses.  See ReferenceSETTLEAlgorithm for details.
+
+        FVEC lengthAB = sqrt(xAB*xAB + yAB*yAB + zAB*zAB);
+        FVEC lengthBC = sqrt(xBC*xBC + yBC*yBC + zBC*zBC);
+        FVEC lengthCA = sqrt(xCA*xCA + yCA*yCA + zCA*zCA);
+        xAB /= lengthAB;
+        yAB /= lengthAB;
+        zAB /= lengthAB;
+        xBC /= lengthBC;
+        yBC /= lengthBC;
+        zBC /= lengthBC;
+        xCA /= lengthCA;
+        yCA /= lengthCA;
+        zCA /= lengthCA;
+        FVEC vAB = (xv1-xv0)*xAB + (yv1-yv0)*yAB + (zv1-zv0)*zAB;
+        FVEC vBC = (xv2-xv1)*xBC + (yv2-yv1)*yBC + (zv2-zv1)*zBC;
+        FVEC vCA = (xv0-xv2)*xCA + (yv0-yv2)*yCA + (zv0-zv2)*zCA;
+        FVEC cA = -(xAB*xCA + yAB*yCA + zAB*zCA);
+        FVEC cB = -(xAB*xBC + yAB*yBC + zAB*zBC);
+        FVEC cC = -(xBC*xCA + yBC*yCA + zBC*zCA);
+        FVEC s2A = 1.0f-cA*cA;
+        FVEC s2B = 1.0f-cB*cB;
+        FVEC s2C = 1.0f-cC*cC;
+        FVEC mABCinv = 1.0f/(mA*mB*mC);
+        FVEC mSum = mA+mB+mC;
+        FVEC denom = (((s2A*mB+s2B*mA)*mC+(s2A*mB*mB+2.0f*(cA*cB*cC+1.0f)*mA*mB+s2B*mA*mA))*mC+s2C*mA*mB*(mA+mB))*mABCinv;
+        FVEC tab = ((cB*cC*mA-cA*mB-cA*mC)*vCA + (cA*cC*mB-cB*mC-cB*mA)*vBC + (s2C*mA*mA*mB*mB*mABCinv+mSum)*vAB)/denom;
+        FVEC tbc = ((cA*cB*mC-cC*mB-cC*mA)*vCA + (s2A*mB*mB*mC*mC*mABCinv+mSum)*vBC + (cA*cC*mB-cB*mA-cB*mC)*vAB)/denom;
+        FVEC tca = ((s2B*mA*mA*mC*mC*mABCinv+mSum)*vCA + (cA*cB*mC-cC*mB-cC*mA)*vBC + (cB*cC*mA-cA*mB-cA*mC)*vAB)/denom;
+
+        // Store the velocity changes and apply them.
+
+        ((xAB*tab - xCA*tca)*invMass0).store(lanes[9]);
+        ((yAB*tab - yCA*tca)*invMass0).store(lanes[10]);
+        ((zAB*tab - zCA*tca)*invMass0).store(lanes[11]);
+        ((xBC*tbc - xAB*tab)*invMass1).store(lanes[12]);
+        ((yBC*tbc - yAB*tab)*invMass1).store(lanes[13]);
+        ((zBC*tbc - zAB*tab)*invMass1).store(lanes[14]);
+        ((xCA*tca - xBC*tbc)*invMass2).store(lanes[15]);
+        ((yCA*tca - yBC*tbc)*invMass2).store(lanes[16]);
+        ((zCA*tca - zBC*tbc)*invMass2).store(lanes[17]);
+        for (int k = 0; k < numInGroup; k++) {
+            velocities[clusters.atom1[first+k]] += Vec3(lanes[9][k], lanes[10][k], lanes[11][k]);
+            velocities[clusters.atom2[first+k]] += Vec3(lanes[12][k], lanes[13][k], lanes[14][k]);
+            velocities[clusters.atom3[first+k]] += Vec3(lanes[15][k], lanes[16][k], lanes[17][k]);
+        }
+    }
+}
+
+} // namespace OpenMM
+
+#endif /*OPENMM_CPUSETTLEFVEC_H_*/
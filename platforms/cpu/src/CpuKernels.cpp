@@ -45,13 +45,17 @@
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/internal/CustomNonbondedForceImpl.h"
 #include "openmm/internal/NonbondedForceImpl.h"
+#include "openmm/internal/timer.h"
 #include "openmm/internal/vectorize.h"
 #include "lepton/CompiledExpression.h"
 #include "lepton/CustomFunction.h"
 #include "lepton/Operation.h"
 #include "lepton/Parser.h"
-#include <iostream>
 #include "lepton/ParsedExpression.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
 
 using namespace OpenMM;
 using namespace std;
@@ -219,11 +223,18 @@ void CpuCalcForcesAndEnergyKernel::beginComputation(ContextImpl& context, bool i
             if (posq[i] != posq[i] || posq[i+1] != posq[i+1] || posq[i+2] != posq[i+2])
                 positionsValid = false;
 
-        // Clear the forces.
+        // Clear any forces left over from a computation that did not finish.  Normally finishComputation()
+        // has already cleared every block.
 
         fvec4 zero(0.0f);
-        for (int j = 0; j < numParticles; j++)
-            zero.store(&data.threadForce[threadIndex][j*4]);
+        vector<char>& touched = data.threadForceBlocks[threadIndex];
+        for (int block = 0; block < touched.size(); block++)
+            if (touched[block]) {
+                int blockEnd = min((block+1)*CpuPlatform::PlatformData::ForceBlockSize, numParticles);
+                for (int j = block*CpuPlatform::PlatformData::ForceBlockSize; j < blockEnd; j++)
+                    zero.store(&data.threadForce[threadIndex][j*4]);
+                touched[block] = 0;
+            }
     });
     data.threads.waitForThreads();
     if (!positionsValid)
@@ -279,27 +290,55 @@ void CpuCalcForcesAndEnergyKernel::beginComputation(ContextImpl& context, bool i
 }
 
 double CpuCalcForcesAndEnergyKernel::finishComputation(ContextImpl& context, bool includeForce, bool includeEnergy, int groups, bool& valid) {
+    // Wait for any work that kernels left running in the background.
+
+    double energy = 0.0;
+    for (auto computation : data.postComputations)
+        energy += computation->computeForceAndEnergy(includeForce, includeEnergy, groups);
+
     // Sum the forces from all the threads.
     
     data.threads.execute([&] (ThreadPool& threads, int threadIndex) {
-        // Sum the contributions to forces that have been calculated by different threads.
+        // Sum the contributions to forces that have been calculated by different threads.  Only blocks
+        // a thread has touched need to be read, and they are cleared for the next computation as we go.
         
+        const int blockSize = CpuPlatform::PlatformData::ForceBlockSize;
         int numParticles = context.getSystem().getNumParticles();
         int numThreads = threads.getNumThreads();
-        int start = threadIndex*numParticles/numThreads;
-        int end = (threadIndex+1)*numParticles/numThreads;
+        int numBlocks = (numParticles+blockSize-1)/blockSize;
+        int startBlock = threadIndex*numBlocks/numThreads;
+        int endBlock = (threadIndex+1)*numBlocks/numThreads;
         vector<Vec3>& forceData = extractForces(context);
-        for (int i = start; i < end; i++) {
-            fvec4 f(0.0f);
-            for (int j = 0; j < numThreads; j++)
-                f += fvec4(&data.threadForce[j][4*i]);
-            forceData[i][0] += f[0];
-            forceData[i][1] += f[1];
-            forceData[i][2] += f[2];
+        fvec4 zero(0.0f);
+        fvec4 sum[blockSize];
+        for (int block = startBlock; block < endBlock; block++) {
+            int start = block*blockSize;
+            int end = min(start+blockSize, numParticles);
+            bool anyTouched = false;
+            for (int j = 0; j < numThreads; j++) {
+                if (!data.threadForceBlocks[j][block])
+                    continue;
+                float* f = &data.threadForce[j][0];
+                for (int i = start; i < end; i++) {
+                    if (anyTouched)
+                        sum[i-start] += fvec4(&f[4*i]);
+                    else
+                        sum[i-start] = fvec4(&f[4*i]);
+                    zero.store(&f[4*i]);
+                }
+                data.threadForceBlocks[j][block] = 0;
+                anyTouched = true;
+            }
+            if (anyTouched)
+                for (int i = start; i < end; i++) {
+                    forceData[i][0] += sum[i-start][0];
+                    forceData[i][1] += sum[i-start][1];
+                    forceData[i][2] += sum[i-start][2];
+                }
         }
     });
     data.threads.waitForThreads();
-    return referenceKernel.getAs<ReferenceCalcForcesAndEnergyKernel>().finishComputation(context, includeForce, includeEnergy, groups, valid);
+    return energy+referenceKernel.getAs<ReferenceCalcForcesAndEnergyKernel>().finishComputation(context, includeForce, includeEnergy, groups, valid);
 }
 
 void CpuCalcHarmonicAngleForceKernel::initialize(const System& system, const HarmonicAngleForce& force) {
@@ -452,6 +491,31 @@ void CpuCalcRBTorsionForceKernel::copyParametersToContext(ContextImpl& context,
     }
 }
 
+/**
+ * The number of PME grids to try when tuning, and the number of force evaluations to time with each one.
+ */
+static const int NumPmeTuningGrids = 4;
+static const int NumPmeTuningSamples = 5;
+
+/**
+ * Find the smallest grid dimension that is at least as large as the minimum and has only small prime
+ * factors, so that the FFT is efficient.
+ */
+static int findFFTDimension(int minimum) {
+    if (minimum < 1)
+        return 1;
+    while (true) {
+        int unfactored = minimum;
+        for (int factor = 2; factor < 8; factor++) {
+            while (unfactored > 1 && unfactored%factor == 0)
+                unfactored /= factor;
+        }
+        if (unfactored == 1)
+            return minimum;
+        minimum++;
+    }
+}
+
 class CpuCalcNonbondedForceKernel::PmeIO : public CalcPmeReciprocalForceKernel::IO {
 public:
     PmeIO(float* posq, float* force, int numParticles) : posq(posq), force(force), numParticles(numParticles) {
@@ -472,21 +536,69 @@ private:
     int numParticles;
 };
 
+class CpuCalcNonbondedForceKernel::LJPmeIO : public CalcLJPmeReciprocalForceKernel::IO {
+public:
+    LJPmeIO(float* posq, float* c6, float* force, int numParticles) : posq(posq), c6(c6), force(force), numParticles(numParticles) {
+    }
+    float* getPosq() {
+        return posq;
+    }
+    float* getDispersionCoefficients() {
+        return c6;
+    }
+    void setForce(float* f) {
+        for (int i = 0; i < numParticles; i++) {
+            force[4*i] += f[4*i];
+            force[4*i+1] += f[4*i+1];
+            force[4*i+2] += f[4*i+2];
+        }
+    }
+private:
+    float* posq;
+    float* c6;
+    float* force;
+    int numParticles;
+};
+
+class CpuCalcNonbondedForceKernel::PmePostComputation : public CpuPlatform::PlatformData::ForcePostComputation {
+public:
+    PmePostComputation(CpuCalcNonbondedForceKernel& owner) : owner(owner) {
+    }
+    double computeForceAndEnergy(bool includeForces, bool includeEnergy, int groups) {
+        if (!owner.hasPendingPme)
+            return 0.0;
+        return owner.finishOptimizedPme(true);
+    }
+private:
+    CpuCalcNonbondedForceKernel& owner;
+};
+
 CpuNonbondedForce* createCpuNonbondedForceVec();
 
 CpuCalcNonbondedForceKernel::CpuCalcNonbondedForceKernel(string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcNonbondedForceKernel(name, platform),
-        data(data), hasInitializedPme(false), hasInitializedDispersionPme(false), nonbonded(NULL) {
+        data(data), hasInitializedPme(false), hasInitializedDispersionPme(false), isTuningPme(false), hasPendingPme(false), nonbonded(NULL), treecode(NULL),
+        dispersionCorrection(NULL), pmeio(NULL), ljpmeio(NULL) {
     nonbonded = createCpuNonbondedForceVec();
+    nonbonded->setForceBlockTracking(data.threadForceBlocks, CpuPlatform::PlatformData::ForceBlockSize);
 }
 
 CpuCalcNonbondedForceKernel::~CpuCalcNonbondedForceKernel() {
+    if (hasPendingPme)
+        finishOptimizedPme(false);
+    if (pmeio != NULL)
+        delete pmeio;
+    if (ljpmeio != NULL)
+        delete ljpmeio;
     if (nonbonded != NULL)
         delete nonbonded;
+    if (treecode != NULL)
+        delete treecode;
+    if (dispersionCorrection != NULL)
+        delete dispersionCorrection;
 }
 
 void CpuCalcNonbondedForceKernel::initialize(const System& system, const NonbondedForce& force) {
     chargePosqIndex = data.requestPosqIndex();
-    ljPosqIndex = data.requestPosqIndex();
 
     // Identify which exceptions are 1-4 interactions.
 
@@ -574,13 +686,22 @@ void CpuCalcNonbondedForceKernel::initialize(const System& system, const Nonbond
         exceptionParamOffsets[nb14Index[exception]].push_back(make_tuple(charge, sigma, epsilon, paramIndex));
     }
     paramValues.resize(paramNames.size(), 0.0);
+    for (int i = 0; i < numParticles; i++)
+        if (particleParamOffsets[i].size() > 0)
+            offsetParticleIndices.push_back(i);
+    for (int i = 0; i < num14; i++)
+        if (exceptionParamOffsets[i].size() > 0)
+            offsetExceptionIndices.push_back(i);
 
     // Record other parameters.
     
     nonbondedMethod = CalcNonbondedForceKernel::NonbondedMethod(force.getNonbondedMethod());
     nonbondedCutoff = force.getCutoffDistance();
-    if (nonbondedMethod == NoCutoff)
+    if (nonbondedMethod == NoCutoff) {
         useSwitchingFunction = false;
+        if (data.treecodeOpeningAngle > 0)
+            treecode = new CpuNonbondedTreecode(data.treecodeOpeningAngle);
+    }
     else {
         data.requestNeighborList(nonbondedCutoff, 0.25*nonbondedCutoff, true, exclusions);
         useSwitchingFunction = force.getUseSwitchingFunction();
@@ -593,26 +714,44 @@ void CpuCalcNonbondedForceKernel::initialize(const System& system, const Nonbond
     }
     else if (nonbondedMethod == PME) {
         double alpha;
-        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false);
+        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false, data.pmeOrder);
         ewaldAlpha = alpha;
     }
     else if (nonbondedMethod == LJPME) {
         double alpha;
-        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false);
+        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false, data.pmeOrder);
         ewaldAlpha = alpha;
-        NonbondedForceImpl::calcPMEParameters(system, force, alpha, dispersionGridSize[0], dispersionGridSize[1], dispersionGridSize[2], true);
+        NonbondedForceImpl::calcPMEParameters(system, force, alpha, dispersionGridSize[0], dispersionGridSize[1], dispersionGridSize[2], true, data.pmeOrder);
         ewaldDispersionAlpha = alpha;
         useSwitchingFunction = false;
     }
+    if (data.tunePme && (nonbondedMethod == PME || nonbondedMethod == LJPME)) {
+        // The cutoff also applies to the Lennard-Jones interaction, so it cannot be changed.  That fixes
+        // alpha, and leaves the grid as the only thing to tune.  Select a series of increasingly fine grids,
+        // each of which is at least as accurate as the default one.
+
+        isTuningPme = true;
+        pmeTuningSamples = 0;
+        pmeTuningTimes.push_back(numeric_limits<double>::max());
+        array<int, 3> grid;
+        for (int i = 0; i < 3; i++)
+            grid[i] = findFFTDimension(gridSize[i]);
+        for (int i = 0; i < NumPmeTuningGrids; i++) {
+            pmeTuningGrids.push_back(grid);
+            for (int j = 0; j < 3; j++)
+                grid[j] = findFFTDimension(grid[j]+1);
+        }
+        for (int i = 0; i < 3; i++)
+            gridSize[i] = pmeTuningGrids[0][i];
+    }
     if (nonbondedMethod == NoCutoff || nonbondedMethod == CutoffNonPeriodic)
         exceptionsArePeriodic = false;
     else
         exceptionsArePeriodic = force.getExceptionsUsePeriodicBoundaryConditions();
     rfDielectric = force.getReactionFieldDielectric();
     if (force.getUseDispersionCorrection())
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(system, force);
-    else
-        dispersionCoefficient = 0.0;
+        dispersionCorrection = new NonbondedForceImpl::DispersionCorrection(system, force);
+    dispersionCoefficient = 0.0;
     data.isPeriodic |= (nonbondedMethod == CutoffPeriodic || nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME);
 }
 
@@ -629,23 +768,25 @@ double CpuCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeFo
             useOptimizedPme = getPlatform().supportsKernels(kernelNames);
             if (useOptimizedPme) {
                 optimizedPme = getPlatform().createKernel(CalcPmeReciprocalForceKernel::Name(), context);
-                optimizedPme.getAs<CalcPmeReciprocalForceKernel>().initialize(gridSize[0], gridSize[1], gridSize[2], numParticles, ewaldAlpha, data.deterministicForces);
+                optimizedPme.getAs<CalcPmeReciprocalForceKernel>().initialize(gridSize[0], gridSize[1], gridSize[2], numParticles, ewaldAlpha, data.deterministicForces, data.pmeOrder);
             }
         }
         if (nonbondedMethod == LJPME) {
-            // If available, use the optimized PME implementation.
+            // If available, use the optimized implementation that computes electrostatics and dispersion together.
 
             vector<string> kernelNames;
-            kernelNames.push_back("CalcPmeReciprocalForce");
-            kernelNames.push_back("CalcDispersionPmeReciprocalForce");
+            kernelNames.push_back("CalcLJPmeReciprocalForce");
             useOptimizedPme = getPlatform().supportsKernels(kernelNames);
-            if (useOptimizedPme) {
-                optimizedPme = getPlatform().createKernel(CalcPmeReciprocalForceKernel::Name(), context);
-                optimizedPme.getAs<CalcPmeReciprocalForceKernel>().initialize(gridSize[0], gridSize[1], gridSize[2], numParticles, ewaldAlpha, data.deterministicForces);
-                optimizedDispersionPme = getPlatform().createKernel(CalcDispersionPmeReciprocalForceKernel::Name(), context);
-                optimizedDispersionPme.getAs<CalcDispersionPmeReciprocalForceKernel>().initialize(dispersionGridSize[0], dispersionGridSize[1],
-                                                                                                  dispersionGridSize[2], numParticles, ewaldDispersionAlpha, data.deterministicForces);
-            }
+            if (useOptimizedPme)
+                createOptimizedLJPme(context);
+        }
+        if (useOptimizedPme) {
+            pmePosq.resize(4*numParticles);
+            if (nonbondedMethod == LJPME)
+                ljpmeio = new LJPmeIO(&pmePosq[0], &C6params[0], &data.threadForce[0][0], numParticles);
+            else
+                pmeio = new PmeIO(&pmePosq[0], &data.threadForce[0][0], numParticles);
+            data.addPostComputation(new PmePostComputation(*this));
         }
     }
     computeParameters(context, true);
@@ -671,30 +812,37 @@ double CpuCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeFo
     if (ewald)
         nonbonded->setUseEwald(ewaldAlpha, kmax[0], kmax[1], kmax[2]);
     if (pme)
-        nonbonded->setUsePME(ewaldAlpha, gridSize);
+        nonbonded->setUsePME(ewaldAlpha, gridSize, data.pmeOrder);
     if (useSwitchingFunction)
         nonbonded->setUseSwitchingFunction(switchingDistance);
     if (ljpme){
-        nonbonded->setUsePME(ewaldAlpha, gridSize);
-        nonbonded->setUseLJPME(ewaldDispersionAlpha, dispersionGridSize);
+        nonbonded->setUsePME(ewaldAlpha, gridSize, data.pmeOrder);
+        nonbonded->setUseLJPME(ewaldDispersionAlpha, dispersionGridSize, data.pmeOrder);
     }
     double nonbondedEnergy = 0;
-    if (includeDirect)
-        nonbonded->calculateDirectIxn(numParticles, &posq[0], posData, particleParams, C6params, exclusions, data.threadForce, includeEnergy ? &nonbondedEnergy : NULL, data.threads);
-    if (includeReciprocal) {
-        if (useOptimizedPme) {
-            PmeIO io(&posq[0], &data.threadForce[0][0], numParticles);
-            Vec3 periodicBoxVectors[3] = {boxVectors[0], boxVectors[1], boxVectors[2]};
-            optimizedPme.getAs<CalcPmeReciprocalForceKernel>().beginComputation(io, periodicBoxVectors, includeEnergy);
-            nonbondedEnergy += optimizedPme.getAs<CalcPmeReciprocalForceKernel>().finishComputation(io);
-            if (nonbondedMethod == LJPME) {
-                copyChargesToPosq(context, C6params, ljPosqIndex);
-                optimizedDispersionPme.getAs<CalcDispersionPmeReciprocalForceKernel>().beginComputation(io, periodicBoxVectors, includeEnergy);
-                nonbondedEnergy += optimizedDispersionPme.getAs<CalcDispersionPmeReciprocalForceKernel>().finishComputation(io);
-            }
+    if (includeReciprocal && useOptimizedPme) {
+        // Start computing reciprocal space in the background, so it overlaps with direct space and every
+        // other force.  PmePostComputation collects the result at the end of the force computation.  While
+        // the grid is being tuned, it is finished right away so it can be timed.
+
+        double startTime = (isTuningPme ? getCurrentTime() : 0.0);
+        beginOptimizedPme(boxVectors, includeEnergy);
+        if (isTuningPme) {
+            nonbondedEnergy += finishOptimizedPme(true);
+            recordPmeTiming(context, getCurrentTime()-startTime);
         }
-        else
-            nonbonded->calculateReciprocalIxn(numParticles, &posq[0], posData, particleParams, C6params, exclusions, forceData, includeEnergy ? &nonbondedEnergy : NULL);
+    }
+    if (includeDirect && treecode != NULL) {
+        data.touchAllForceBlocks();
+        treecode->computeForce(numParticles, &posq[0], particleParams, exclusions, data.threadForce, includeEnergy ? &nonbondedEnergy : NULL, data.threads);
+    }
+    else if (includeDirect)
+        nonbonded->calculateDirectIxn(numParticles, &posq[0], posData, particleParams, C6params, exclusions, data.threadForce, includeEnergy ? &nonbondedEnergy : NULL, data.threads);
+    if (includeReciprocal && !useOptimizedPme) {
+        double startTime = (isTuningPme ? getCurrentTime() : 0.0);
+        nonbonded->calculateReciprocalIxn(numParticles, &posq[0], posData, particleParams, C6params, exclusions, forceData, includeEnergy ? &nonbondedEnergy : NULL);
+        if (isTuningPme)
+            recordPmeTiming(context, getCurrentTime()-startTime);
     }
     energy += nonbondedEnergy;
     if (includeDirect) {
@@ -745,19 +893,24 @@ void CpuCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context,
         bonded14IndexArray[i][0] = particle1;
         bonded14IndexArray[i][1] = particle2;
     }
-    computeParameters(context, false);
     
-    // Recompute the coefficient for the dispersion correction.
+    // Rebuild the dispersion correction, since the fixed classes may have changed.
 
     NonbondedForce::NonbondedMethod method = force.getNonbondedMethod();
-    if (force.getUseDispersionCorrection() && (method == NonbondedForce::CutoffPeriodic || method == NonbondedForce::Ewald || method == NonbondedForce::PME))
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(context.getSystem(), force);
+    if (force.getUseDispersionCorrection() && (method == NonbondedForce::CutoffPeriodic || method == NonbondedForce::Ewald || method == NonbondedForce::PME)) {
+        if (dispersionCorrection != NULL)
+            delete dispersionCorrection;
+        dispersionCorrection = new NonbondedForceImpl::DispersionCorrection(context.getSystem(), force);
+    }
+    computeParameters(context, false);
 }
 
 void CpuCalcNonbondedForceKernel::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
     if (nonbondedMethod != PME && nonbondedMethod != LJPME)
         throw OpenMMException("getPMEParametersInContext: This Context is not using PME");
-    if (useOptimizedPme)
+    if (useOptimizedPme && nonbondedMethod == LJPME)
+        optimizedLJPme.getAs<const CalcLJPmeReciprocalForceKernel>().getPMEParameters(alpha, nx, ny, nz);
+    else if (useOptimizedPme)
         optimizedPme.getAs<const CalcPmeReciprocalForceKernel>().getPMEParameters(alpha, nx, ny, nz);
     else {
         alpha = ewaldAlpha;
@@ -771,7 +924,7 @@ void CpuCalcNonbondedForceKernel::getLJPMEParameters(double& alpha, int& nx, int
     if (nonbondedMethod != LJPME)
         throw OpenMMException("getPMEParametersInContext: This Context is not using PME");
     if (useOptimizedPme)
-        optimizedDispersionPme.getAs<const CalcPmeReciprocalForceKernel>().getPMEParameters(alpha, nx, ny, nz);
+        optimizedLJPme.getAs<const CalcLJPmeReciprocalForceKernel>().getLJPMEParameters(alpha, nx, ny, nz);
     else {
         alpha = ewaldDispersionAlpha;
         nx = dispersionGridSize[0];
@@ -792,55 +945,179 @@ void CpuCalcNonbondedForceKernel::computeParameters(ContextImpl& context, bool o
     if (!paramChanged && offsetsOnly)
         return;
 
-    // Compute particle parameters.
+    // Compute particle parameters.  If only the values of global parameters have changed, just the
+    // particles that have offsets need to be updated, and the charges in posq can be patched in place.
 
-    if (hasParticleOffsets || !offsetsOnly) {
-        double sumSquaredCharges = 0.0;
+    if (!offsetsOnly) {
+        fixedSumSquaredCharges = 0.0;
+        fixedSumSquaredC6 = 0.0;
         for (int i = 0; i < numParticles; i++) {
-            double charge = baseParticleParams[i][0];
-            double sigma = baseParticleParams[i][1];
-            double epsilon = baseParticleParams[i][2];
-            for (auto& offset : particleParamOffsets[i]) {
-                double value = paramValues[get<3>(offset)];
-                charge += value*get<0>(offset);
-                sigma += value*get<1>(offset);
-                epsilon += value*get<2>(offset);
+            computeParticleParameters(i);
+            if (particleParamOffsets[i].size() == 0) {
+                fixedSumSquaredCharges += charges[i]*charges[i];
+                fixedSumSquaredC6 += C6params[i]*C6params[i];
             }
-            charges[i] = (float) charge;
-            particleParams[i] = make_pair((float) (0.5*sigma), (float) (2.0*sqrt(epsilon)));
-            C6params[i] = 8.0*pow(particleParams[i].first, 3.0) * particleParams[i].second;
-            sumSquaredCharges += charge*charge;
         }
-        if (nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME) {
-            ewaldSelfEnergy = -ONE_4PI_EPS0*ewaldAlpha*sumSquaredCharges/sqrt(M_PI);
-            if (nonbondedMethod == LJPME)
-                for (int atom = 0; atom < numParticles; atom++)
-                    ewaldSelfEnergy += pow(ewaldDispersionAlpha, 6.0) * C6params[atom]*C6params[atom] / 12.0;
-        }
-        else
-            ewaldSelfEnergy = 0.0;
         chargePosqIndex = data.requestPosqIndex();
-        ljPosqIndex = data.requestPosqIndex();
+    }
+    else if (hasParticleOffsets) {
+        AlignedArray<float>& posq = data.posq;
+        for (int i : offsetParticleIndices) {
+            computeParticleParameters(i);
+            if (data.currentPosqIndex == chargePosqIndex)
+                posq[4*i+3] = charges[i];
+        }
+    }
+    if (hasParticleOffsets || !offsetsOnly) {
+        double sumSquaredCharges = fixedSumSquaredCharges;
+        double sumSquaredC6 = fixedSumSquaredC6;
+        for (int i : offsetParticleIndices) {
+            sumSquaredCharges += charges[i]*charges[i];
+            sumSquaredC6 += C6params[i]*C6params[i];
+        }
+        computeSelfEnergy(sumSquaredCharges, sumSquaredC6);
     }
 
     // Compute exception parameters.
 
-    if (hasExceptionOffsets || !offsetsOnly) {
-        for (int i = 0; i < num14; i++) {
-            double chargeProd = baseExceptionParams[i][0];
-            double sigma = baseExceptionParams[i][1];
-            double epsilon = baseExceptionParams[i][2];
-            for (auto& offset : exceptionParamOffsets[i]) {
-                double value = paramValues[get<3>(offset)];
-                chargeProd += value*get<0>(offset);
-                sigma += value*get<1>(offset);
-                epsilon += value*get<2>(offset);
-            }
-            bonded14ParamArray[i][0] = sigma;
-            bonded14ParamArray[i][1] = 4.0*epsilon;
-            bonded14ParamArray[i][2] = chargeProd;
+    if (!offsetsOnly)
+        for (int i = 0; i < num14; i++)
+            computeExceptionParameters(i);
+    else if (hasExceptionOffsets)
+        for (int i : offsetExceptionIndices)
+            computeExceptionParameters(i);
+
+    // Compute the coefficient for the dispersion correction.  This only does any work if
+    // parameters it depends on have changed.
+
+    if (dispersionCorrection != NULL) {
+        vector<double> values;
+        for (const string& name : dispersionCorrection->getParameterNames())
+            values.push_back(context.getParameter(name));
+        dispersionCoefficient = dispersionCorrection->getCoefficient(values);
+    }
+}
+
+void CpuCalcNonbondedForceKernel::computeParticleParameters(int index) {
+    double charge = baseParticleParams[index][0];
+    double sigma = baseParticleParams[index][1];
+    double epsilon = baseParticleParams[index][2];
+    for (auto& offset : particleParamOffsets[index]) {
+        double value = paramValues[get<3>(offset)];
+        charge += value*get<0>(offset);
+        sigma += value*get<1>(offset);
+        epsilon += value*get<2>(offset);
+    }
+    charges[index] = (float) charge;
+    particleParams[index] = make_pair((float) (0.5*sigma), (float) (2.0*sqrt(epsilon)));
+    C6params[index] = 8.0*pow(particleParams[index].first, 3.0) * particleParams[index].second;
+}
+
+void CpuCalcNonbondedForceKernel::computeExceptionParameters(int index) {
+    double chargeProd = baseExceptionParams[index][0];
+    double sigma = baseExceptionParams[index][1];
+    double epsilon = baseExceptionParams[index][2];
+    for (auto& offset : exceptionParamOffsets[index]) {
+        double value = paramValues[get<3>(offset)];
+        chargeProd += value*get<0>(offset);
+        sigma += value*get<1>(offset);
+        epsilon += value*get<2>(offset);
+    }
+    bonded14ParamArray[index][0] = sigma;
+    bonded14ParamArray[index][1] = 4.0*epsilon;
+    bonded14ParamArray[index][2] = chargeProd;
+}
+
+void CpuCalcNonbondedForceKernel::setPmeGrid(ContextImpl& context, const array<int, 3>& grid) {
+    for (int i = 0; i < 3; i++)
+        gridSize[i] = grid[i];
+    if (useOptimizedPme && nonbondedMethod == LJPME)
+        createOptimizedLJPme(context);
+    else if (useOptimizedPme) {
+        optimizedPme = getPlatform().createKernel(CalcPmeReciprocalForceKernel::Name(), context);
+        optimizedPme.getAs<CalcPmeReciprocalForceKernel>().initialize(gridSize[0], gridSize[1], gridSize[2], numParticles, ewaldAlpha, data.deterministicForces, data.pmeOrder);
+    }
+}
+
+void CpuCalcNonbondedForceKernel::beginOptimizedPme(const Vec3* boxVectors, bool includeEnergy) {
+    // If a previous computation was abandoned (for example because another kernel threw an exception),
+    // its result must be collected before a new one can start.
+
+    if (hasPendingPme)
+        finishOptimizedPme(false);
+
+    // Other kernels may overwrite the charges in posq while this is running, so it works on a copy.
+
+    memcpy(&pmePosq[0], &data.posq[0], 4*numParticles*sizeof(float));
+    Vec3 periodicBoxVectors[3] = {boxVectors[0], boxVectors[1], boxVectors[2]};
+    if (nonbondedMethod == LJPME)
+        optimizedLJPme.getAs<CalcLJPmeReciprocalForceKernel>().beginComputation(*ljpmeio, periodicBoxVectors, includeEnergy);
+    else
+        optimizedPme.getAs<CalcPmeReciprocalForceKernel>().beginComputation(*pmeio, periodicBoxVectors, includeEnergy);
+    hasPendingPme = true;
+}
+
+double CpuCalcNonbondedForceKernel::finishOptimizedPme(bool recordForces) {
+    hasPendingPme = false;
+    if (!recordForces) {
+        // Wait for the computation to finish, but discard the result.
+
+        if (nonbondedMethod == LJPME) {
+            LJPmeIO io(&pmePosq[0], &C6params[0], NULL, 0);
+            optimizedLJPme.getAs<CalcLJPmeReciprocalForceKernel>().finishComputation(io);
         }
+        else {
+            PmeIO io(&pmePosq[0], NULL, 0);
+            optimizedPme.getAs<CalcPmeReciprocalForceKernel>().finishComputation(io);
+        }
+        return 0.0;
+    }
+    data.touchAllForceBlocks(0);
+    if (nonbondedMethod == LJPME)
+        return optimizedLJPme.getAs<CalcLJPmeReciprocalForceKernel>().finishComputation(*ljpmeio);
+    return optimizedPme.getAs<CalcPmeReciprocalForceKernel>().finishComputation(*pmeio);
+}
+
+void CpuCalcNonbondedForceKernel::createOptimizedLJPme(ContextImpl& context) {
+    optimizedLJPme = getPlatform().createKernel(CalcLJPmeReciprocalForceKernel::Name(), context);
+    optimizedLJPme.getAs<CalcLJPmeReciprocalForceKernel>().initialize(gridSize[0], gridSize[1], gridSize[2], dispersionGridSize[0], dispersionGridSize[1],
+            dispersionGridSize[2], numParticles, ewaldAlpha, ewaldDispersionAlpha, data.deterministicForces, data.pmeOrder);
+}
+
+void CpuCalcNonbondedForceKernel::recordPmeTiming(ContextImpl& context, double time) {
+    // The first evaluation with each grid includes one time setup costs, so it is not counted.
+    // Use the fastest of the remaining ones to reduce the effect of noise.
+
+    if (pmeTuningSamples > 0)
+        pmeTuningTimes.back() = min(pmeTuningTimes.back(), time);
+    if (++pmeTuningSamples <= NumPmeTuningSamples)
+        return;
+    int current = pmeTuningTimes.size()-1;
+    if (current+1 < pmeTuningGrids.size()) {
+        // Move on to the next grid.
+
+        setPmeGrid(context, pmeTuningGrids[current+1]);
+        pmeTuningTimes.push_back(numeric_limits<double>::max());
+        pmeTuningSamples = 0;
+        return;
+    }
+
+    // Every grid has been timed, so lock in the fastest one.
+
+    int best = min_element(pmeTuningTimes.begin(), pmeTuningTimes.end())-pmeTuningTimes.begin();
+    if (best != current)
+        setPmeGrid(context, pmeTuningGrids[best]);
+    isTuningPme = false;
+}
+
+void CpuCalcNonbondedForceKernel::computeSelfEnergy(double sumSquaredCharges, double sumSquaredC6) {
+    if (nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME) {
+        ewaldSelfEnergy = -ONE_4PI_EPS0*ewaldAlpha*sumSquaredCharges/sqrt(M_PI);
+        if (nonbondedMethod == LJPME)
+            ewaldSelfEnergy += pow(ewaldDispersionAlpha, 6.0)*sumSquaredC6/12.0;
     }
+    else
+        ewaldSelfEnergy = 0.0;
 }
 
 CpuCalcCustomNonbondedForceKernel::CpuCalcCustomNonbondedForceKernel(string name, const Platform& platform, CpuPlatform::PlatformData& data) :
@@ -968,6 +1245,7 @@ double CpuCalcCustomNonbondedForceKernel::execute(ContextImpl& context, bool inc
     if (useSwitchingFunction)
         nonbonded->setUseSwitchingFunction(switchingDistance);
     vector<double> energyParamDerivValues(energyParamDerivNames.size()+1, 0.0);
+    data.touchAllForceBlocks();
     nonbonded->calculatePairIxn(numParticles, &data.posq[0], posData, particleParamArray, globalParamValues, data.threadForce, includeForces, includeEnergy, energy, &energyParamDerivValues[0]);
     map<string, double>& energyParamDerivs = extractEnergyParameterDerivatives(context);
     for (int i = 0; i < energyParamDerivNames.size(); i++)
@@ -1042,6 +1320,7 @@ double CpuCalcGBSAOBCForceKernel::execute(ContextImpl& context, bool includeForc
         obc.setPeriodic(floatBoxSize);
     }
     double energy = 0.0;
+    data.touchAllForceBlocks();
     obc.computeForce(data.posq, data.threadForce, includeEnergy ? &energy : NULL, data.threads);
     return energy;
 }
@@ -1223,6 +1502,7 @@ double CpuCalcCustomGBForceKernel::execute(ContextImpl& context, bool includeFor
     for (auto& name : globalParameterNames)
         globalParameters[name] = context.getParameter(name);
     vector<double> energyParamDerivValues(energyParamDerivNames.size()+1, 0.0);
+    data.touchAllForceBlocks();
     ixn->calculateIxn(numParticles, &data.posq[0], particleParamArray, globalParameters, data.threadForce, includeForces, includeEnergy, energy, &energyParamDerivValues[0]);
     map<string, double>& energyParamDerivs = extractEnergyParameterDerivatives(context);
     for (int i = 0; i < energyParamDerivNames.size(); i++)
@@ -1281,6 +1561,7 @@ double CpuCalcCustomManyParticleForceKernel::execute(ContextImpl& context, bool
         ixn->setPeriodic(boxVectors);
     }
     double energy = 0;
+    data.touchAllForceBlocks();
     ixn->calculateIxn(data.posq, particleParamArray, globalParameters, data.threadForce, includeForces, includeEnergy, energy);
     return energy;
 }
@@ -1317,6 +1598,7 @@ void CpuCalcGayBerneForceKernel::initialize(const System& system, const GayBerne
 }
 
 double CpuCalcGayBerneForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    data.touchAllForceBlocks();
     return ixn->calculateForce(extractPositions(context), extractForces(context), data.threadForce, extractBoxVectors(context), data);
 }
 
@@ -1326,6 +1608,148 @@ void CpuCalcGayBerneForceKernel::copyParametersToContext(ContextImpl& context, c
     ixn = new CpuGayBerneForce(force);
 }
 
+void CpuCalcPositionRestraintForceKernel::initialize(const System& system, const PositionRestraintForce& force) {
+    // Sort the restraints by particle, so each thread can be given a range of restraints that no other
+    // thread shares particles with.  It can then add its forces directly to the output array.
+
+    int numRestraints = force.getNumRestraints();
+    vector<pair<int, int> > sorted(numRestraints);
+    for (int i = 0; i < numRestraints; i++) {
+        int particle;
+        Vec3 position;
+        double forceConstant, flatBottomRadius;
+        force.getRestraintParameters(i, particle, position, forceConstant, flatBottomRadius);
+        sorted[i] = make_pair(particle, i);
+    }
+    sort(sorted.begin(), sorted.end());
+    restraintIndex.resize(numRestraints);
+    particles.resize(numRestraints);
+    referencePos.resize(numRestraints);
+    k.resize(numRestraints);
+    radius.resize(numRestraints);
+    for (int i = 0; i < numRestraints; i++) {
+        double forceConstant, flatBottomRadius;
+        restraintIndex[i] = sorted[i].second;
+        force.getRestraintParameters(restraintIndex[i], particles[i], referencePos[i], forceConstant, flatBottomRadius);
+        k[i] = (float) forceConstant;
+        radius[i] = (float) flatBottomRadius;
+    }
+
+    // Divide the restraints between threads.
+
+    int numThreads = data.threads.getNumThreads();
+    threadStart.resize(numThreads+1);
+    threadStart[0] = 0;
+    for (int i = 1; i < numThreads; i++) {
+        int start = max(threadStart[i-1], (int) ((i*(long long) numRestraints)/numThreads));
+        while (start > 0 && start < numRestraints && particles[start] == particles[start-1])
+            start++;
+        threadStart[i] = start;
+    }
+    threadStart[numThreads] = numRestraints;
+    threadEnergy.resize(numThreads);
+    scaleParameter = force.getScaleParameterName();
+    usePeriodic = force.usesPeriodicBoundaryConditions();
+}
+
+double CpuCalcPositionRestraintForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<Vec3>& posData = extractPositions(context);
+    vector<Vec3>& forceData = extractForces(context);
+    Vec3* boxVectors = extractBoxVectors(context);
+    float scale = (float) context.getParameter(scaleParameter);
+    if (scale == 0.0f)
+        return 0.0;
+    data.threads.execute([&] (ThreadPool& threads, int threadIndex) {
+        threadEnergy[threadIndex] = 0.0;
+        computeRestraints(threadStart[threadIndex], threadStart[threadIndex+1], posData, forceData, boxVectors, scale, includeForces, threadEnergy[threadIndex]);
+    });
+    data.threads.waitForThreads();
+    double energy = 0.0;
+    for (double e : threadEnergy)
+        energy += e;
+    return energy;
+}
+
+void CpuCalcPositionRestraintForceKernel::computeRestraints(int start, int end, const vector<Vec3>& posData, vector<Vec3>& forceData,
+            const Vec3* boxVectors, float scale, bool includeForces, double& energy) {
+    fvec4 boxSize(boxVectors[0][0], boxVectors[1][1], boxVectors[2][2], 0);
+    fvec4 invBoxSize(1/boxVectors[0][0], 1/boxVectors[1][1], 1/boxVectors[2][2], 0);
+    bool triclinic = (boxVectors[0][1] != 0.0 || boxVectors[0][2] != 0.0 || boxVectors[1][0] != 0.0 ||
+                      boxVectors[1][2] != 0.0 || boxVectors[2][0] != 0.0 || boxVectors[2][1] != 0.0);
+    for (int first = start; first < end; first += 4) {
+        // Load the displacements from the reference positions for up to four restraints.  These are
+        // computed in double precision, since positions may be large compared to the displacements.
+
+        int count = min(4, end-first);
+        float dx[4] = {0}, dy[4] = {0}, dz[4] = {0}, kk[4] = {0}, rr[4] = {0};
+        for (int j = 0; j < count; j++) {
+            int i = first+j;
+            Vec3 delta = posData[particles[i]]-referencePos[i];
+            dx[j] = (float) delta[0];
+            dy[j] = (float) delta[1];
+            dz[j] = (float) delta[2];
+            kk[j] = k[i];
+            rr[j] = radius[i];
+        }
+        fvec4 deltaX(dx), deltaY(dy), deltaZ(dz);
+        if (usePeriodic) {
+            if (triclinic) {
+                fvec4 scale3 = round(deltaZ*invBoxSize[2]);
+                deltaX -= scale3*(float) boxVectors[2][0];
+                deltaY -= scale3*(float) boxVectors[2][1];
+                deltaZ -= scale3*(float) boxVectors[2][2];
+                fvec4 scale2 = round(deltaY*invBoxSize[1]);
+                deltaX -= scale2*(float) boxVectors[1][0];
+                deltaY -= scale2*(float) boxVectors[1][1];
+                fvec4 scale1 = round(deltaX*invBoxSize[0]);
+                deltaX -= scale1*(float) boxVectors[0][0];
+            }
+            else {
+                deltaX -= round(deltaX*invBoxSize[0])*boxSize[0];
+                deltaY -= round(deltaY*invBoxSize[1])*boxSize[1];
+                deltaZ -= round(deltaZ*invBoxSize[2])*boxSize[2];
+            }
+        }
+
+        // Compute the energy and forces.
+
+        fvec4 r = sqrt(deltaX*deltaX + deltaY*deltaY + deltaZ*deltaZ);
+        fvec4 flatBottomRadius(rr);
+        auto include = (r > flatBottomRadius);
+        if (!any(include))
+            continue;
+        fvec4 forceConstant = fvec4(kk)*scale;
+        fvec4 dr = r-flatBottomRadius;
+        energy += reduceAdd(blendZero(0.5f*forceConstant*dr*dr, include));
+        if (includeForces) {
+            fvec4 forceScale = blendZero(forceConstant*dr/r, include);
+            (forceScale*deltaX).store(dx);
+            (forceScale*deltaY).store(dy);
+            (forceScale*deltaZ).store(dz);
+            for (int j = 0; j < count; j++) {
+                Vec3& f = forceData[particles[first+j]];
+                f[0] -= dx[j];
+                f[1] -= dy[j];
+                f[2] -= dz[j];
+            }
+        }
+    }
+}
+
+void CpuCalcPositionRestraintForceKernel::copyParametersToContext(ContextImpl& context, const PositionRestraintForce& force) {
+    if (force.getNumRestraints() != restraintIndex.size())
+        throw OpenMMException("updateParametersInContext: The number of restraints has changed");
+    for (int i = 0; i < restraintIndex.size(); i++) {
+        int particle;
+        double forceConstant, flatBottomRadius;
+        force.getRestraintParameters(restraintIndex[i], particle, referencePos[i], forceConstant, flatBottomRadius);
+        if (particle != particles[i])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+        k[i] = (float) forceConstant;
+        radius[i] = (float) flatBottomRadius;
+    }
+}
+
 CpuIntegrateLangevinStepKernel::~CpuIntegrateLangevinStepKernel() {
     if (dynamics)
         delete dynamics;
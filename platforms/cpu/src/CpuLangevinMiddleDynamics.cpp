@@ -24,17 +24,97 @@
 
 #include "SimTKOpenMMUtilities.h"
 #include "CpuLangevinMiddleDynamics.h"
+#include "ReferenceConstraints.h"
+#include "ReferencePlatform.h"
+#include "ReferenceVirtualSites.h"
+#include "openmm/internal/ContextImpl.h"
+#include <algorithm>
 
 using namespace OpenMM;
 using namespace std;
 
 CpuLangevinMiddleDynamics::CpuLangevinMiddleDynamics(int numberOfAtoms, double deltaT, double friction, double temperature, ThreadPool& threads, CpuRandom& random) : 
-           ReferenceLangevinMiddleDynamics(numberOfAtoms, deltaT, friction, temperature), threads(threads), random(random) {
+           ReferenceLangevinMiddleDynamics(numberOfAtoms, deltaT, friction, temperature), threads(threads), random(random),
+           blockSettle(NULL), hasBlocks(false) {
 }
 
 CpuLangevinMiddleDynamics::~CpuLangevinMiddleDynamics() {
 }
 
+void CpuLangevinMiddleDynamics::update(ContextImpl& context, vector<Vec3>& atomCoordinates,
+                                       vector<Vec3>& velocities, vector<double>& masses, double tolerance) {
+    // The fused update can only be used if any constraints are rigid waters handled by CpuSETTLE.
+
+    const CpuSETTLE* settle = NULL;
+    ReferenceConstraintAlgorithm* constraintAlgorithm = getReferenceConstraintAlgorithm();
+    if (constraintAlgorithm != NULL) {
+        ReferenceConstraints* constraints = dynamic_cast<ReferenceConstraints*>(constraintAlgorithm);
+        if (constraints == NULL || constraints->ccma != NULL) {
+            ReferenceLangevinMiddleDynamics::update(context, atomCoordinates, velocities, masses, tolerance);
+            return;
+        }
+        if (constraints->settle != NULL) {
+            settle = dynamic_cast<CpuSETTLE*>(constraints->settle);
+            if (settle == NULL) {
+                ReferenceLangevinMiddleDynamics::update(context, atomCoordinates, velocities, masses, tolerance);
+                return;
+            }
+        }
+    }
+    numberOfAtoms = context.getSystem().getNumParticles();
+    vector<double>& inverseMasses = ReferenceLangevinMiddleDynamics::inverseMasses;
+    if (getTimeStep() == 0) {
+        // Invert masses
+
+        for (int i = 0; i < numberOfAtoms; i++) {
+            if (masses[i] == 0.0)
+                inverseMasses[i] = 0.0;
+            else
+                inverseMasses[i] = 1.0/masses[i];
+        }
+    }
+    if (!hasBlocks || settle != blockSettle)
+        createBlocks(settle);
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    vector<Vec3>& forces = *data->forces;
+    threads.execute([&] (ThreadPool& threads, int threadIndex) { threadUpdateFused(threadIndex, settle, atomCoordinates, velocities, forces); });
+    threads.waitForThreads();
+    ReferenceVirtualSites::computePositions(context.getSystem(), atomCoordinates);
+    incrementTimeStep();
+}
+
+void CpuLangevinMiddleDynamics::createBlocks(const CpuSETTLE* settle) {
+    // Divide the atoms into contiguous blocks that are small enough to stay in cache while every phase
+    // of the step is applied to them.  Block boundaries are moved forward as needed so that no water is
+    // split between two blocks.  Clusters are sorted by their first atom, so the waters in each block
+    // are a contiguous range of clusters.
+
+    const int targetBlockSize = 1024;
+    int numThreads = threads.getNumThreads();
+    int numBlocks = max(numThreads, (numberOfAtoms+targetBlockSize-1)/targetBlockSize);
+    int numClusters = (settle == NULL ? 0 : settle->getNumClusters());
+    blockAtomStart.clear();
+    blockClusterStart.clear();
+    blockAtomStart.push_back(0);
+    blockClusterStart.push_back(0);
+    int cluster = 0;
+    for (int block = 1; block <= numBlocks; block++) {
+        int boundary = max(blockAtomStart.back(), (int) ((long long) block*numberOfAtoms/numBlocks));
+        while (cluster < numClusters) {
+            int atom1, atom2, atom3;
+            settle->getClusterAtoms(cluster, atom1, atom2, atom3);
+            if (min(atom1, min(atom2, atom3)) >= boundary)
+                break;
+            boundary = max(boundary, max(atom1, max(atom2, atom3))+1);
+            cluster++;
+        }
+        blockAtomStart.push_back(boundary);
+        blockClusterStart.push_back(cluster);
+    }
+    blockSettle = settle;
+    hasBlocks = true;
+}
+
 void CpuLangevinMiddleDynamics::updatePart1(int numberOfAtoms, vector<Vec3>& velocities, vector<Vec3>& forces, vector<double>& inverseMasses) {
     // Record the parameters for the threads.
     
@@ -81,6 +161,51 @@ void CpuLangevinMiddleDynamics::updatePart3(ContextImpl& context, int numberOfAt
     threads.waitForThreads();
 }
 
+void CpuLangevinMiddleDynamics::threadUpdateFused(int threadIndex, const CpuSETTLE* settle, vector<Vec3>& atomCoordinates,
+                                                  vector<Vec3>& velocities, vector<Vec3>& forces) {
+    const double dt = getDeltaT();
+    const double halfdt = 0.5*dt;
+    const double kT = BOLTZ*getTemperature();
+    const double friction = getFriction();
+    const double vscale = exp(-dt*friction);
+    const double noisescale = sqrt(1-vscale*vscale);
+    vector<Vec3>& xPrime = ReferenceLangevinMiddleDynamics::xPrime;
+    vector<double>& inverseMasses = ReferenceLangevinMiddleDynamics::inverseMasses;
+
+    // Each thread always processes the same blocks in the same order, so the random numbers are
+    // reproducible for a given number of threads.
+
+    int numBlocks = blockAtomStart.size()-1;
+    int firstBlock = threadIndex*numBlocks/threads.getNumThreads();
+    int lastBlock = (threadIndex+1)*numBlocks/threads.getNumThreads();
+    for (int block = firstBlock; block < lastBlock; block++) {
+        int start = blockAtomStart[block];
+        int end = blockAtomStart[block+1];
+        for (int i = start; i < end; i++)
+            if (inverseMasses[i] != 0.0)
+                velocities[i] += (dt*inverseMasses[i])*forces[i];
+        if (settle != NULL)
+            settle->applyToClusterVelocities(blockClusterStart[block], blockClusterStart[block+1], atomCoordinates, velocities, inverseMasses);
+        for (int i = start; i < end; i++) {
+            if (inverseMasses[i] != 0.0) {
+                xPrime[i] = atomCoordinates[i] + velocities[i]*halfdt;
+                Vec3 noise(random.getGaussianRandom(threadIndex), random.getGaussianRandom(threadIndex), random.getGaussianRandom(threadIndex));
+                velocities[i] = vscale*velocities[i] + noisescale*sqrt(kT*inverseMasses[i])*noise;
+                xPrime[i] = xPrime[i] + velocities[i]*halfdt;
+                oldx[i] = xPrime[i];
+            }
+        }
+        if (settle != NULL)
+            settle->applyToClusters(blockClusterStart[block], blockClusterStart[block+1], atomCoordinates, xPrime);
+        for (int i = start; i < end; i++) {
+            if (inverseMasses[i] != 0.0) {
+                velocities[i] += (xPrime[i]-oldx[i])/dt;
+                atomCoordinates[i] = xPrime[i];
+            }
+        }
+    }
+}
+
 void CpuLangevinMiddleDynamics::threadUpdate1(int threadIndex) {
     int start = threadIndex*numberOfAtoms/threads.getNumThreads();
     int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
@@ -48,7 +48,7 @@ const int CpuNonbondedForce::NUM_TABLE_POINTS = 2048;
    --------------------------------------------------------------------------------------- */
 
 CpuNonbondedForce::CpuNonbondedForce() : cutoff(false), useSwitch(false), periodic(false), periodicExceptions(false), ewald(false), pme(false), ljpme(false), tableIsValid(false), expTableIsValid(false),
-    cutoffDistance(0.0f), alphaDispersionEwald(0.0f), alphaEwald(0.0f) {
+    cutoffDistance(0.0f), alphaDispersionEwald(0.0f), alphaEwald(0.0f), touchedBlocks(NULL), touchedBlockShift(0) {
 }
 
 CpuNonbondedForce::~CpuNonbondedForce() {
@@ -158,16 +158,18 @@ void CpuNonbondedForce::setUseEwald(float alpha, int kmaxx, int kmaxy, int kmaxz
 
      @param alpha  the Ewald separation parameter
      @param gridSize the dimensions of the mesh
+     @param order    the B-spline interpolation order
 
      --------------------------------------------------------------------------------------- */
 
-void CpuNonbondedForce::setUsePME(float alpha, int meshSize[3]) {
+void CpuNonbondedForce::setUsePME(float alpha, int meshSize[3], int order) {
     if (alpha != alphaEwald)
         tableIsValid = false;
     alphaEwald = alpha;
     meshDim[0] = meshSize[0];
     meshDim[1] = meshSize[1];
     meshDim[2] = meshSize[2];
+    pmeOrder = order;
     pme = true;
     tabulateEwaldScaleFactor();
 }
@@ -179,16 +181,18 @@ void CpuNonbondedForce::setUsePME(float alpha, int meshSize[3]) {
 
      @param alpha  the Ewald separation parameter
      @param gridSize the dimensions of the mesh
+     @param order    the B-spline interpolation order
 
      --------------------------------------------------------------------------------------- */
 
-void CpuNonbondedForce::setUseLJPME(float alpha, int meshSize[3]) {
+void CpuNonbondedForce::setUseLJPME(float alpha, int meshSize[3], int order) {
     if (alpha != alphaDispersionEwald)
         expTableIsValid = false;
     alphaDispersionEwald = alpha;
     dispersionMeshDim[0] = meshSize[0];
     dispersionMeshDim[1] = meshSize[1];
     dispersionMeshDim[2] = meshSize[2];
+    dispersionPmeOrder = order;
     ljpme = true;
     tabulateExpTerms();
     if(cutoffDistance != 0.0f){
@@ -206,6 +210,13 @@ void CpuNonbondedForce::setPeriodicExceptions(bool periodic) {
     periodicExceptions = periodic;
 }
 
+void CpuNonbondedForce::setForceBlockTracking(vector<vector<char> >& touchedBlocks, int blockSize) {
+    this->touchedBlocks = &touchedBlocks;
+    touchedBlockShift = 0;
+    while ((1<<touchedBlockShift) < blockSize)
+        touchedBlockShift++;
+}
+
 void CpuNonbondedForce::tabulateEwaldScaleFactor() {
     if (tableIsValid)
         return;
@@ -257,7 +268,7 @@ void CpuNonbondedForce::calculateReciprocalIxn(int numberOfAtoms, float* posq, c
 
     if (pme) {
         pme_t pmedata;
-        pme_init(&pmedata, alphaEwald, numberOfAtoms, meshDim, 5, 1);
+        pme_init(&pmedata, alphaEwald, numberOfAtoms, meshDim, pmeOrder, 1);
         vector<double> charges(numberOfAtoms);
         for (int i = 0; i < numberOfAtoms; i++)
             charges[i] = posq[4*i+3];
@@ -269,7 +280,7 @@ void CpuNonbondedForce::calculateReciprocalIxn(int numberOfAtoms, float* posq, c
 
         if (ljpme) {
             // Dispersion reciprocal space terms
-            pme_init(&pmedata,alphaDispersionEwald,numberOfAtoms,dispersionMeshDim,5,1);
+            pme_init(&pmedata,alphaDispersionEwald,numberOfAtoms,dispersionMeshDim,dispersionPmeOrder,1);
 
             std::vector<Vec3> dpmeforces;
             for (int i = 0; i < numberOfAtoms; i++){
@@ -426,13 +437,30 @@ void CpuNonbondedForce::threadComputeDirect(ThreadPool& threads, int threadIndex
     float* forces = &(*threadForce)[threadIndex][0];
     fvec4 boxSize(periodicBoxVectors[0][0], periodicBoxVectors[1][1], periodicBoxVectors[2][2], 0);
     fvec4 invBoxSize(recipBoxSize[0], recipBoxSize[1], recipBoxSize[2], 0);
+    char* touched = NULL;
+    if (touchedBlocks != NULL) {
+        touched = &(*touchedBlocks)[threadIndex][0];
+        if (!cutoff)
+            fill(touched, touched+(*touchedBlocks)[threadIndex].size(), 1);
+    }
+
+    // Neighbor list blocks are sorted along a space filling curve.  Handing them out in contiguous chunks
+    // keeps the atoms each thread touches close together, so it adds forces to fewer blocks of atoms.
+
+    int numBlocks = (cutoff ? neighborList->getNumBlocks() : 0);
+    int chunkSize = max(1, numBlocks/(8*numThreads));
     if (ewald || pme || ljpme) {
         // Compute the interactions from the neighbor list.
         while (true) {
-            int nextBlock = atomicCounter++;
-            if (nextBlock >= neighborList->getNumBlocks())
+            int firstBlock = atomicCounter.fetch_add(chunkSize);
+            if (firstBlock >= numBlocks)
                 break;
-            calculateBlockEwaldIxn(nextBlock, forces, energyPtr, boxSize, invBoxSize);
+            int lastBlock = min(firstBlock+chunkSize, numBlocks);
+            for (int nextBlock = firstBlock; nextBlock < lastBlock; nextBlock++) {
+                calculateBlockEwaldIxn(nextBlock, forces, energyPtr, boxSize, invBoxSize);
+                if (touched != NULL)
+                    recordTouchedBlocks(nextBlock, touched);
+            }
         }
 
         // Now subtract off the exclusions, since they were implicitly included in the reciprocal space sum.
@@ -450,6 +478,10 @@ void CpuNonbondedForce::threadComputeDirect(ThreadPool& threads, int threadIndex
                 for (int excluded : exclusions[i]) {
                     if (excluded > i) {
                         int j = excluded;
+                        if (touched != NULL) {
+                            touched[i>>touchedBlockShift] = 1;
+                            touched[j>>touchedBlockShift] = 1;
+                        }
                         fvec4 deltaR;
                         fvec4 posJ((float) atomCoordinates[j][0], (float) atomCoordinates[j][1], (float) atomCoordinates[j][2], 0.0f);
                         float r2;
@@ -490,10 +522,15 @@ void CpuNonbondedForce::threadComputeDirect(ThreadPool& threads, int threadIndex
         // Compute the interactions from the neighbor list.
 
         while (true) {
-            int nextBlock = atomicCounter++;
-            if (nextBlock >= neighborList->getNumBlocks())
+            int firstBlock = atomicCounter.fetch_add(chunkSize);
+            if (firstBlock >= numBlocks)
                 break;
-            calculateBlockIxn(nextBlock, forces, energyPtr, boxSize, invBoxSize);
+            int lastBlock = min(firstBlock+chunkSize, numBlocks);
+            for (int nextBlock = firstBlock; nextBlock < lastBlock; nextBlock++) {
+                calculateBlockIxn(nextBlock, forces, energyPtr, boxSize, invBoxSize);
+                if (touched != NULL)
+                    recordTouchedBlocks(nextBlock, touched);
+            }
         }
     }
     else {
@@ -510,6 +547,15 @@ void CpuNonbondedForce::threadComputeDirect(ThreadPool& threads, int threadIndex
     }
 }
 
+void CpuNonbondedForce::recordTouchedBlocks(int blockIndex, char* touched) const {
+    int blockSize = neighborList->getBlockSize();
+    const int32_t* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+    for (int i = 0; i < blockSize; i++)
+        touched[blockAtom[i]>>touchedBlockShift] = 1;
+    for (int atom : neighborList->getBlockNeighbors(blockIndex))
+        touched[atom>>touchedBlockShift] = 1;
+}
+
 void CpuNonbondedForce::calculateOneIxn(int ii, int jj, float* forces, double* totalEnergy, const fvec4& boxSize, const fvec4& invBoxSize) {
     // get deltaR, R2, and R between 2 atoms
 
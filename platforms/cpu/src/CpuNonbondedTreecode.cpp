@@ -0,0 +1,461 @@
+
+/* Portions copyright (c) 2026 Stanford University and Simbios.
+ * Contributors: Pande Group
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "CpuNonbondedTreecode.h"
+#include "SimTKOpenMMRealType.h"
+#include "openmm/internal/vectorize.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace OpenMM;
+
+const int CpuNonbondedTreecode::MaxLeafSize = 32;
+
+// Binomial coefficients for expanding (sigma_i+sigma_j)^12 and (sigma_i+sigma_j)^6.
+
+static const double binomial12[] = {1, 12, 66, 220, 495, 792, 924, 792, 495, 220, 66, 12, 1};
+static const double binomial6[] = {1, 6, 15, 20, 15, 6, 1};
+
+struct CpuNonbondedTreecode::Node {
+    int start, end, firstChild, numChildren;
+    double boxMin[3], boxMax[3], center[3], width;
+    // Coulomb moments: total charge, dipole, and traceless quadrupole (xx, xy, xz, yy, yz, zz).
+    double charge, dipole[3], quadrupole[6];
+    // Lennard-Jones moments about the epsilon weighted center: ljMonopole[k] is the sum over atoms
+    // of 2*sqrt(epsilon)*(sigma/2)^k.
+    double ljCenter[3], ljMonopole[13], ljDipole[13][3];
+    bool hasCharge, hasLJ;
+};
+
+struct CpuNonbondedTreecode::InteractionList {
+    std::vector<int> stack, farNodes, nearLeaves;
+};
+
+CpuNonbondedTreecode::CpuNonbondedTreecode(float openingAngle) : openingAngle(openingAngle) {
+}
+
+CpuNonbondedTreecode::~CpuNonbondedTreecode() {
+}
+
+void CpuNonbondedTreecode::computeForce(int numberOfAtoms, const float* posq, const vector<pair<float, float> >& atomParameters,
+            const vector<set<int> >& exclusions, vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->posq = posq;
+    this->atomParameters = &atomParameters[0];
+    this->exclusions = &exclusions[0];
+    this->threadForce = &threadForce;
+    includeEnergy = (totalEnergy != NULL);
+    int numThreads = threads.getNumThreads();
+    threadEnergy.resize(numThreads);
+    if (threadIncluded.size() != numThreads || threadIncluded[0].size() != numberOfAtoms+4) {
+        // Each thread keeps a mask of which atoms (in tree order) the current atom interacts with.
+        // It is padded so the near field loop can always read four elements.
+
+        threadIncluded.resize(numThreads);
+        for (auto& included : threadIncluded) {
+            included.resize(numberOfAtoms+4);
+            fill(included.begin(), included.begin()+numberOfAtoms, 1.0f);
+            fill(included.begin()+numberOfAtoms, included.end(), 0.0f);
+        }
+    }
+
+    // Nodes closer than the most distant excluded pair are never used as multipoles, so every
+    // excluded pair ends up in the near field.
+
+    maxExclusionDistance = 0.0;
+    for (int i = 0; i < numberOfAtoms; i++)
+        for (int j : exclusions[i])
+            if (j > i) {
+                double dx = posq[4*i]-posq[4*j];
+                double dy = posq[4*i+1]-posq[4*j+1];
+                double dz = posq[4*i+2]-posq[4*j+2];
+                maxExclusionDistance = max(maxExclusionDistance, sqrt(dx*dx+dy*dy+dz*dz));
+            }
+
+    // Build the tree.
+
+    sortedAtoms.resize(numberOfAtoms);
+    for (int i = 0; i < numberOfAtoms; i++)
+        sortedAtoms[i] = i;
+    nodes.resize(1);
+    leaves.clear();
+    if (numberOfAtoms == 0)
+        return;
+    buildNode(0, 0, numberOfAtoms);
+
+    // Record the atom data in tree order, so the near field loop reads contiguous memory.
+
+    atomPosition.resize(numberOfAtoms);
+    for (auto array : {&sortedX, &sortedY, &sortedZ, &sortedCharge, &sortedSigma, &sortedEpsilon})
+        array->resize(numberOfAtoms+4, 0.0f);
+    for (int i = 0; i < numberOfAtoms; i++) {
+        int atom = sortedAtoms[i];
+        atomPosition[atom] = i;
+        sortedX[i] = posq[4*atom];
+        sortedY[i] = posq[4*atom+1];
+        sortedZ[i] = posq[4*atom+2];
+        sortedCharge[i] = posq[4*atom+3];
+        sortedSigma[i] = atomParameters[atom].first;
+        sortedEpsilon[i] = atomParameters[atom].second;
+    }
+
+    // Signal the threads to start running and wait for them to finish.
+
+    atomicCounter = 0;
+    threads.execute([&] (ThreadPool& threads, int threadIndex) { threadComputeForce(threads, threadIndex); });
+    threads.waitForThreads();
+
+    // Combine the energies from all the threads.
+
+    if (totalEnergy != NULL) {
+        double energy = 0;
+        for (int i = 0; i < numThreads; i++)
+            energy += threadEnergy[i];
+        *totalEnergy += energy;
+    }
+}
+
+void CpuNonbondedTreecode::buildNode(int nodeIndex, int start, int end) {
+    Node& node = nodes[nodeIndex];
+    node.start = start;
+    node.end = end;
+    node.firstChild = -1;
+    node.numChildren = 0;
+
+    // Find the bounding box.
+
+    for (int k = 0; k < 3; k++)
+        node.boxMin[k] = node.boxMax[k] = posq[4*sortedAtoms[start]+k];
+    for (int i = start+1; i < end; i++) {
+        const float* pos = &posq[4*sortedAtoms[i]];
+        for (int k = 0; k < 3; k++) {
+            node.boxMin[k] = min(node.boxMin[k], (double) pos[k]);
+            node.boxMax[k] = max(node.boxMax[k], (double) pos[k]);
+        }
+    }
+    node.width = 0.0;
+    for (int k = 0; k < 3; k++) {
+        node.center[k] = 0.5*(node.boxMin[k]+node.boxMax[k]);
+        node.width = max(node.width, node.boxMax[k]-node.boxMin[k]);
+    }
+
+    // Compute the multipole moments.  The Coulomb expansion is about the center of the box.  The
+    // Lennard-Jones one is about the epsilon weighted center, which makes it exact for a single atom.
+
+    double totalWeight = 0.0;
+    for (int k = 0; k < 3; k++)
+        node.ljCenter[k] = 0.0;
+    for (int i = start; i < end; i++) {
+        int atom = sortedAtoms[i];
+        double w = atomParameters[atom].second;
+        totalWeight += w;
+        for (int k = 0; k < 3; k++)
+            node.ljCenter[k] += w*posq[4*atom+k];
+    }
+    for (int k = 0; k < 3; k++)
+        node.ljCenter[k] = (totalWeight == 0.0 ? node.center[k] : node.ljCenter[k]/totalWeight);
+
+    node.charge = 0.0;
+    for (int k = 0; k < 3; k++)
+        node.dipole[k] = 0.0;
+    for (int k = 0; k < 6; k++)
+        node.quadrupole[k] = 0.0;
+    for (int k = 0; k < 13; k++) {
+        node.ljMonopole[k] = 0.0;
+        node.ljDipole[k][0] = node.ljDipole[k][1] = node.ljDipole[k][2] = 0.0;
+    }
+    node.hasCharge = false;
+    node.hasLJ = false;
+    for (int i = start; i < end; i++) {
+        int atom = sortedAtoms[i];
+        double dx = posq[4*atom]-node.center[0];
+        double dy = posq[4*atom+1]-node.center[1];
+        double dz = posq[4*atom+2]-node.center[2];
+        double q = posq[4*atom+3];
+        if (q != 0.0) {
+            node.hasCharge = true;
+            double d2 = dx*dx+dy*dy+dz*dz;
+            node.charge += q;
+            node.dipole[0] += q*dx;
+            node.dipole[1] += q*dy;
+            node.dipole[2] += q*dz;
+            node.quadrupole[0] += q*(1.5*dx*dx-0.5*d2);
+            node.quadrupole[1] += q*1.5*dx*dy;
+            node.quadrupole[2] += q*1.5*dx*dz;
+            node.quadrupole[3] += q*(1.5*dy*dy-0.5*d2);
+            node.quadrupole[4] += q*1.5*dy*dz;
+            node.quadrupole[5] += q*(1.5*dz*dz-0.5*d2);
+        }
+        double w = atomParameters[atom].second;
+        if (w != 0.0) {
+            node.hasLJ = true;
+            double s = atomParameters[atom].first;
+            double ljdx = posq[4*atom]-node.ljCenter[0];
+            double ljdy = posq[4*atom+1]-node.ljCenter[1];
+            double ljdz = posq[4*atom+2]-node.ljCenter[2];
+            for (int k = 0; k < 13; k++) {
+                node.ljMonopole[k] += w;
+                node.ljDipole[k][0] += w*ljdx;
+                node.ljDipole[k][1] += w*ljdy;
+                node.ljDipole[k][2] += w*ljdz;
+                w *= s;
+            }
+        }
+    }
+    if (end-start <= MaxLeafSize) {
+        leaves.push_back(nodeIndex);
+        return;
+    }
+
+    // Split the atoms at the median along the longest axis, so every leaf ends up with between
+    // MaxLeafSize/2 and MaxLeafSize atoms.
+
+    int axis = 0;
+    for (int k = 1; k < 3; k++)
+        if (node.boxMax[k]-node.boxMin[k] > node.boxMax[axis]-node.boxMin[axis])
+            axis = k;
+    int middle = (start+end)/2;
+    nth_element(sortedAtoms.begin()+start, sortedAtoms.begin()+middle, sortedAtoms.begin()+end,
+            [&] (int a, int b) { return posq[4*a+axis] < posq[4*b+axis]; });
+    int firstChild = nodes.size();
+    node.firstChild = firstChild;
+    node.numChildren = 2;
+    nodes.resize(firstChild+2);
+    buildNode(firstChild, start, middle);
+    buildNode(firstChild+1, middle, end);
+}
+
+void CpuNonbondedTreecode::threadComputeForce(ThreadPool& threads, int threadIndex) {
+    double energy = 0;
+    float* forces = &(*threadForce)[threadIndex][0];
+    vector<float>& included = threadIncluded[threadIndex];
+    InteractionList list;
+    while (true) {
+        int nextLeaf = atomicCounter++;
+        if (nextLeaf >= leaves.size())
+            break;
+        const Node& leaf = nodes[leaves[nextLeaf]];
+        buildInteractionList(leaf, list);
+        computeFarFieldIxn(leaf, list, forces, energy);
+        for (int i = leaf.start; i < leaf.end; i++) {
+            int atom = sortedAtoms[i];
+            included[i] = 0.0f;
+            for (int j : exclusions[atom])
+                included[atomPosition[j]] = 0.0f;
+            computeNearFieldIxn(i, list, included, forces, energy);
+            included[i] = 1.0f;
+            for (int j : exclusions[atom])
+                included[atomPosition[j]] = 1.0f;
+        }
+    }
+    threadEnergy[threadIndex] = energy;
+}
+
+void CpuNonbondedTreecode::buildInteractionList(const Node& target, InteractionList& list) const {
+    // Walk the tree, deciding how every atom in the target leaf will interact with each node.
+
+    const double angle2 = openingAngle*openingAngle;
+    const double minDistance2 = maxExclusionDistance*maxExclusionDistance;
+    list.farNodes.clear();
+    list.nearLeaves.clear();
+    list.stack.clear();
+    list.stack.push_back(0);
+    while (!list.stack.empty()) {
+        int nodeIndex = list.stack.back();
+        list.stack.pop_back();
+        const Node& node = nodes[nodeIndex];
+        if (!node.hasCharge && !node.hasLJ)
+            continue;
+        double boxDistance2 = 0.0;
+        for (int k = 0; k < 3; k++) {
+            double d = max(node.boxMin[k]-target.boxMax[k], target.boxMin[k]-node.boxMax[k]);
+            if (d > 0.0)
+                boxDistance2 += d*d;
+        }
+        if (boxDistance2 > minDistance2 && node.width*node.width < angle2*boxDistance2)
+            list.farNodes.push_back(nodeIndex);
+        else if (node.numChildren == 0)
+            list.nearLeaves.push_back(nodeIndex);
+        else
+            for (int i = 0; i < node.numChildren; i++)
+                list.stack.push_back(node.firstChild+i);
+    }
+}
+
+void CpuNonbondedTreecode::computeFarFieldIxn(const Node& leaf, const InteractionList& list, float* forces, double& energy) const {
+    // Interact with the multipole expansions of distant nodes.  This is done for four atoms of the leaf at
+    // a time.  Lanes past the end of the leaf duplicate the first atom, but with no charge or epsilon.
+
+    for (int start = leaf.start; start < leaf.end; start += 4) {
+        int count = min(4, leaf.end-start);
+        float posX[4], posY[4], posZ[4], chargeI[4], sigmaI[4], epsilonI[4];
+        for (int lane = 0; lane < 4; lane++) {
+            int i = (lane < count ? start+lane : start);
+            posX[lane] = sortedX[i];
+            posY[lane] = sortedY[i];
+            posZ[lane] = sortedZ[i];
+            chargeI[lane] = (lane < count ? (float) (ONE_4PI_EPS0*sortedCharge[i]) : 0.0f);
+            sigmaI[lane] = sortedSigma[i];
+            epsilonI[lane] = (lane < count ? sortedEpsilon[i] : 0.0f);
+        }
+        bool anyCharge = (chargeI[0] != 0.0f || chargeI[1] != 0.0f || chargeI[2] != 0.0f || chargeI[3] != 0.0f);
+        bool anyLJ = (epsilonI[0] != 0.0f || epsilonI[1] != 0.0f || epsilonI[2] != 0.0f || epsilonI[3] != 0.0f);
+        const fvec4 x(posX), y(posY), z(posZ), q(chargeI), eps(epsilonI);
+
+        // Precompute the coefficients that combine each atom's sigma with the Lennard-Jones moments.
+
+        fvec4 coeff12[13], coeff6[7];
+        if (anyLJ) {
+            fvec4 sigmaPower[13];
+            sigmaPower[0] = fvec4(1.0f);
+            for (int k = 1; k < 13; k++)
+                sigmaPower[k] = sigmaPower[k-1]*fvec4(sigmaI);
+            for (int k = 0; k < 13; k++)
+                coeff12[k] = sigmaPower[12-k]*(float) binomial12[k];
+            for (int k = 0; k < 7; k++)
+                coeff6[k] = sigmaPower[6-k]*(float) binomial6[k];
+        }
+        fvec4 fx(0.0f), fy(0.0f), fz(0.0f);
+        double groupEnergy = 0.0;
+        for (int nodeIndex : list.farNodes) {
+            const Node& node = nodes[nodeIndex];
+            fvec4 nodeEnergy(0.0f);
+            if (anyCharge && node.hasCharge) {
+                fvec4 rx = x-(float) node.center[0];
+                fvec4 ry = y-(float) node.center[1];
+                fvec4 rz = z-(float) node.center[2];
+                fvec4 invR2 = 1.0f/(rx*rx + ry*ry + rz*rz);
+                fvec4 invR = sqrt(invR2);
+                fvec4 invR3 = invR*invR2;
+                fvec4 invR5 = invR3*invR2;
+                fvec4 invR7 = invR5*invR2;
+                const double* D = node.dipole;
+                const double* Q = node.quadrupole;
+                fvec4 DR = rx*(float) D[0] + ry*(float) D[1] + rz*(float) D[2];
+                fvec4 QRx = rx*(float) Q[0] + ry*(float) Q[1] + rz*(float) Q[2];
+                fvec4 QRy = rx*(float) Q[1] + ry*(float) Q[3] + rz*(float) Q[4];
+                fvec4 QRz = rx*(float) Q[2] + ry*(float) Q[4] + rz*(float) Q[5];
+                fvec4 RQR = rx*QRx + ry*QRy + rz*QRz;
+                nodeEnergy += q*(invR*(float) node.charge + DR*invR3 + RQR*invR5);
+                fvec4 radial = -(invR3*(float) node.charge + 3.0f*DR*invR5 + 5.0f*RQR*invR7);
+                fx -= q*(radial*rx + invR3*(float) D[0] + 2.0f*QRx*invR5);
+                fy -= q*(radial*ry + invR3*(float) D[1] + 2.0f*QRy*invR5);
+                fz -= q*(radial*rz + invR3*(float) D[2] + 2.0f*QRz*invR5);
+            }
+            if (anyLJ && node.hasLJ) {
+                fvec4 rx = x-(float) node.ljCenter[0];
+                fvec4 ry = y-(float) node.ljCenter[1];
+                fvec4 rz = z-(float) node.ljCenter[2];
+                fvec4 invR2 = 1.0f/(rx*rx + ry*ry + rz*rz);
+                fvec4 A12(0.0f), A6(0.0f), V12x(0.0f), V12y(0.0f), V12z(0.0f), V6x(0.0f), V6y(0.0f), V6z(0.0f);
+                for (int k = 0; k < 13; k++) {
+                    A12 += coeff12[k]*(float) node.ljMonopole[k];
+                    V12x += coeff12[k]*(float) node.ljDipole[k][0];
+                    V12y += coeff12[k]*(float) node.ljDipole[k][1];
+                    V12z += coeff12[k]*(float) node.ljDipole[k][2];
+                }
+                for (int k = 0; k < 7; k++) {
+                    A6 += coeff6[k]*(float) node.ljMonopole[k];
+                    V6x += coeff6[k]*(float) node.ljDipole[k][0];
+                    V6y += coeff6[k]*(float) node.ljDipole[k][1];
+                    V6z += coeff6[k]*(float) node.ljDipole[k][2];
+                }
+                fvec4 invR6 = invR2*invR2*invR2;
+                fvec4 invR8 = invR6*invR2;
+                fvec4 invR10 = invR8*invR2;
+                fvec4 invR12 = invR6*invR6;
+                fvec4 invR14 = invR12*invR2;
+                fvec4 invR16 = invR14*invR2;
+                fvec4 VR12 = V12x*rx + V12y*ry + V12z*rz;
+                fvec4 VR6 = V6x*rx + V6y*ry + V6z*rz;
+                nodeEnergy += eps*(A12*invR12 + 12.0f*VR12*invR14 - A6*invR6 - 6.0f*VR6*invR8);
+                fvec4 radial = -12.0f*A12*invR14 - 168.0f*VR12*invR16 + 6.0f*A6*invR8 + 48.0f*VR6*invR10;
+                fx -= eps*(radial*rx + 12.0f*V12x*invR14 - 6.0f*V6x*invR8);
+                fy -= eps*(radial*ry + 12.0f*V12y*invR14 - 6.0f*V6y*invR8);
+                fz -= eps*(radial*rz + 12.0f*V12z*invR14 - 6.0f*V6z*invR8);
+            }
+            if (includeEnergy)
+                groupEnergy += reduceAdd(nodeEnergy);
+        }
+
+        // Every pair is visited from both atoms, so each one only records half the energy.
+
+        float forceX[4], forceY[4], forceZ[4];
+        fx.store(forceX);
+        fy.store(forceY);
+        fz.store(forceZ);
+        for (int lane = 0; lane < count; lane++) {
+            int atom = sortedAtoms[start+lane];
+            forces[4*atom] += forceX[lane];
+            forces[4*atom+1] += forceY[lane];
+            forces[4*atom+2] += forceZ[lane];
+        }
+        energy += 0.5*groupEnergy;
+    }
+}
+
+void CpuNonbondedTreecode::computeNearFieldIxn(int position, const InteractionList& list, const vector<float>& included, float* forces, double& energy) const {
+    // Compute the interactions with atoms in nearby leaves directly, four at a time.  Excluded atoms and
+    // lanes past the end of the leaf have a mask of 0, which makes every term vanish.
+
+    const float chargeI = (float) (ONE_4PI_EPS0*sortedCharge[position]);
+    const float sigmaI = sortedSigma[position];
+    const float epsilonI = sortedEpsilon[position];
+    const fvec4 posX(sortedX[position]), posY(sortedY[position]), posZ(sortedZ[position]);
+    const fvec4 laneIndex(0.0f, 1.0f, 2.0f, 3.0f);
+    fvec4 fx(0.0f), fy(0.0f), fz(0.0f);
+    double nearEnergy = 0.0;
+    for (int leafIndex : list.nearLeaves) {
+        const Node& node = nodes[leafIndex];
+        const fvec4 end((float) node.end);
+        fvec4 leafEnergy(0.0f);
+        for (int i = node.start; i < node.end; i += 4) {
+            fvec4 mask = blendZero(fvec4(&included[i]), laneIndex+fvec4((float) i) < end);
+            fvec4 dx = posX-fvec4(&sortedX[i]);
+            fvec4 dy = posY-fvec4(&sortedY[i]);
+            fvec4 dz = posZ-fvec4(&sortedZ[i]);
+            fvec4 r2 = dx*dx + dy*dy + dz*dz;
+            fvec4 inverseR = mask/sqrt(r2 + (1.0f-mask));
+            fvec4 sig2 = inverseR*(sigmaI+fvec4(&sortedSigma[i]));
+            sig2 *= sig2;
+            fvec4 sig6 = sig2*sig2*sig2;
+            fvec4 eps = epsilonI*fvec4(&sortedEpsilon[i]);
+            fvec4 chargeProdOverR = chargeI*fvec4(&sortedCharge[i])*inverseR;
+            fvec4 dEdR = (eps*(12.0f*sig6-6.0f)*sig6 + chargeProdOverR)*inverseR*inverseR;
+            leafEnergy += eps*(sig6-1.0f)*sig6 + chargeProdOverR;
+            fx += dx*dEdR;
+            fy += dy*dEdR;
+            fz += dz*dEdR;
+        }
+        nearEnergy += reduceAdd(leafEnergy);
+    }
+    int atom = sortedAtoms[position];
+    forces[4*atom] += reduceAdd(fx);
+    forces[4*atom+1] += reduceAdd(fy);
+    forces[4*atom+2] += reduceAdd(fz);
+    if (includeEnergy)
+        energy += 0.5*nearEnergy;
+}
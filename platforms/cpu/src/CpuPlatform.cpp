@@ -59,6 +59,7 @@ extern "C" OPENMM_EXPORT_CPU void registerPlatforms() {
 #endif
 
 map<const ContextImpl*, CpuPlatform::PlatformData*> CpuPlatform::contextData;
+const int CpuPlatform::PlatformData::ForceBlockSize;
 
 CpuPlatform::CpuPlatform() {
     deprecatedPropertyReplacements["CpuThreads"] = CpuThreads();
@@ -73,10 +74,17 @@ CpuPlatform::CpuPlatform() {
     registerKernelFactory(CalcGBSAOBCForceKernel::Name(), factory);
     registerKernelFactory(CalcCustomGBForceKernel::Name(), factory);
     registerKernelFactory(CalcGayBerneForceKernel::Name(), factory);
+    registerKernelFactory(CalcPositionRestraintForceKernel::Name(), factory);
     registerKernelFactory(IntegrateLangevinStepKernel::Name(), factory);
     registerKernelFactory(IntegrateLangevinMiddleStepKernel::Name(), factory);
     platformProperties.push_back(CpuThreads());
     platformProperties.push_back(CpuDeterministicForces());
+    platformProperties.push_back(CpuTunePme());
+    platformProperties.push_back(CpuPmeOrder());
+    platformProperties.push_back(CpuTreecodeOpeningAngle());
+    platformProperties.push_back(CpuAffinity());
+    platformProperties.push_back(CpuNumaPolicy());
+    platformProperties.push_back(CpuSharedThreadPool());
     int threads = getNumProcessors();
     char* threadsEnv = getenv("OPENMM_CPU_THREADS");
     if (threadsEnv != NULL)
@@ -85,6 +93,13 @@ CpuPlatform::CpuPlatform() {
     defaultThreads << threads;
     setPropertyDefaultValue(CpuThreads(), defaultThreads.str());
     setPropertyDefaultValue(CpuDeterministicForces(), "false");
+    setPropertyDefaultValue(CpuTunePme(), "false");
+    setPropertyDefaultValue(CpuPmeOrder(), "5");
+    setPropertyDefaultValue(CpuTreecodeOpeningAngle(), "0");
+    setPropertyDefaultValue(CpuAffinity(), "");
+    setPropertyDefaultValue(CpuNumaPolicy(), "none");
+    char* sharedEnv = getenv("OPENMM_CPU_SHARED_THREAD_POOL");
+    setPropertyDefaultValue(CpuSharedThreadPool(), sharedEnv == NULL ? "false" : sharedEnv);
 }
 
 const string& CpuPlatform::getPropertyValue(const Context& context, const string& property) const {
@@ -111,17 +126,73 @@ bool CpuPlatform::isProcessorSupported() {
     return isVec4Supported();
 }
 
+/**
+ * Parse a list of processors such as "0-3,8,10-11".
+ */
+static vector<int> parseProcessorList(const string& list) {
+    vector<int> processors;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        int first, last;
+        char separator;
+        stringstream itemStream(item);
+        if (!(itemStream >> first))
+            throw OpenMMException("Illegal value for CpuAffinity: "+list);
+        last = first;
+        if (itemStream >> separator) {
+            if (separator != '-' || !(itemStream >> last))
+                throw OpenMMException("Illegal value for CpuAffinity: "+list);
+        }
+        if (!(itemStream >> ws).eof() || first < 0 || last < first)
+            throw OpenMMException("Illegal value for CpuAffinity: "+list);
+        for (int i = first; i <= last; i++)
+            processors.push_back(i);
+    }
+    return processors;
+}
+
 void CpuPlatform::contextCreated(ContextImpl& context, const map<string, string>& properties) const {
     ReferencePlatform::contextCreated(context, properties);
     const string& threadsPropValue = (properties.find(CpuThreads()) == properties.end() ?
             getPropertyDefaultValue(CpuThreads()) : properties.find(CpuThreads())->second);
     string deterministicForcesValue = (properties.find(CpuDeterministicForces()) == properties.end() ?
             getPropertyDefaultValue(CpuDeterministicForces()) : properties.find(CpuDeterministicForces())->second);
+    string tunePmeValue = (properties.find(CpuTunePme()) == properties.end() ?
+            getPropertyDefaultValue(CpuTunePme()) : properties.find(CpuTunePme())->second);
+    const string& pmeOrderPropValue = (properties.find(CpuPmeOrder()) == properties.end() ?
+            getPropertyDefaultValue(CpuPmeOrder()) : properties.find(CpuPmeOrder())->second);
+    const string& treecodePropValue = (properties.find(CpuTreecodeOpeningAngle()) == properties.end() ?
+            getPropertyDefaultValue(CpuTreecodeOpeningAngle()) : properties.find(CpuTreecodeOpeningAngle())->second);
+    const string& affinityPropValue = (properties.find(CpuAffinity()) == properties.end() ?
+            getPropertyDefaultValue(CpuAffinity()) : properties.find(CpuAffinity())->second);
+    string numaPolicyValue = (properties.find(CpuNumaPolicy()) == properties.end() ?
+            getPropertyDefaultValue(CpuNumaPolicy()) : properties.find(CpuNumaPolicy())->second);
+    string sharedThreadPoolValue = (properties.find(CpuSharedThreadPool()) == properties.end() ?
+            getPropertyDefaultValue(CpuSharedThreadPool()) : properties.find(CpuSharedThreadPool())->second);
     int numThreads;
     stringstream(threadsPropValue) >> numThreads;
     transform(deterministicForcesValue.begin(), deterministicForcesValue.end(), deterministicForcesValue.begin(), ::tolower);
     bool deterministicForces = (deterministicForcesValue == "true");
-    PlatformData* data = new PlatformData(context.getSystem().getNumParticles(), numThreads, deterministicForces);
+    transform(tunePmeValue.begin(), tunePmeValue.end(), tunePmeValue.begin(), ::tolower);
+    bool tunePme = (tunePmeValue == "true");
+    int pmeOrder;
+    stringstream(pmeOrderPropValue) >> pmeOrder;
+    if (pmeOrder < 4 || pmeOrder > 8)
+        throw OpenMMException("Illegal value for PmeOrder: "+pmeOrderPropValue);
+    double treecodeOpeningAngle = -1;
+    stringstream(treecodePropValue) >> treecodeOpeningAngle;
+    if (treecodeOpeningAngle < 0 || treecodeOpeningAngle >= 1)
+        throw OpenMMException("Illegal value for TreecodeOpeningAngle: "+treecodePropValue);
+    vector<int> processors = parseProcessorList(affinityPropValue);
+    transform(numaPolicyValue.begin(), numaPolicyValue.end(), numaPolicyValue.begin(), ::tolower);
+    if (numaPolicyValue != "none" && numaPolicyValue != "local")
+        throw OpenMMException("Illegal value for NumaPolicy: "+numaPolicyValue);
+    bool localMemory = (numaPolicyValue == "local");
+    transform(sharedThreadPoolValue.begin(), sharedThreadPoolValue.end(), sharedThreadPoolValue.begin(), ::tolower);
+    bool sharedThreadPool = (sharedThreadPoolValue == "true");
+    PlatformData* data = new PlatformData(context.getSystem().getNumParticles(), numThreads, deterministicForces, tunePme, pmeOrder, treecodeOpeningAngle,
+            processors, localMemory, sharedThreadPool);
     contextData[&context] = data;
     ReferenceConstraints& constraints = *(ReferenceConstraints*) reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData())->constraints;
     if (constraints.settle != NULL) {
@@ -147,22 +218,62 @@ const CpuPlatform::PlatformData& CpuPlatform::getPlatformData(const ContextImpl&
     return *contextData[&context];
 }
 
-CpuPlatform::PlatformData::PlatformData(int numParticles, int numThreads, bool deterministicForces) : posq(4*numParticles), threads(numThreads),
-        deterministicForces(deterministicForces), neighborList(NULL), cutoff(0.0), paddedCutoff(0.0), anyExclusions(false), currentPosqIndex(-1), nextPosqIndex(0) {
+CpuPlatform::PlatformData::PlatformData(int numParticles, int numThreads, bool deterministicForces, bool tunePme, int pmeOrder, double treecodeOpeningAngle,
+            const vector<int>& processors, bool localMemory, bool sharedThreadPool) : posq(4*numParticles), threads(numThreads, processors, sharedThreadPool),
+        deterministicForces(deterministicForces), tunePme(tunePme), neighborList(NULL), cutoff(0.0), paddedCutoff(0.0), anyExclusions(false),
+        currentPosqIndex(-1), nextPosqIndex(0), pmeOrder(pmeOrder), treecodeOpeningAngle(treecodeOpeningAngle) {
     numThreads = threads.getNumThreads();
     threadForce.resize(numThreads);
+    if (localMemory) {
+        // Each thread allocates its own force buffer, and touches the block of posq it will later fill in,
+        // so the operating system places the pages on that thread's memory node.
+
+        threads.execute([&] (ThreadPool& threads, int threadIndex) {
+            threadForce[threadIndex].resize(4*numParticles);
+            int start = threadIndex*numParticles/numThreads;
+            int end = (threadIndex+1)*numParticles/numThreads;
+            for (int i = 0; i < 4*numParticles; i++)
+                threadForce[threadIndex][i] = 0.0f;
+            for (int i = 4*start; i < 4*end; i++)
+                posq[i] = 0.0f;
+        });
+        threads.waitForThreads();
+    }
+    else {
+        for (int i = 0; i < numThreads; i++)
+            threadForce[i].resize(4*numParticles);
+    }
+
+    // Nothing has been cleared yet, so mark every block as touched.
+
+    threadForceBlocks.resize(numThreads);
     for (int i = 0; i < numThreads; i++)
-        threadForce[i].resize(4*numParticles);
+        threadForceBlocks[i].resize((numParticles+ForceBlockSize-1)/ForceBlockSize, 1);
     isPeriodic = false;
     stringstream threadsProperty;
     threadsProperty << numThreads;
     propertyValues[CpuThreads()] = threadsProperty.str();
     propertyValues[CpuDeterministicForces()] = deterministicForces ? "true" : "false";
+    propertyValues[CpuTunePme()] = tunePme ? "true" : "false";
+    stringstream pmeOrderProperty;
+    pmeOrderProperty << pmeOrder;
+    propertyValues[CpuPmeOrder()] = pmeOrderProperty.str();
+    stringstream treecodeProperty;
+    treecodeProperty << treecodeOpeningAngle;
+    propertyValues[CpuTreecodeOpeningAngle()] = treecodeProperty.str();
+    stringstream affinityProperty;
+    for (int i = 0; i < processors.size(); i++)
+        affinityProperty << (i > 0 ? "," : "") << processors[i];
+    propertyValues[CpuAffinity()] = affinityProperty.str();
+    propertyValues[CpuNumaPolicy()] = localMemory ? "local" : "none";
+    propertyValues[CpuSharedThreadPool()] = sharedThreadPool ? "true" : "false";
 }
 
 CpuPlatform::PlatformData::~PlatformData() {
     if (neighborList != NULL)
         delete neighborList;
+    for (auto computation : postComputations)
+        delete computation;
 }
 
 /**
@@ -191,4 +302,17 @@ void CpuPlatform::PlatformData::requestNeighborList(double cutoffDistance, doubl
 
 int CpuPlatform::PlatformData::requestPosqIndex() {
     return nextPosqIndex++;
-}
\ No newline at end of file
+}
+
+void CpuPlatform::PlatformData::touchAllForceBlocks(int threadIndex) {
+    fill(threadForceBlocks[threadIndex].begin(), threadForceBlocks[threadIndex].end(), 1);
+}
+
+void CpuPlatform::PlatformData::touchAllForceBlocks() {
+    for (int i = 0; i < threadForceBlocks.size(); i++)
+        touchAllForceBlocks(i);
+}
+
+void CpuPlatform::PlatformData::addPostComputation(ForcePostComputation* computation) {
+    postComputations.push_back(computation);
+}
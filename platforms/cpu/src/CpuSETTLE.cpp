@@ -30,60 +30,135 @@
  * -------------------------------------------------------------------------- */
 
 #include "CpuSETTLE.h"
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 
 using namespace OpenMM;
 using namespace std;
 
+void settlePositionsVec4(const CpuSETTLE::ClusterData& clusters, int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& atomCoordinatesP);
+void settlePositionsAvx(const CpuSETTLE::ClusterData& clusters, int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& atomCoordinatesP);
+void settleVelocitiesVec4(const CpuSETTLE::ClusterData& clusters, int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& velocities, const vector<double>& inverseMasses);
+void settleVelocitiesAvx(const CpuSETTLE::ClusterData& clusters, int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& velocities, const vector<double>& inverseMasses);
+bool isAvxSupported();
+
 CpuSETTLE::CpuSETTLE(const System& system, const ReferenceSETTLEAlgorithm& settle, ThreadPool& threads) : threads(threads) {
+    useAvx = isAvxSupported();
     int numBlocks = 10*threads.getNumThreads();
     int numClusters = settle.getNumClusters();
-    vector<double> mass(system.getNumParticles());
-    for (int i = 0; i < system.getNumParticles(); i++)
-        mass[i] = system.getParticleMass(i);
+
+    // Sort the clusters by their first atom, so waters that are adjacent in the System are also
+    // adjacent here.
+
+    vector<pair<int, int> > order(numClusters);
+    for (int i = 0; i < numClusters; i++) {
+        int atom1, atom2, atom3;
+        double distance1, distance2;
+        settle.getClusterParameters(i, atom1, atom2, atom3, distance1, distance2);
+        order[i] = make_pair(min(atom1, min(atom2, atom3)), i);
+    }
+    sort(order.begin(), order.end());
+
+    // Record the cluster parameters.  The per-cluster constants are padded by the widest vector length.
+
+    const int padding = 8;
+    clusters.atom1.resize(numClusters);
+    clusters.atom2.resize(numClusters);
+    clusters.atom3.resize(numClusters);
+    clusters.mass1.resize(numClusters+padding, 1.0f);
+    clusters.mass2.resize(numClusters+padding, 1.0f);
+    clusters.mass3.resize(numClusters+padding, 1.0f);
+    clusters.invTotalMass.resize(numClusters+padding, 1.0f);
+    clusters.distance2.resize(numClusters+padding, 1.0f);
+    clusters.ra.resize(numClusters+padding, 1.0f);
+    clusters.rb.resize(numClusters+padding, 1.0f);
+    clusters.rc.resize(numClusters+padding, 1.0f);
+    for (int i = 0; i < numClusters; i++) {
+        double distance1, distance2;
+        settle.getClusterParameters(order[i].second, clusters.atom1[i], clusters.atom2[i], clusters.atom3[i], distance1, distance2);
+        double m1 = system.getParticleMass(clusters.atom1[i]);
+        double m2 = system.getParticleMass(clusters.atom2[i]);
+        double m3 = system.getParticleMass(clusters.atom3[i]);
+        double invTotalMass = 1/(m1+m2+m3);
+        double rc = 0.5*distance2;
+        double rb = sqrt(distance1*distance1-rc*rc);
+        double ra = rb*(m2+m3)*invTotalMass;
+        clusters.mass1[i] = m1;
+        clusters.mass2[i] = m2;
+        clusters.mass3[i] = m3;
+        clusters.invTotalMass[i] = invTotalMass;
+        clusters.distance2[i] = distance2;
+        clusters.ra[i] = ra;
+        clusters.rb[i] = rb-ra;
+        clusters.rc[i] = rc;
+    }
+
+    // Divide the clusters into blocks.
+
     for (int i = 0; i < numBlocks; i++) {
         int start = i*numClusters/numBlocks;
         int end = (i+1)*numClusters/numBlocks;
-        if (start != end) {
-            int numThreadClusters = end-start;
-            vector<int> atom1(numThreadClusters), atom2(numThreadClusters), atom3(numThreadClusters);
-            vector<double> distance1(numThreadClusters), distance2(numThreadClusters);
-            for (int j = 0; j < numThreadClusters; j++)
-                settle.getClusterParameters(start+j, atom1[j], atom2[j], atom3[j], distance1[j], distance2[j]);
-            threadSettle.push_back(new ReferenceSETTLEAlgorithm(atom1, atom2, atom3, distance1, distance2, mass));
-        }
+        if (start != end)
+            blockStart.push_back(start);
     }
-}
-
-CpuSETTLE::~CpuSETTLE() {
-    for (auto settle : threadSettle)
-        delete settle;
+    blockStart.push_back(numClusters);
 }
 
 void CpuSETTLE::apply(vector<OpenMM::Vec3>& atomCoordinates, vector<OpenMM::Vec3>& atomCoordinatesP, vector<double>& inverseMasses, double tolerance) {
+    int numBlocks = blockStart.size()-1;
     atomic<int> atomicCounter;
     atomicCounter = 0;
     threads.execute([&] (ThreadPool& threads, int threadIndex) {
         while (true) {
             int index = atomicCounter++;
-            if (index >= threadSettle.size())
+            if (index >= numBlocks)
                 break;
-            threadSettle[index]->apply(atomCoordinates, atomCoordinatesP, inverseMasses, tolerance);
+            applyToClusters(blockStart[index], blockStart[index+1], atomCoordinates, atomCoordinatesP);
         }
     });
     threads.waitForThreads();
 }
 
 void CpuSETTLE::applyToVelocities(vector<OpenMM::Vec3>& atomCoordinates, vector<OpenMM::Vec3>& velocities, vector<double>& inverseMasses, double tolerance) {
+    int numBlocks = blockStart.size()-1;
     atomic<int> atomicCounter;
     atomicCounter = 0;
     threads.execute([&] (ThreadPool& threads, int threadIndex) {
         while (true) {
             int index = atomicCounter++;
-            if (index >= threadSettle.size())
+            if (index >= numBlocks)
                 break;
-            threadSettle[index]->applyToVelocities(atomCoordinates, velocities, inverseMasses, tolerance);
+            applyToClusterVelocities(blockStart[index], blockStart[index+1], atomCoordinates, velocities, inverseMasses);
         }
     });
     threads.waitForThreads();
 }
+
+int CpuSETTLE::getNumClusters() const {
+    return clusters.atom1.size();
+}
+
+void CpuSETTLE::getClusterAtoms(int index, int& atom1, int& atom2, int& atom3) const {
+    atom1 = clusters.atom1[index];
+    atom2 = clusters.atom2[index];
+    atom3 = clusters.atom3[index];
+}
+
+void CpuSETTLE::applyToClusters(int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& atomCoordinatesP) const {
+    if (start >= end)
+        return;
+    if (useAvx)
+        settlePositionsAvx(clusters, start, end, atomCoordinates, atomCoordinatesP);
+    else
+        settlePositionsVec4(clusters, start, end, atomCoordinates, atomCoordinatesP);
+}
+
+void CpuSETTLE::applyToClusterVelocities(int start, int end, const vector<Vec3>& atomCoordinates, vector<Vec3>& velocities, const vector<double>& inverseMasses) const {
+    if (start >= end)
+        return;
+    if (useAvx)
+        settleVelocitiesAvx(clusters, start, end, atomCoordinates, velocities, inverseMasses);
+    else
+        settleVelocitiesVec4(clusters, start, end, atomCoordinates, velocities, inverseMasses);
+}
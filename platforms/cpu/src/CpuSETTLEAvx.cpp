@@ -0,0 +1,57 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2018 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuSETTLEFvec.h"
+#include "openmm/OpenMMException.h"
+
+#ifdef __AVX__
+
+#include "openmm/internal/vectorizeAvx.h"
+
+void settlePositionsAvx(const OpenMM::CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& atomCoordinatesP) {
+    OpenMM::settlePositionsFvec<fvec8>(clusters, start, end, atomCoordinates, atomCoordinatesP);
+}
+
+void settleVelocitiesAvx(const OpenMM::CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& velocities, const std::vector<double>& inverseMasses) {
+    OpenMM::settleVelocitiesFvec<fvec8>(clusters, start, end, atomCoordinates, velocities, inverseMasses);
+}
+
+#else
+
+void settlePositionsAvx(const OpenMM::CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& atomCoordinatesP) {
+    throw OpenMM::OpenMMException("Internal error: OpenMM was compiled without AVX support");
+}
+
+void settleVelocitiesAvx(const OpenMM::CpuSETTLE::ClusterData& clusters, int start, int end, const std::vector<OpenMM::Vec3>& atomCoordinates, std::vector<OpenMM::Vec3>& velocities, const std::vector<double>& inverseMasses) {
+    throw OpenMM::OpenMMException("Internal error: OpenMM was compiled without AVX support");
+}
+
+#endif
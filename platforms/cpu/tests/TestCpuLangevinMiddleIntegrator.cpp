@@ -32,5 +32,57 @@
 #include "CpuTests.h"
 #include "TestLangevinMiddleIntegrator.h"
 
+void testRigidWater() {
+    // Waters constrained by SETTLE are integrated by the fused update.  Simulate noninteracting
+    // waters on several threads and check that the constraints are satisfied and the temperature
+    // is correct.
+
+    const int numMolecules = 300;
+    const int numParticles = 3*numMolecules;
+    const double distOH = 0.1;
+    const double distHH = 0.1633;
+    System system;
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numMolecules; i++) {
+        system.addParticle(16.0);
+        system.addParticle(1.0);
+        system.addParticle(1.0);
+        system.addConstraint(3*i, 3*i+1, distOH);
+        system.addConstraint(3*i, 3*i+2, distOH);
+        system.addConstraint(3*i+1, 3*i+2, distHH);
+        Vec3 center(0.4*(i%7), 0.4*((i/7)%7), 0.4*(i/49));
+        positions[3*i] = center;
+        positions[3*i+1] = center+Vec3(distOH, 0, 0);
+        positions[3*i+2] = center+Vec3(distOH*cos(1.9106), distOH*sin(1.9106), 0);
+    }
+    map<string, string> properties;
+    properties[CpuPlatform::CpuThreads()] = "3";
+    LangevinMiddleIntegrator integrator(300.0, 5.0, 0.002);
+    Context context(system, integrator, platform, properties);
+    context.setPositions(positions);
+    context.setVelocitiesToTemperature(300.0);
+    integrator.step(100);
+    double ke = 0.0;
+    const int numSteps = 500;
+    for (int step = 0; step < numSteps; step++) {
+        integrator.step(1);
+        State state = context.getState(State::Positions | State::Energy);
+        ke += state.getKineticEnergy();
+        if (step%50 == 0) {
+            for (int i = 0; i < system.getNumConstraints(); i++) {
+                int particle1, particle2;
+                double distance;
+                system.getConstraintParameters(i, particle1, particle2, distance);
+                Vec3 delta = state.getPositions()[particle1]-state.getPositions()[particle2];
+                ASSERT_EQUAL_TOL(distance, sqrt(delta.dot(delta)), 2e-5);
+            }
+        }
+    }
+    ke /= numSteps;
+    double expected = 0.5*(3*numParticles-system.getNumConstraints())*BOLTZ*300.0;
+    ASSERT_USUALLY_EQUAL_TOL(expected, ke, 0.05);
+}
+
 void runPlatformTests() {
+    testRigidWater();
 }
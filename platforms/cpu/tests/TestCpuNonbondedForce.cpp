@@ -31,7 +31,496 @@
 
 #include "CpuTests.h"
 #include "TestNonbondedForce.h"
+#include "openmm/CustomNonbondedForce.h"
+#include "openmm/internal/hardware.h"
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+
+void testChangingOffsets(NonbondedForce::NonbondedMethod method) {
+    // Only a few particles and exceptions have offsets, so changing the parameter updates them in
+    // place.  Compare to a new Context created with the same parameter value.
+
+    const int numParticles = 200;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(method);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? -0.5 : 0.5, 0.2, 0.5);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    for (int i = 0; i < numParticles; i += 20)
+        force->addException(i, i+1, 0.1, 0.2, 0.3);
+    force->addGlobalParameter("lambda", 0.0);
+    for (int i = 0; i < 5; i++)
+        force->addParticleParameterOffset("lambda", 7*i, 0.5, 0.05, 0.2);
+    force->addExceptionParameterOffset("lambda", 2, 0.2, 0.1, 0.1);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    for (double lambda : {0.0, 0.3, 0.8, 1.0, 0.5}) {
+        context.setParameter("lambda", lambda);
+        State state1 = context.getState(State::Energy | State::Forces);
+        force->setGlobalParameterDefaultValue(0, lambda);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform);
+        context2.setPositions(positions);
+        State state2 = context2.getState(State::Energy | State::Forces);
+        ASSERT_EQUAL_TOL(state2.getPotentialEnergy(), state1.getPotentialEnergy(), 1e-5);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state2.getForces()[i], state1.getForces()[i], 1e-5);
+    }
+}
+
+void testDispersionCorrectionOffsets() {
+    // The dispersion correction should follow the current values of global parameters.  Compare
+    // to a new Context created with the same parameter value.
+
+    const int numParticles = 100;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::CutoffPeriodic);
+    force->setCutoffDistance(1.0);
+    force->setUseSwitchingFunction(true);
+    force->setSwitchingDistance(0.8);
+    force->setUseDispersionCorrection(true);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(0.0, i%3 == 0 ? 0.3 : 0.2, i%2 == 0 ? 0.5 : 0.8);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    force->addGlobalParameter("lambda", 0.0);
+    force->addGlobalParameter("scale", 1.0);
+    for (int i = 0; i < 10; i++)
+        force->addParticleParameterOffset("lambda", 3*i, 0.0, 0.05, 0.4);
+    force->addParticleParameterOffset("scale", 1, 0.0, 0.0, 0.2);
+    force->addParticleParameterOffset("scale", 2, 1.0, 0.0, 0.0);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    for (double lambda : {0.0, 0.3, 1.0, 0.5}) {
+        context.setParameter("lambda", lambda);
+        context.setParameter("scale", 2*lambda);
+        double energy1 = context.getState(State::Energy).getPotentialEnergy();
+        force->setGlobalParameterDefaultValue(0, lambda);
+        force->setGlobalParameterDefaultValue(1, 2*lambda);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform);
+        context2.setPositions(positions);
+        double energy2 = context2.getState(State::Energy).getPotentialEnergy();
+        ASSERT_EQUAL_TOL(energy2, energy1, 1e-5);
+    }
+}
+
+void testPmeTuning() {
+    // Tuning the grid should select one that is at least as fine as the default, and give results that
+    // agree with it to within the error tolerance.
+
+    const int numParticles = 500;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::PME);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? -1.0 : 1.0, 0.2, 0.5);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    VerletIntegrator integrator1(0.001);
+    Context context1(system, integrator1, platform);
+    context1.setPositions(positions);
+    State state1 = context1.getState(State::Energy | State::Forces);
+    double alpha1;
+    int nx1, ny1, nz1;
+    force->getPMEParametersInContext(context1, alpha1, nx1, ny1, nz1);
+    map<string, string> properties;
+    properties[CpuPlatform::CpuTunePme()] = "true";
+    VerletIntegrator integrator2(0.001);
+    Context context2(system, integrator2, platform, properties);
+    ASSERT_EQUAL("true", platform.getPropertyValue(context2, CpuPlatform::CpuTunePme()));
+    context2.setPositions(positions);
+    double alpha2;
+    int nx2, ny2, nz2;
+    for (int i = 0; i < 30; i++) {
+        State state2 = context2.getState(State::Energy | State::Forces);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-3);
+        for (int j = 0; j < numParticles; j++)
+            ASSERT_EQUAL_VEC(state1.getForces()[j], state2.getForces()[j], 5e-3);
+        force->getPMEParametersInContext(context2, alpha2, nx2, ny2, nz2);
+        ASSERT_EQUAL_TOL(alpha1, alpha2, 1e-6);
+        ASSERT(nx2 >= nx1 && ny2 >= ny1 && nz2 >= nz1);
+    }
+
+    // Once tuning is complete, the grid should not change any more.
+
+    for (int i = 0; i < 5; i++) {
+        context2.getState(State::Energy);
+        int nx, ny, nz;
+        force->getPMEParametersInContext(context2, alpha2, nx, ny, nz);
+        ASSERT_EQUAL(nx2, nx);
+        ASSERT_EQUAL(ny2, ny);
+        ASSERT_EQUAL(nz2, nz);
+    }
+}
+
+void testPmeOrder() {
+    // Every interpolation order should give results that agree to within the error tolerance,
+    // and higher orders should need coarser grids.
+
+    const int numParticles = 300;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::PME);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? -1.0 : 1.0, 0.2, 0.5);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    VerletIntegrator integrator1(0.001);
+    Context context1(system, integrator1, platform);
+    context1.setPositions(positions);
+    State state1 = context1.getState(State::Energy | State::Forces);
+    int lastGridSize = 0;
+    for (int order = 4; order <= 8; order++) {
+        map<string, string> properties;
+        properties[CpuPlatform::CpuPmeOrder()] = to_string(order);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform, properties);
+        ASSERT_EQUAL(to_string(order), platform.getPropertyValue(context2, CpuPlatform::CpuPmeOrder()));
+        context2.setPositions(positions);
+        State state2 = context2.getState(State::Energy | State::Forces);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-3);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state1.getForces()[i], state2.getForces()[i], 5e-3);
+        double alpha;
+        int nx, ny, nz;
+        force->getPMEParametersInContext(context2, alpha, nx, ny, nz);
+        if (order > 4)
+            ASSERT(nx <= lastGridSize);
+        lastGridSize = nx;
+    }
+    map<string, string> properties;
+    properties[CpuPlatform::CpuPmeOrder()] = "3";
+    VerletIntegrator integrator3(0.001);
+    bool threwException = false;
+    try {
+        Context context3(system, integrator3, platform, properties);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testTreecode() {
+    // Create a cloud of small polar molecules with no cutoff, and compare the treecode to direct summation.
+
+    const double radius = 2.5;
+    const double spacing = 0.4;
+    System system;
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::NoCutoff);
+    system.addForce(force);
+    vector<Vec3> positions;
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    int gridSize = (int) (2*radius/spacing);
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                Vec3 pos = Vec3(i, j, k)*spacing - Vec3(radius, radius, radius);
+                if (pos.dot(pos) > radius*radius)
+                    continue;
+                Vec3 dir = Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5);
+                int first = system.getNumParticles();
+                system.addParticle(1.0);
+                system.addParticle(1.0);
+                force->addParticle(-0.5, 0.3, 0.5);
+                force->addParticle(0.5, 0.1, 0.1);
+                force->addException(first, first+1, 0.0, 1.0, 0.0);
+                positions.push_back(pos);
+                positions.push_back(pos+dir*(0.1/sqrt(dir.dot(dir))));
+            }
+    int numParticles = system.getNumParticles();
+    VerletIntegrator integrator1(0.001);
+    Context context1(system, integrator1, platform);
+    context1.setPositions(positions);
+    State state1 = context1.getState(State::Energy | State::Forces);
+    double lastError = 0.0;
+    for (double angle : {0.1, 0.5, 0.7}) {
+        map<string, string> properties;
+        properties[CpuPlatform::CpuTreecodeOpeningAngle()] = to_string(angle);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform, properties);
+        ASSERT_EQUAL_TOL(angle, stod(platform.getPropertyValue(context2, CpuPlatform::CpuTreecodeOpeningAngle())), 1e-6);
+        context2.setPositions(positions);
+        State state2 = context2.getState(State::Energy | State::Forces);
+        double diff = 0, norm = 0;
+        for (int i = 0; i < numParticles; i++) {
+            Vec3 delta = state1.getForces()[i]-state2.getForces()[i];
+            diff += delta.dot(delta);
+            norm += state1.getForces()[i].dot(state1.getForces()[i]);
+        }
+        double error = sqrt(diff/norm);
+        if (angle == 0.1) {
+            ASSERT(error < 1e-4);
+            ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-4);
+        }
+        else
+            ASSERT(error < 1e-2);
+        ASSERT(error > lastError);
+        lastError = error;
+    }
+    map<string, string> properties;
+    properties[CpuPlatform::CpuTreecodeOpeningAngle()] = "1.5";
+    VerletIntegrator integrator3(0.001);
+    bool threwException = false;
+    try {
+        Context context3(system, integrator3, platform, properties);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testAffinity() {
+    // Binding threads and allocating memory locally should not change the results.
+
+    const int numParticles = 500;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::CutoffPeriodic);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? -1.0 : 1.0, 0.2, 0.5);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    map<string, string> properties1;
+    properties1[CpuPlatform::CpuThreads()] = "3";
+    VerletIntegrator integrator1(0.001);
+    Context context1(system, integrator1, platform, properties1);
+    ASSERT_EQUAL("", platform.getPropertyValue(context1, CpuPlatform::CpuAffinity()));
+    ASSERT_EQUAL("none", platform.getPropertyValue(context1, CpuPlatform::CpuNumaPolicy()));
+    context1.setPositions(positions);
+    State state1 = context1.getState(State::Energy | State::Forces);
+    map<string, string> properties2 = properties1;
+    properties2[CpuPlatform::CpuAffinity()] = "0,0-1";
+    properties2[CpuPlatform::CpuNumaPolicy()] = "Local";
+    VerletIntegrator integrator2(0.001);
+    Context context2(system, integrator2, platform, properties2);
+    ASSERT_EQUAL("0,0,1", platform.getPropertyValue(context2, CpuPlatform::CpuAffinity()));
+    ASSERT_EQUAL("local", platform.getPropertyValue(context2, CpuPlatform::CpuNumaPolicy()));
+    context2.setPositions(positions);
+    State state2 = context2.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-5);
+    for (int i = 0; i < numParticles; i++)
+        ASSERT_EQUAL_VEC(state1.getForces()[i], state2.getForces()[i], 1e-5);
+
+    // Illegal values should be rejected.
+
+    for (string affinity : {"a", "1-", "3-2", "-1", "0,,1"}) {
+        map<string, string> properties3;
+        properties3[CpuPlatform::CpuAffinity()] = affinity;
+        VerletIntegrator integrator3(0.001);
+        bool threwException = false;
+        try {
+            Context context3(system, integrator3, platform, properties3);
+        }
+        catch (const OpenMMException& ex) {
+            threwException = true;
+        }
+        ASSERT(threwException);
+    }
+    map<string, string> properties3;
+    properties3[CpuPlatform::CpuNumaPolicy()] = "interleave";
+    VerletIntegrator integrator3(0.001);
+    bool threwException = false;
+    try {
+        Context context3(system, integrator3, platform, properties3);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+struct SharedPoolContext {
+    Context* context;
+    vector<Vec3> forces;
+};
+
+static void* computeSharedPoolForces(void* args) {
+    SharedPoolContext& data = *reinterpret_cast<SharedPoolContext*>(args);
+    for (int i = 0; i < 5; i++)
+        data.forces = data.context->getState(State::Forces).getForces();
+    return 0;
+}
+
+void testSharedThreadPool() {
+    // Several Contexts that share processors and run at the same time should all get the same results as a
+    // Context that does not.
+
+    const int numParticles = 500;
+    const int numContexts = 4;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::PME);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? -1.0 : 1.0, 0.2, 0.5);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    ASSERT_EQUAL("false", platform.getPropertyValue(context, CpuPlatform::CpuSharedThreadPool()));
+    context.setPositions(positions);
+    State state = context.getState(State::Forces);
+    map<string, string> properties;
+    properties[CpuPlatform::CpuSharedThreadPool()] = "true";
+    properties[CpuPlatform::CpuThreads()] = "2";
+    vector<VerletIntegrator*> integrators;
+    vector<SharedPoolContext> contexts(numContexts);
+    for (int i = 0; i < numContexts; i++) {
+        integrators.push_back(new VerletIntegrator(0.001));
+        contexts[i].context = new Context(system, *integrators[i], platform, properties);
+        ASSERT_EQUAL("true", platform.getPropertyValue(*contexts[i].context, CpuPlatform::CpuSharedThreadPool()));
+        contexts[i].context->setPositions(positions);
+    }
+    vector<pthread_t> threads(numContexts);
+    for (int i = 0; i < numContexts; i++)
+        pthread_create(&threads[i], NULL, computeSharedPoolForces, &contexts[i]);
+    for (int i = 0; i < numContexts; i++)
+        pthread_join(threads[i], NULL);
+    for (int i = 0; i < numContexts; i++) {
+        for (int j = 0; j < numParticles; j++)
+            ASSERT_EQUAL_VEC(state.getForces()[j], contexts[i].forces[j], 1e-5);
+        delete contexts[i].context;
+        delete integrators[i];
+    }
+
+    // Tasks from shared pools should never use more processors at once than are available.
+
+    const int numProcessors = getNumProcessors();
+    atomic<int> numRunning(0), maxRunning(0);
+    ThreadPool pool1(1, vector<int>(), true), pool2(1, vector<int>(), true), pool3(1, vector<int>(), true);
+    auto task = [&] (ThreadPool& pool, int threadIndex) {
+        int running = ++numRunning;
+        int previousMax = maxRunning;
+        while (running > previousMax && !maxRunning.compare_exchange_weak(previousMax, running))
+            ;
+        for (int i = 0; i < 100; i++)
+            sched_yield();
+        numRunning--;
+    };
+    for (int i = 0; i < 20; i++) {
+        pool1.execute(task);
+        pool2.execute(task);
+        pool3.execute(task);
+        pool1.waitForThreads();
+        pool2.waitForThreads();
+        pool3.waitForThreads();
+    }
+    ASSERT(maxRunning <= numProcessors);
+    ASSERT(pool1.isShared());
+}
+
+void testForceReduction() {
+    // Each thread only clears and sums the blocks of its force buffer it touched.  Evaluating different
+    // combinations of forces repeatedly should give the same results as a single thread.
+
+    const int numParticles = 1000;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* nonbonded = new NonbondedForce();
+    nonbonded->setNonbondedMethod(NonbondedForce::PME);
+    nonbonded->setCutoffDistance(0.9);
+    system.addForce(nonbonded);
+    CustomNonbondedForce* custom = new CustomNonbondedForce("0.1*r^2");
+    custom->setNonbondedMethod(CustomNonbondedForce::CutoffPeriodic);
+    custom->setCutoffDistance(0.9);
+    custom->setForceGroup(1);
+    system.addForce(custom);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(i%2 == 0 ? -1.0 : 1.0, 0.2, 0.5);
+        custom->addParticle();
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    for (int i = 0; i < numParticles; i += 2) {
+        nonbonded->addException(i, i+1, 0.0, 1.0, 0.0);
+        custom->addExclusion(i, i+1);
+    }
+    map<string, string> properties1, properties2;
+    properties1[CpuPlatform::CpuThreads()] = "1";
+    properties2[CpuPlatform::CpuThreads()] = "4";
+    VerletIntegrator integrator1(0.001), integrator2(0.001);
+    Context context1(system, integrator1, platform, properties1);
+    Context context2(system, integrator2, platform, properties2);
+    context1.setPositions(positions);
+    context2.setPositions(positions);
+    for (int groups : {1, 2, 3, 1, 3, 2}) {
+        State state1 = context1.getState(State::Forces, false, groups);
+        State state2 = context2.getState(State::Forces, false, groups);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state1.getForces()[i], state2.getForces()[i], 1e-4);
+    }
+}
 
 void runPlatformTests() {
+    testDispersionCorrectionOffsets();
     testHugeSystem();
+    testChangingOffsets(NonbondedForce::PME);
+    testChangingOffsets(NonbondedForce::LJPME);
+    testPmeTuning();
+    testPmeOrder();
+    testTreecode();
+    testAffinity();
+    testSharedThreadPool();
+    testForceReduction();
 }
@@ -31,6 +31,74 @@
 
 #include "CpuTests.h"
 #include "TestSettle.h"
+#include "CpuSETTLE.h"
+#include "openmm/internal/ThreadPool.h"
+
+void testCompareToReference() {
+    // Build a set of perturbed waters whose count is not a multiple of the SIMD width, and make sure
+    // CpuSETTLE produces the same results as ReferenceSETTLEAlgorithm to single precision.
+
+    const int numMolecules = 103;
+    const int numParticles = 3*numMolecules;
+    System system;
+    vector<int> atom1, atom2, atom3;
+    vector<double> distance1, distance2, masses, inverseMasses;
+    for (int i = 0; i < numMolecules; i++) {
+        double hydrogenMass = (i%2 == 0 ? 1.0 : 2.0);
+        system.addParticle(16.0);
+        system.addParticle(hydrogenMass);
+        system.addParticle(hydrogenMass);
+        atom1.push_back(3*i);
+        atom2.push_back(3*i+1);
+        atom3.push_back(3*i+2);
+        distance1.push_back(0.1);
+        distance2.push_back(0.163);
+    }
+    for (int i = 0; i < numParticles; i++) {
+        masses.push_back(system.getParticleMass(i));
+        inverseMasses.push_back(1.0/masses[i]);
+    }
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles), newPositions(numParticles), velocities(numParticles);
+    for (int i = 0; i < numMolecules; i++) {
+        positions[3*i] = Vec3((i%5)*0.4, ((i/5)%5)*0.4, (i/25)*0.4);
+        positions[3*i+1] = positions[3*i]+Vec3(0.1, 0, 0);
+        positions[3*i+2] = positions[3*i]+Vec3(-0.0333, 0.0943, 0);
+    }
+    for (int i = 0; i < numParticles; i++) {
+        newPositions[i] = positions[i]+Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5)*0.005;
+        velocities[i] = Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5);
+    }
+    ReferenceSETTLEAlgorithm reference(atom1, atom2, atom3, distance1, distance2, masses);
+    ThreadPool threads(3);
+    CpuSETTLE settle(system, reference, threads);
+
+    // Compare the constrained positions.
+
+    vector<Vec3> expectedPositions = newPositions;
+    reference.apply(positions, expectedPositions, inverseMasses, 1e-5);
+    settle.apply(positions, newPositions, inverseMasses, 1e-5);
+    for (int i = 0; i < numParticles; i++)
+        ASSERT_EQUAL_VEC(expectedPositions[i], newPositions[i], 1e-6);
+    for (int i = 0; i < numMolecules; i++) {
+        Vec3 d1 = newPositions[3*i+1]-newPositions[3*i];
+        Vec3 d2 = newPositions[3*i+2]-newPositions[3*i];
+        Vec3 d3 = newPositions[3*i+2]-newPositions[3*i+1];
+        ASSERT_EQUAL_TOL(0.1, sqrt(d1.dot(d1)), 1e-6);
+        ASSERT_EQUAL_TOL(0.1, sqrt(d2.dot(d2)), 1e-6);
+        ASSERT_EQUAL_TOL(0.163, sqrt(d3.dot(d3)), 1e-6);
+    }
+
+    // Compare the constrained velocities.
+
+    vector<Vec3> expectedVelocities = velocities;
+    reference.applyToVelocities(newPositions, expectedVelocities, inverseMasses, 1e-5);
+    settle.applyToVelocities(newPositions, velocities, inverseMasses, 1e-5);
+    for (int i = 0; i < numParticles; i++)
+        ASSERT_EQUAL_VEC(expectedVelocities[i], velocities[i], 1e-5);
+}
 
 void runPlatformTests() {
+    testCompareToReference();
 }
@@ -34,6 +34,7 @@
 
 #include "ReferencePlatform.h"
 #include "openmm/kernels.h"
+#include "openmm/internal/NonbondedForceImpl.h"
 #include "SimTKOpenMMRealType.h"
 #include "ReferenceNeighborList.h"
 #include "lepton/CompiledExpression.h"
@@ -577,7 +578,7 @@ private:
  */
 class ReferenceCalcNonbondedForceKernel : public CalcNonbondedForceKernel {
 public:
-    ReferenceCalcNonbondedForceKernel(std::string name, const Platform& platform) : CalcNonbondedForceKernel(name, platform) {
+    ReferenceCalcNonbondedForceKernel(std::string name, const Platform& platform) : CalcNonbondedForceKernel(name, platform), dispersionCorrection(NULL) {
     }
     ~ReferenceCalcNonbondedForceKernel();
     /**
@@ -635,6 +636,7 @@ private:
     std::vector<std::set<int> > exclusions;
     NonbondedMethod nonbondedMethod;
     NeighborList* neighborList;
+    NonbondedForceImpl::DispersionCorrection* dispersionCorrection;
 };
 
 /**
@@ -1090,6 +1092,44 @@ private:
     std::vector<int> particles;
 };
 
+/**
+ * This kernel is invoked by PositionRestraintForce to calculate the forces acting on the system and the energy of the system.
+ */
+class ReferenceCalcPositionRestraintForceKernel : public CalcPositionRestraintForceKernel {
+public:
+    ReferenceCalcPositionRestraintForceKernel(std::string name, const Platform& platform) : CalcPositionRestraintForceKernel(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the PositionRestraintForce this kernel will be used for
+     */
+    void initialize(const System& system, const PositionRestraintForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the PositionRestraintForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const PositionRestraintForce& force);
+private:
+    std::vector<int> particles;
+    std::vector<Vec3> referencePos;
+    std::vector<double> k, radius;
+    std::string scaleParameter;
+    bool usePeriodic;
+};
+
 /**
  * This kernel is invoked by VerletIntegrator to take one time step.
  */
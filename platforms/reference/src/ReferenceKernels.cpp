@@ -50,6 +50,7 @@
 #include "ReferenceCustomNonbondedIxn.h"
 #include "ReferenceCustomManyParticleIxn.h"
 #include "ReferenceCustomTorsionIxn.h"
+#include "ReferenceForce.h"
 #include "ReferenceGayBerneForce.h"
 #include "ReferenceHarmonicBondIxn.h"
 #include "ReferenceLangevinMiddleDynamics.h"
@@ -864,6 +865,8 @@ void ReferenceCalcCustomTorsionForceKernel::copyParametersToContext(ContextImpl&
 ReferenceCalcNonbondedForceKernel::~ReferenceCalcNonbondedForceKernel() {
     if (neighborList != NULL)
         delete neighborList;
+    if (dispersionCorrection != NULL)
+        delete dispersionCorrection;
 }
 
 void ReferenceCalcNonbondedForceKernel::initialize(const System& system, const NonbondedForce& force) {
@@ -959,9 +962,8 @@ void ReferenceCalcNonbondedForceKernel::initialize(const System& system, const N
         exceptionsArePeriodic = force.getExceptionsUsePeriodicBoundaryConditions();
     rfDielectric = force.getReactionFieldDielectric();
     if (force.getUseDispersionCorrection())
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(system, force);
-    else
-        dispersionCoefficient = 0.0;
+        dispersionCorrection = new NonbondedForceImpl::DispersionCorrection(system, force);
+    dispersionCoefficient = 0.0;
 }
 
 double ReferenceCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy, bool includeDirect, bool includeReciprocal) {
@@ -1052,8 +1054,11 @@ void ReferenceCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& con
     // Recompute the coefficient for the dispersion correction.
 
     NonbondedForce::NonbondedMethod method = force.getNonbondedMethod();
-    if (force.getUseDispersionCorrection() && (method == NonbondedForce::CutoffPeriodic || method == NonbondedForce::Ewald || method == NonbondedForce::PME))
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(context.getSystem(), force);
+    if (force.getUseDispersionCorrection() && (method == NonbondedForce::CutoffPeriodic || method == NonbondedForce::Ewald || method == NonbondedForce::PME)) {
+        if (dispersionCorrection != NULL)
+            delete dispersionCorrection;
+        dispersionCorrection = new NonbondedForceImpl::DispersionCorrection(context.getSystem(), force);
+    }
 }
 
 void ReferenceCalcNonbondedForceKernel::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
@@ -1118,6 +1123,16 @@ void ReferenceCalcNonbondedForceKernel::computeParameters(ContextImpl& context)
         bonded14ParamArray[i][1] = 4.0*epsilons[i];
         bonded14ParamArray[i][2] = charges[i];
     }
+
+    // Compute the coefficient for the dispersion correction.  This only does any work if
+    // parameters it depends on have changed.
+
+    if (dispersionCorrection != NULL) {
+        vector<double> values;
+        for (const string& name : dispersionCorrection->getParameterNames())
+            values.push_back(context.getParameter(name));
+        dispersionCoefficient = dispersionCorrection->getCoefficient(values);
+    }
 }
 
 ReferenceCalcCustomNonbondedForceKernel::~ReferenceCalcCustomNonbondedForceKernel() {
@@ -2065,6 +2080,52 @@ ReferenceIntegrateVerletStepKernel::~ReferenceIntegrateVerletStepKernel() {
         delete dynamics;
 }
 
+void ReferenceCalcPositionRestraintForceKernel::initialize(const System& system, const PositionRestraintForce& force) {
+    int numRestraints = force.getNumRestraints();
+    particles.resize(numRestraints);
+    referencePos.resize(numRestraints);
+    k.resize(numRestraints);
+    radius.resize(numRestraints);
+    for (int i = 0; i < numRestraints; i++)
+        force.getRestraintParameters(i, particles[i], referencePos[i], k[i], radius[i]);
+    scaleParameter = force.getScaleParameterName();
+    usePeriodic = force.usesPeriodicBoundaryConditions();
+}
+
+double ReferenceCalcPositionRestraintForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<Vec3>& posData = extractPositions(context);
+    vector<Vec3>& forceData = extractForces(context);
+    Vec3* boxVectors = extractBoxVectors(context);
+    double scale = context.getParameter(scaleParameter);
+    double energy = 0.0;
+    for (int i = 0; i < particles.size(); i++) {
+        Vec3 delta;
+        if (usePeriodic)
+            delta = ReferenceForce::getDeltaRPeriodic(referencePos[i], posData[particles[i]], boxVectors);
+        else
+            delta = posData[particles[i]]-referencePos[i];
+        double r = sqrt(delta.dot(delta));
+        if (r <= radius[i])
+            continue;
+        double dr = r-radius[i];
+        double scaledK = scale*k[i];
+        energy += 0.5*scaledK*dr*dr;
+        forceData[particles[i]] -= delta*(scaledK*dr/r);
+    }
+    return energy;
+}
+
+void ReferenceCalcPositionRestraintForceKernel::copyParametersToContext(ContextImpl& context, const PositionRestraintForce& force) {
+    if (particles.size() != force.getNumRestraints())
+        throw OpenMMException("updateParametersInContext: The number of restraints has changed");
+    for (int i = 0; i < particles.size(); i++) {
+        int particle;
+        force.getRestraintParameters(i, particle, referencePos[i], k[i], radius[i]);
+        if (particle != particles[i])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+    }
+}
+
 void ReferenceIntegrateVerletStepKernel::initialize(const System& system, const VerletIntegrator& integrator) {
     int numParticles = system.getNumParticles();
     masses.resize(numParticles);
@@ -32,5 +32,52 @@
 #include "ReferenceTests.h"
 #include "TestNonbondedForce.h"
 
+void testDispersionCorrectionOffsets() {
+    // The dispersion correction should follow the current values of global parameters.  Compare
+    // to a new Context created with the same parameter value.
+
+    const int numParticles = 100;
+    const double boxSize = 3.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(NonbondedForce::CutoffPeriodic);
+    force->setCutoffDistance(1.0);
+    force->setUseSwitchingFunction(true);
+    force->setSwitchingDistance(0.8);
+    force->setUseDispersionCorrection(true);
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(0.0, i%3 == 0 ? 0.3 : 0.2, i%2 == 0 ? 0.5 : 0.8);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    force->addGlobalParameter("lambda", 0.0);
+    force->addGlobalParameter("scale", 1.0);
+    for (int i = 0; i < 10; i++)
+        force->addParticleParameterOffset("lambda", 3*i, 0.0, 0.05, 0.4);
+    force->addParticleParameterOffset("scale", 1, 0.0, 0.0, 0.2);
+    force->addParticleParameterOffset("scale", 2, 1.0, 0.0, 0.0);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    for (double lambda : {0.0, 0.3, 1.0, 0.5}) {
+        context.setParameter("lambda", lambda);
+        context.setParameter("scale", 2*lambda);
+        double energy1 = context.getState(State::Energy).getPotentialEnergy();
+        force->setGlobalParameterDefaultValue(0, lambda);
+        force->setGlobalParameterDefaultValue(1, 2*lambda);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform);
+        context2.setPositions(positions);
+        double energy2 = context2.getState(State::Energy).getPotentialEnergy();
+        ASSERT_EQUAL_TOL(energy2, energy1, 1e-5);
+    }
+}
+
 void runPlatformTests() {
+    testDispersionCorrectionOffsets();
 }
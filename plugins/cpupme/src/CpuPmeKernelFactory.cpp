@@ -38,6 +38,7 @@ extern "C" OPENMM_EXPORT_PME void registerKernelFactories() {
         for (int i = 0; i < Platform::getNumPlatforms(); i++) {
             Platform::getPlatform(i).registerKernelFactory(CalcPmeReciprocalForceKernel::Name(), factory);
             Platform::getPlatform(i).registerKernelFactory(CalcDispersionPmeReciprocalForceKernel::Name(), factory);
+            Platform::getPlatform(i).registerKernelFactory(CalcLJPmeReciprocalForceKernel::Name(), factory);
         }
     }
 }
@@ -59,5 +60,7 @@ KernelImpl* CpuPmeKernelFactory::createKernelImpl(std::string name, const Platfo
         return new CpuCalcPmeReciprocalForceKernel(name, platform);
     if (name == CalcDispersionPmeReciprocalForceKernel::Name())
         return new CpuCalcDispersionPmeReciprocalForceKernel(name, platform);
+    if (name == CalcLJPmeReciprocalForceKernel::Name())
+        return new CpuCalcLJPmeReciprocalForceKernel(name, platform);
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
 }
@@ -46,14 +46,185 @@
 using namespace OpenMM;
 using namespace std;
 
-static const int PME_ORDER = 5;
+/**
+ * The range of B-spline orders that can be used for interpolating onto the grid.  The functions
+ * that spread charges and interpolate forces are specialized for each one.
+ */
+static const int MinPmeOrder = 4;
+static const int MaxPmeOrder = 8;
+
+/**
+ * Whether the worker threads should share processors with the CPU platform's shared thread pools.  The
+ * kernels do not know which Context they belong to, so this is set for the whole process, the same way as
+ * the number of threads.
+ */
+static bool useSharedThreadPool() {
+    char* sharedEnv = getenv("OPENMM_CPU_SHARED_THREAD_POOL");
+    if (sharedEnv == NULL)
+        return false;
+    string value = sharedEnv;
+    transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return (value == "true");
+}
+
+/**
+ * Select the number of worker threads to use.  The CPU platform computes reciprocal space at the same time as
+ * other forces, so OPENMM_CPU_PME_THREADS can be used to give it only part of the processors.  Otherwise it uses
+ * the same number of threads as the CPU platform's default.
+ */
+static int getNumPmeThreads() {
+    int numThreads = getNumProcessors();
+    char* threadsEnv = getenv("OPENMM_CPU_PME_THREADS");
+    if (threadsEnv == NULL)
+        threadsEnv = getenv("OPENMM_CPU_THREADS");
+    if (threadsEnv != NULL)
+        stringstream(threadsEnv) >> numThreads;
+    return max(1, numThreads);
+}
 
 bool CpuCalcDispersionPmeReciprocalForceKernel::hasInitializedThreads = false;
 int CpuCalcDispersionPmeReciprocalForceKernel::numThreads = 0;
 
+/**
+ * Compute the B-spline coefficients for one particle along all three axes.  dr is the particle's offset
+ * from the grid point it lies above.  If ddata is not NULL, the derivatives of the coefficients are stored
+ * in it.
+ */
+template <int PME_ORDER>
+static inline void computeBSplines(const fvec4& dr, fvec4* data, fvec4* ddata) {
+    const fvec4 one(1);
+    const fvec4 scale(1.0f/(PME_ORDER-1));
+    data[PME_ORDER-1] = 0.0f;
+    data[1] = dr;
+    data[0] = one-dr;
+    for (int j = 3; j < PME_ORDER; j++) {
+        fvec4 div(1.0f/(j-1));
+        data[j-1] = div*dr*data[j-2];
+        for (int k = 1; k < j-1; k++)
+            data[j-k-1] = div*((dr+k)*data[j-k-2]+(fvec4(j-k)-dr)*data[j-k-1]);
+        data[0] = div*(one-dr)*data[0];
+    }
+    if (ddata != NULL) {
+        ddata[0] = -data[0];
+        for (int j = 1; j < PME_ORDER; j++)
+            ddata[j] = data[j-1]-data[j];
+    }
+    data[PME_ORDER-1] = scale*dr*data[PME_ORDER-2];
+    for (int j = 1; j < (PME_ORDER-1); j++)
+        data[PME_ORDER-j-1] = scale*((dr+j)*data[PME_ORDER-j-2]+(fvec4(PME_ORDER-j)-dr)*data[PME_ORDER-j-1]);
+    data[0] = scale*(one-dr)*data[0];
+}
+
+/**
+ * Add one particle's charge to a grid, given the grid point it lies above and its B-spline coefficients.
+ */
+template <int PME_ORDER>
+static inline void addToGrid(float* grid, int gridx, int gridy, int gridz, int gridIndexX, int gridIndexY, int gridIndexZ, const fvec4* data, float charge) {
+    int zindex[PME_ORDER];
+    for (int j = 0; j < PME_ORDER; j++) {
+        zindex[j] = gridIndexZ+j;
+        zindex[j] -= (zindex[j] >= gridz ? gridz : 0);
+    }
+
+    // The z coefficients are grouped into vectors of four.  Any that are left over are handled
+    // one at a time.
+
+    const int numZVectors = PME_ORDER/4;
+    const int numZExtra = PME_ORDER%4;
+    fvec4 zdataVec[numZVectors];
+    float zdataExtra[4];
+    float temp[4];
+    for (int j = 0; j < numZVectors; j++)
+        zdataVec[j] = fvec4(data[4*j][2], data[4*j+1][2], data[4*j+2][2], data[4*j+3][2]);
+    for (int j = 0; j < numZExtra; j++)
+        zdataExtra[j] = data[4*numZVectors+j][2];
+    if (gridIndexZ+PME_ORDER-1 < gridz) {
+        for (int ix = 0; ix < PME_ORDER; ix++) {
+            int xbase = gridIndexX+ix;
+            xbase -= (xbase >= gridx ? gridx : 0);
+            xbase = xbase*gridy*gridz;
+            float xdata = charge*data[ix][0];
+            for (int iy = 0; iy < PME_ORDER; iy++) {
+                int ybase = gridIndexY+iy;
+                ybase -= (ybase >= gridy ? gridy : 0);
+                ybase = xbase + ybase*gridz + gridIndexZ;
+                float multiplier = xdata*data[iy][1];
+                for (int j = 0; j < numZVectors; j++)
+                    (fvec4(&grid[ybase+4*j])+zdataVec[j]*multiplier).store(&grid[ybase+4*j]);
+                for (int j = 0; j < numZExtra; j++)
+                    grid[ybase+4*numZVectors+j] += multiplier*zdataExtra[j];
+            }
+        }
+    }
+    else {
+        for (int ix = 0; ix < PME_ORDER; ix++) {
+            int xbase = gridIndexX+ix;
+            xbase -= (xbase >= gridx ? gridx : 0);
+            xbase = xbase*gridy*gridz;
+            float xdata = charge*data[ix][0];
+            for (int iy = 0; iy < PME_ORDER; iy++) {
+                int ybase = gridIndexY+iy;
+                ybase -= (ybase >= gridy ? gridy : 0);
+                ybase = xbase + ybase*gridz;
+                float multiplier = xdata*data[iy][1];
+                for (int j = 0; j < numZVectors; j++) {
+                    (zdataVec[j]*multiplier).store(temp);
+                    grid[ybase+zindex[4*j]] += temp[0];
+                    grid[ybase+zindex[4*j+1]] += temp[1];
+                    grid[ybase+zindex[4*j+2]] += temp[2];
+                    grid[ybase+zindex[4*j+3]] += temp[3];
+                }
+                for (int j = 0; j < numZExtra; j++)
+                    grid[ybase+zindex[4*numZVectors+j]] += multiplier*zdataExtra[j];
+            }
+        }
+    }
+}
+
+/**
+ * Compute the gradient of the grid at one particle's position, given the grid point it lies above and its
+ * B-spline coefficients and their derivatives.  The result is in grid units and still needs to be multiplied
+ * by the particle's charge.
+ */
+template <int PME_ORDER>
+static inline fvec4 gatherFromGrid(const float* grid, int gridx, int gridy, int gridz, int gridIndexX, int gridIndexY, int gridIndexZ, const fvec4* data, const fvec4* ddata) {
+    int zindex[PME_ORDER];
+    for (int j = 0; j < PME_ORDER; j++) {
+        zindex[j] = gridIndexZ+j;
+        zindex[j] -= (zindex[j] >= gridz ? gridz : 0);
+    }
+    fvec4 zdata[PME_ORDER];
+    for (int j = 0; j < PME_ORDER; j++)
+        zdata[j] = fvec4(data[j][2], data[j][2], ddata[j][2], 0);
+    fvec4 f = 0.0f;
+    for (int ix = 0; ix < PME_ORDER; ix++) {
+        int xbase = gridIndexX+ix;
+        xbase -= (xbase >= gridx ? gridx : 0);
+        xbase = xbase*gridy*gridz;
+        float dx = data[ix][0];
+        float ddx = ddata[ix][0];
+        fvec4 xdata(ddx, dx, dx, 0);
+
+        for (int iy = 0; iy < PME_ORDER; iy++) {
+            int ybase = gridIndexY+iy;
+            ybase -= (ybase >= gridy ? gridy : 0);
+            ybase = xbase + ybase*gridz;
+            float dy = data[iy][1];
+            float ddy = ddata[iy][1];
+            fvec4 xydata = xdata*fvec4(dy, ddy, dy, 0);
+
+            for (int iz = 0; iz < PME_ORDER; iz++) {
+                fvec4 gridValue(grid[ybase+zindex[iz]]);
+                f = f+xydata*zdata[iz]*gridValue;
+            }
+        }
+    }
+    return f;
+}
+
+template <int PME_ORDER>
 static void spreadCharge(float* posq, float* grid, int gridx, int gridy, int gridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
         atomic<int>& atomicCounter, const float epsilonFactor, int threadIndex, int numThreads, bool deterministic) {
-    float temp[4];
     fvec4 boxSize((float) periodicBoxVectors[0][0], (float) periodicBoxVectors[1][1], (float) periodicBoxVectors[2][2], 0);
     fvec4 invBoxSize((float) recipBoxVectors[0][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[2][2], 0);
     fvec4 recipBoxVec0((float) recipBoxVectors[0][0], (float) recipBoxVectors[0][1], (float) recipBoxVectors[0][2], 0);
@@ -61,8 +232,6 @@ static void spreadCharge(float* posq, float* grid, int gridx, int gridy, int gri
     fvec4 recipBoxVec2((float) recipBoxVectors[2][0], (float) recipBoxVectors[2][1], (float) recipBoxVectors[2][2], 0);
     fvec4 gridSize(gridx, gridy, gridz, 0);
     ivec4 gridSizeInt(gridx, gridy, gridz, 0);
-    fvec4 one(1);
-    fvec4 scale(1.0f/(PME_ORDER-1));
     float posInBox[4] = {0,0,0,0};
     memset(grid, 0, sizeof(float)*gridx*gridy*gridz);
 
@@ -90,74 +259,88 @@ static void spreadCharge(float* posq, float* grid, int gridx, int gridy, int gri
             // Compute the B-spline coefficients.
 
             fvec4 data[PME_ORDER];
-            data[PME_ORDER-1] = 0.0f;
-            data[1] = dr;
-            data[0] = one-dr;
-            for (int j = 3; j < PME_ORDER; j++) {
-                fvec4 div(1.0f/(j-1));
-                data[j-1] = div*dr*data[j-2];
-                for (int k = 1; k < j-1; k++)
-                    data[j-k-1] = div*((dr+k)*data[j-k-2]+(fvec4(j-k)-dr)*data[j-k-1]);
-                data[0] = div*(one-dr)*data[0];
-            }
-            data[PME_ORDER-1] = scale*dr*data[PME_ORDER-2];
-            for (int j = 1; j < (PME_ORDER-1); j++)
-                data[PME_ORDER-j-1] = scale*((dr+j)*data[PME_ORDER-j-2]+(fvec4(PME_ORDER-j)-dr)*data[PME_ORDER-j-1]);
-            data[0] = scale*(one-dr)*data[0];
+            computeBSplines<PME_ORDER>(dr, data, NULL);
 
             // Spread the charges.
 
-            int gridIndexX = gridIndex[0];
-            int gridIndexY = gridIndex[1];
-            int gridIndexZ = gridIndex[2];
-            if (gridIndexX < 0)
+            if (gridIndex[0] < 0)
                 return; // This happens when a simulation blows up and coordinates become NaN.
-            int zindex[PME_ORDER];
-            for (int j = 0; j < PME_ORDER; j++) {
-                zindex[j] = gridIndexZ+j;
-                zindex[j] -= (zindex[j] >= gridz ? gridz : 0);
-            }
-            float charge = epsilonFactor*posq[4*i+3];
-            fvec4 zdata0to3(data[0][2], data[1][2], data[2][2], data[3][2]);
-            float zdata4 = data[4][2];
-            if (gridIndexZ+4 < gridz) {
-                for (int ix = 0; ix < PME_ORDER; ix++) {
-                    int xbase = gridIndexX+ix;
-                    xbase -= (xbase >= gridx ? gridx : 0);
-                    xbase = xbase*gridy*gridz;
-                    float xdata = charge*data[ix][0];
-                    for (int iy = 0; iy < PME_ORDER; iy++) {
-                        int ybase = gridIndexY+iy;
-                        ybase -= (ybase >= gridy ? gridy : 0);
-                        ybase = xbase + ybase*gridz;
-                        float multiplier = xdata*data[iy][1];
-                        fvec4 add0to3 = zdata0to3*multiplier;
-                        (fvec4(&grid[ybase+gridIndexZ])+add0to3).store(&grid[ybase+gridIndexZ]);
-                        grid[ybase+zindex[4]] += multiplier*zdata4;
-                    }
-                }
-            }
-            else {
-                for (int ix = 0; ix < PME_ORDER; ix++) {
-                    int xbase = gridIndexX+ix;
-                    xbase -= (xbase >= gridx ? gridx : 0);
-                    xbase = xbase*gridy*gridz;
-                    float xdata = charge*data[ix][0];
-                    for (int iy = 0; iy < PME_ORDER; iy++) {
-                        int ybase = gridIndexY+iy;
-                        ybase -= (ybase >= gridy ? gridy : 0);
-                        ybase = xbase + ybase*gridz;
-                        float multiplier = xdata*data[iy][1];
-                        fvec4 add0to3 = zdata0to3*multiplier;
-                        add0to3.store(temp);
-                        grid[ybase+zindex[0]] += temp[0];
-                        grid[ybase+zindex[1]] += temp[1];
-                        grid[ybase+zindex[2]] += temp[2];
-                        grid[ybase+zindex[3]] += temp[3];
-                        grid[ybase+zindex[4]] += multiplier*zdata4;
-                    }
-                }
+            addToGrid<PME_ORDER>(grid, gridx, gridy, gridz, gridIndex[0], gridIndex[1], gridIndex[2], data, epsilonFactor*posq[4*i+3]);
+        }
+
+        if (deterministic)
+            start += groupSize * numThreads;
+    }
+}
+
+/**
+ * Spread both the charges and the dispersion coefficients onto their grids in a single pass over the particles.
+ * The fractional coordinates of each particle are computed only once, and if the two grids are the same size
+ * so are its B-spline coefficients.  Particles whose charge or dispersion coefficient is zero are not spread
+ * onto that grid.
+ */
+template <int PME_ORDER>
+static void spreadChargeAndDispersion(float* posq, float* c6, float* grid, float* dispersionGrid, int gridx, int gridy, int gridz,
+        int dispersionGridx, int dispersionGridy, int dispersionGridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
+        atomic<int>& atomicCounter, const float epsilonFactor, int threadIndex, int numThreads, bool deterministic) {
+    fvec4 boxSize((float) periodicBoxVectors[0][0], (float) periodicBoxVectors[1][1], (float) periodicBoxVectors[2][2], 0);
+    fvec4 invBoxSize((float) recipBoxVectors[0][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[2][2], 0);
+    fvec4 recipBoxVec0((float) recipBoxVectors[0][0], (float) recipBoxVectors[0][1], (float) recipBoxVectors[0][2], 0);
+    fvec4 recipBoxVec1((float) recipBoxVectors[1][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[1][2], 0);
+    fvec4 recipBoxVec2((float) recipBoxVectors[2][0], (float) recipBoxVectors[2][1], (float) recipBoxVectors[2][2], 0);
+    fvec4 gridSize(gridx, gridy, gridz, 0);
+    ivec4 gridSizeInt(gridx, gridy, gridz, 0);
+    fvec4 dispersionGridSize(dispersionGridx, dispersionGridy, dispersionGridz, 0);
+    ivec4 dispersionGridSizeInt(dispersionGridx, dispersionGridy, dispersionGridz, 0);
+    bool sameGrid = (gridx == dispersionGridx && gridy == dispersionGridy && gridz == dispersionGridz);
+    float posInBox[4] = {0,0,0,0};
+    memset(grid, 0, sizeof(float)*gridx*gridy*gridz);
+    memset(dispersionGrid, 0, sizeof(float)*dispersionGridx*dispersionGridy*dispersionGridz);
+
+    const int groupSize = max(1, numParticles / (10 * numThreads));
+    int start = groupSize * threadIndex;
+    while (true) {
+        if (!deterministic)
+            start = atomicCounter.fetch_add(groupSize);
+
+        if (start >= numParticles)
+            break;
+
+        int end = min(start + groupSize, numParticles);
+        for (int i = start; i < end; ++i) {
+            // Find the fractional coordinates of the particle.
+
+            fvec4 pos(&posq[4*i]);
+            (pos-boxSize*floor(pos*invBoxSize)).store(posInBox);
+            fvec4 frac = posInBox[0]*recipBoxVec0 + posInBox[1]*recipBoxVec1 + posInBox[2]*recipBoxVec2;
+            frac = frac-floor(frac);
+
+            // Spread the charge.
+
+            fvec4 t = frac*gridSize;
+            ivec4 ti = t;
+            fvec4 dr = t-ti;
+            ivec4 gridIndex = ti-(gridSizeInt&ti==gridSizeInt);
+            if (gridIndex[0] < 0)
+                return; // This happens when a simulation blows up and coordinates become NaN.
+            fvec4 data[PME_ORDER];
+            computeBSplines<PME_ORDER>(dr, data, NULL);
+            float charge = posq[4*i+3];
+            if (charge != 0.0f)
+                addToGrid<PME_ORDER>(grid, gridx, gridy, gridz, gridIndex[0], gridIndex[1], gridIndex[2], data, epsilonFactor*charge);
+
+            // Spread the dispersion coefficient.
+
+            if (c6[i] == 0.0f)
+                continue;
+            if (!sameGrid) {
+                t = frac*dispersionGridSize;
+                ti = t;
+                dr = t-ti;
+                gridIndex = ti-(dispersionGridSizeInt&ti==dispersionGridSizeInt);
+                computeBSplines<PME_ORDER>(dr, data, NULL);
             }
+            addToGrid<PME_ORDER>(dispersionGrid, dispersionGridx, dispersionGridy, dispersionGridz, gridIndex[0], gridIndex[1], gridIndex[2], data, c6[i]);
         }
 
         if (deterministic)
@@ -316,6 +499,7 @@ static void reciprocalConvolution(int start, int end, fftwf_complex* grid, vecto
     }
 }
 
+template <int PME_ORDER>
 static void interpolateForces(float* posq, float* force, float* grid, int gridx, int gridy, int gridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors, atomic<int>& atomicCounter, const float epsilonFactor, int numThreads) {
     fvec4 boxSize((float) periodicBoxVectors[0][0], (float) periodicBoxVectors[1][1], (float) periodicBoxVectors[2][2], 0);
     fvec4 invBoxSize((float) recipBoxVectors[0][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[2][2], 0);
@@ -324,8 +508,6 @@ static void interpolateForces(float* posq, float* force, float* grid, int gridx,
     fvec4 recipBoxVec2((float) recipBoxVectors[2][0], (float) recipBoxVectors[2][1], (float) recipBoxVectors[2][2], 0);
     fvec4 gridSize(gridx, gridy, gridz, 0);
     ivec4 gridSizeInt(gridx, gridy, gridz, 0);
-    fvec4 one(1);
-    fvec4 scale(1.0f/(PME_ORDER-1));
 
     const int groupSize = max(1, numParticles / (10 * numThreads));
     while (true) {
@@ -351,62 +533,13 @@ static void interpolateForces(float* posq, float* force, float* grid, int gridx,
 
             fvec4 data[PME_ORDER];
             fvec4 ddata[PME_ORDER];
-            data[PME_ORDER-1] = 0.0f;
-            data[1] = dr;
-            data[0] = one-dr;
-            for (int j = 3; j < PME_ORDER; j++) {
-                fvec4 div(1.0f/(j-1));
-                data[j-1] = div*dr*data[j-2];
-                for (int k = 1; k < j-1; k++)
-                    data[j-k-1] = div*((dr+k)*data[j-k-2]+(fvec4(j-k)-dr)*data[j-k-1]);
-                data[0] = div*(one-dr)*data[0];
-            }
-            ddata[0] = -data[0];
-            for (int j = 1; j < PME_ORDER; j++)
-                ddata[j] = data[j-1]-data[j];
-            data[PME_ORDER-1] = scale*dr*data[PME_ORDER-2];
-            for (int j = 1; j < (PME_ORDER-1); j++)
-                data[PME_ORDER-j-1] = scale*((dr+j)*data[PME_ORDER-j-2]+(fvec4(PME_ORDER-j)-dr)*data[PME_ORDER-j-1]);
-            data[0] = scale*(one-dr)*data[0];
+            computeBSplines<PME_ORDER>(dr, data, ddata);
 
             // Compute the force on this atom.
 
-            int gridIndexX = gridIndex[0];
-            int gridIndexY = gridIndex[1];
-            int gridIndexZ = gridIndex[2];
-            if (gridIndexX < 0)
+            if (gridIndex[0] < 0)
                 return; // This happens when a simulation blows up and coordinates become NaN.
-            int zindex[PME_ORDER];
-            for (int j = 0; j < PME_ORDER; j++) {
-                zindex[j] = gridIndexZ+j;
-                zindex[j] -= (zindex[j] >= gridz ? gridz : 0);
-            }
-            fvec4 zdata[PME_ORDER];
-            for (int j = 0; j < PME_ORDER; j++)
-                zdata[j] = fvec4(data[j][2], data[j][2], ddata[j][2], 0);
-            fvec4 f = 0.0f;
-            for (int ix = 0; ix < PME_ORDER; ix++) {
-                int xbase = gridIndexX+ix;
-                xbase -= (xbase >= gridx ? gridx : 0);
-                xbase = xbase*gridy*gridz;
-                float dx = data[ix][0];
-                float ddx = ddata[ix][0];
-                fvec4 xdata(ddx, dx, dx, 0);
-
-                for (int iy = 0; iy < PME_ORDER; iy++) {
-                    int ybase = gridIndexY+iy;
-                    ybase -= (ybase >= gridy ? gridy : 0);
-                    ybase = xbase + ybase*gridz;
-                    float dy = data[iy][1];
-                    float ddy = ddata[iy][1];
-                    fvec4 xydata = xdata*fvec4(dy, ddy, dy, 0);
-
-                    for (int iz = 0; iz < PME_ORDER; iz++) {
-                        fvec4 gridValue(grid[ybase+zindex[iz]]);
-                        f = f+xydata*zdata[iz]*gridValue;
-                    }
-                }
-            }
+            fvec4 f = gatherFromGrid<PME_ORDER>(grid, gridx, gridy, gridz, gridIndex[0], gridIndex[1], gridIndex[2], data, ddata);
             f *= -epsilonFactor*posq[4*i+3];
             float fc[4];
             f.store(fc);
@@ -417,67 +550,213 @@ static void interpolateForces(float* posq, float* force, float* grid, int gridx,
     }
 }
 
-static void* threadBody(void* args) {
-    CpuCalcPmeReciprocalForceKernel& owner = *reinterpret_cast<CpuCalcPmeReciprocalForceKernel*>(args);
-    owner.runMainThread();
-    return 0;
+/**
+ * Compute the total force on each particle from both the electrostatic and the dispersion grids in a single pass.
+ */
+template <int PME_ORDER>
+static void interpolateChargeAndDispersionForces(float* posq, float* c6, float* force, float* grid, float* dispersionGrid, int gridx, int gridy, int gridz,
+        int dispersionGridx, int dispersionGridy, int dispersionGridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
+        atomic<int>& atomicCounter, const float epsilonFactor, int numThreads) {
+    fvec4 boxSize((float) periodicBoxVectors[0][0], (float) periodicBoxVectors[1][1], (float) periodicBoxVectors[2][2], 0);
+    fvec4 invBoxSize((float) recipBoxVectors[0][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[2][2], 0);
+    fvec4 recipBoxVec0((float) recipBoxVectors[0][0], (float) recipBoxVectors[0][1], (float) recipBoxVectors[0][2], 0);
+    fvec4 recipBoxVec1((float) recipBoxVectors[1][0], (float) recipBoxVectors[1][1], (float) recipBoxVectors[1][2], 0);
+    fvec4 recipBoxVec2((float) recipBoxVectors[2][0], (float) recipBoxVectors[2][1], (float) recipBoxVectors[2][2], 0);
+    fvec4 gridSize(gridx, gridy, gridz, 0);
+    ivec4 gridSizeInt(gridx, gridy, gridz, 0);
+    fvec4 dispersionGridSize(dispersionGridx, dispersionGridy, dispersionGridz, 0);
+    ivec4 dispersionGridSizeInt(dispersionGridx, dispersionGridy, dispersionGridz, 0);
+    bool sameGrid = (gridx == dispersionGridx && gridy == dispersionGridy && gridz == dispersionGridz);
+
+    const int groupSize = max(1, numParticles / (10 * numThreads));
+    while (true) {
+        int start = atomicCounter.fetch_add(groupSize);
+        if (start >= numParticles)
+            break;
+
+        int end = min(start + groupSize, numParticles);
+
+        for (int i = start; i < end; i++) {
+            // Find the fractional coordinates of the particle.
+
+            fvec4 pos(&posq[4*i]);
+            float posInBox[4];
+            (pos-boxSize*floor(pos*invBoxSize)).store(posInBox);
+            fvec4 frac = posInBox[0]*recipBoxVec0 + posInBox[1]*recipBoxVec1 + posInBox[2]*recipBoxVec2;
+            frac = frac-floor(frac);
+
+            // Compute the electrostatic force.  It is accumulated in grid units, scaled by the grid size.
+
+            fvec4 t = frac*gridSize;
+            ivec4 ti = t;
+            fvec4 dr = t-ti;
+            ivec4 gridIndex = ti-(gridSizeInt&ti==gridSizeInt);
+            if (gridIndex[0] < 0)
+                return; // This happens when a simulation blows up and coordinates become NaN.
+            fvec4 data[PME_ORDER];
+            fvec4 ddata[PME_ORDER];
+            computeBSplines<PME_ORDER>(dr, data, ddata);
+            fvec4 f = 0.0f;
+            float charge = posq[4*i+3];
+            if (charge != 0.0f)
+                f = gatherFromGrid<PME_ORDER>(grid, gridx, gridy, gridz, gridIndex[0], gridIndex[1], gridIndex[2], data, ddata)*gridSize*(-epsilonFactor*charge);
+
+            // Add the dispersion force.
+
+            if (c6[i] != 0.0f) {
+                if (!sameGrid) {
+                    t = frac*dispersionGridSize;
+                    ti = t;
+                    dr = t-ti;
+                    gridIndex = ti-(dispersionGridSizeInt&ti==dispersionGridSizeInt);
+                    computeBSplines<PME_ORDER>(dr, data, ddata);
+                }
+                f += gatherFromGrid<PME_ORDER>(dispersionGrid, dispersionGridx, dispersionGridy, dispersionGridz, gridIndex[0], gridIndex[1], gridIndex[2], data, ddata)*dispersionGridSize*(-c6[i]);
+            }
+            float fc[4];
+            f.store(fc);
+            force[4*i+0] = fc[0]*(float)recipBoxVectors[0][0];
+            force[4*i+1] = fc[0]*(float)recipBoxVectors[1][0]+fc[1]*(float)recipBoxVectors[1][1];
+            force[4*i+2] = fc[0]*(float)recipBoxVectors[2][0]+fc[1]*(float)recipBoxVectors[2][1]+fc[2]*(float)recipBoxVectors[2][2];
+        }
+    }
 }
 
-void CpuCalcPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic) {
-    if (!hasInitializedThreads) {
-        numThreads = getNumProcessors();
-        char* threadsEnv = getenv("OPENMM_CPU_THREADS");
-        if (threadsEnv != NULL)
-            stringstream(threadsEnv) >> numThreads;
-        fftwf_init_threads();
-        hasInitializedThreads = true;
+/**
+ * Call the version of spreadCharge() that is specialized for the interpolation order.
+ */
+static void spreadCharge(int order, float* posq, float* grid, int gridx, int gridy, int gridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
+        atomic<int>& atomicCounter, const float epsilonFactor, int threadIndex, int numThreads, bool deterministic) {
+    switch (order) {
+        case 4:
+            spreadCharge<4>(posq, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 5:
+            spreadCharge<5>(posq, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 6:
+            spreadCharge<6>(posq, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 7:
+            spreadCharge<7>(posq, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 8:
+            spreadCharge<8>(posq, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
     }
-    threadEnergy.resize(numThreads);
-    gridx = findFFTDimension(xsize, false);
-    gridy = findFFTDimension(ysize, false);
-    gridz = findFFTDimension(zsize, true);
-    this->numParticles = numParticles;
-    this->alpha = alpha;
-    this->deterministic = deterministic;
-    force.resize(4*numParticles);
-    recipEterm.resize(gridx*gridy*gridz);
-    
-    // Initialize threads.
-    
-    isFinished = false;
-    pthread_cond_init(&startCondition, NULL);
-    pthread_cond_init(&endCondition, NULL);
-    pthread_mutex_init(&lock, NULL);
-    pthread_create(&mainThread, NULL, threadBody, this);
-    
-    // Wait until the main thread is up and running.
-    
-    pthread_mutex_lock(&lock);
-    while (!isFinished)
-        pthread_cond_wait(&endCondition, &lock);
-    pthread_mutex_unlock(&lock);
-    
-    // Initialize FFTW.
-    
-    for (int i = 0; i < numThreads; i++)
-        tempGrid.push_back((float*) fftwf_malloc(sizeof(float)*(gridx*gridy*gridz+3)));
-    realGrid = tempGrid[0];
-    complexGrid = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*gridx*gridy*(gridz/2+1));
-    fftwf_plan_with_nthreads(numThreads);
-    forwardFFT = fftwf_plan_dft_r2c_3d(gridx, gridy, gridz, realGrid, complexGrid, FFTW_MEASURE);
-    backwardFFT = fftwf_plan_dft_c2r_3d(gridx, gridy, gridz, complexGrid, realGrid, FFTW_MEASURE);
-    hasCreatedPlan = true;
-    
-    // Initialize the b-spline moduli.
+}
 
+/**
+ * Call the version of interpolateForces() that is specialized for the interpolation order.
+ */
+static void interpolateForces(int order, float* posq, float* force, float* grid, int gridx, int gridy, int gridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors, atomic<int>& atomicCounter, const float epsilonFactor, int numThreads) {
+    switch (order) {
+        case 4:
+            interpolateForces<4>(posq, force, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 5:
+            interpolateForces<5>(posq, force, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 6:
+            interpolateForces<6>(posq, force, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 7:
+            interpolateForces<7>(posq, force, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 8:
+            interpolateForces<8>(posq, force, grid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+    }
+}
+
+/**
+ * Call the version of spreadChargeAndDispersion() that is specialized for the interpolation order.
+ */
+static void spreadChargeAndDispersion(int order, float* posq, float* c6, float* grid, float* dispersionGrid, int gridx, int gridy, int gridz,
+        int dispersionGridx, int dispersionGridy, int dispersionGridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
+        atomic<int>& atomicCounter, const float epsilonFactor, int threadIndex, int numThreads, bool deterministic) {
+    switch (order) {
+        case 4:
+            spreadChargeAndDispersion<4>(posq, c6, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 5:
+            spreadChargeAndDispersion<5>(posq, c6, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 6:
+            spreadChargeAndDispersion<6>(posq, c6, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 7:
+            spreadChargeAndDispersion<7>(posq, c6, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+        case 8:
+            spreadChargeAndDispersion<8>(posq, c6, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, threadIndex, numThreads, deterministic);
+            break;
+    }
+}
+
+/**
+ * Call the version of interpolateChargeAndDispersionForces() that is specialized for the interpolation order.
+ */
+static void interpolateChargeAndDispersionForces(int order, float* posq, float* c6, float* force, float* grid, float* dispersionGrid, int gridx, int gridy, int gridz,
+        int dispersionGridx, int dispersionGridy, int dispersionGridz, int numParticles, Vec3* periodicBoxVectors, Vec3* recipBoxVectors,
+        atomic<int>& atomicCounter, const float epsilonFactor, int numThreads) {
+    switch (order) {
+        case 4:
+            interpolateChargeAndDispersionForces<4>(posq, c6, force, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 5:
+            interpolateChargeAndDispersionForces<5>(posq, c6, force, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 6:
+            interpolateChargeAndDispersionForces<6>(posq, c6, force, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 7:
+            interpolateChargeAndDispersionForces<7>(posq, c6, force, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+        case 8:
+            interpolateChargeAndDispersionForces<8>(posq, c6, force, grid, dispersionGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+            break;
+    }
+}
+
+/**
+ * Select a size for one grid dimension that FFTW can handle efficiently.
+ */
+static int findFFTDimension(int minimum, bool isZ) {
+    if (minimum < 1)
+        return 1;
+    while (true) {
+        // Attempt to factor the current value.
+
+        if (isZ && minimum%2 == 1) {
+            // Force the last dimension to be even, since this produces better performance in FFTW.
+
+            minimum++;
+            continue;
+        }
+        int unfactored = minimum;
+        for (int factor = 2; factor < 8; factor++) {
+            while (unfactored > 1 && unfactored%factor == 0)
+                unfactored /= factor;
+        }
+        if (unfactored == 1 || unfactored == 11 || unfactored == 13)
+            return minimum;
+        minimum++;
+    }
+}
+
+/**
+ * Compute the B-spline moduli along each axis of a grid.
+ */
+static void computeBSplineModuli(int pmeOrder, int gridx, int gridy, int gridz, vector<float>* bsplineModuli) {
     int maxSize = std::max(std::max(gridx, gridy), gridz);
-    vector<double> data(PME_ORDER);
-    vector<double> ddata(PME_ORDER);
+    vector<double> data(pmeOrder);
+    vector<double> ddata(pmeOrder);
     vector<double> bsplinesData(maxSize);
-    data[PME_ORDER-1] = 0.0;
+    data[pmeOrder-1] = 0.0;
     data[1] = 0.0;
     data[0] = 1.0;
-    for (int i = 3; i < PME_ORDER; i++) {
+    for (int i = 3; i < pmeOrder; i++) {
         double div = 1.0/(i-1.0);
         data[i-1] = 0.0;
         for (int j = 1; j < (i-1); j++)
@@ -488,16 +767,16 @@ void CpuCalcPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize
     // Differentiate.
 
     ddata[0] = -data[0];
-    for (int i = 1; i < PME_ORDER; i++)
+    for (int i = 1; i < pmeOrder; i++)
         ddata[i] = data[i-1]-data[i];
-    double div = 1.0/(PME_ORDER-1);
-    data[PME_ORDER-1] = 0.0;
-    for (int i = 1; i < (PME_ORDER-1); i++)
-        data[PME_ORDER-i-1] = div*(i*data[PME_ORDER-i-2]+(PME_ORDER-i)*data[PME_ORDER-i-1]);
+    double div = 1.0/(pmeOrder-1);
+    data[pmeOrder-1] = 0.0;
+    for (int i = 1; i < (pmeOrder-1); i++)
+        data[pmeOrder-i-1] = div*(i*data[pmeOrder-i-2]+(pmeOrder-i)*data[pmeOrder-i-1]);
     data[0] = div*data[0];
     for (int i = 0; i < maxSize; i++)
         bsplinesData[i] = 0.0;
-    for (int i = 1; i <= PME_ORDER; i++)
+    for (int i = 1; i <= pmeOrder; i++)
         bsplinesData[i] = data[i-1];
 
     // Evaluate the actual bspline moduli for X/Y/Z.
@@ -524,6 +803,61 @@ void CpuCalcPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize
     }
 }
 
+static void* threadBody(void* args) {
+    CpuCalcPmeReciprocalForceKernel& owner = *reinterpret_cast<CpuCalcPmeReciprocalForceKernel*>(args);
+    owner.runMainThread();
+    return 0;
+}
+
+void CpuCalcPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic, int order) {
+    if (order < MinPmeOrder || order > MaxPmeOrder)
+        throw OpenMMException("The PME interpolation order must be between 4 and 8");
+    if (!hasInitializedThreads) {
+        numThreads = getNumPmeThreads();
+        fftwf_init_threads();
+        hasInitializedThreads = true;
+    }
+    threadEnergy.resize(numThreads);
+    gridx = findFFTDimension(xsize, false);
+    gridy = findFFTDimension(ysize, false);
+    gridz = findFFTDimension(zsize, true);
+    this->numParticles = numParticles;
+    this->alpha = alpha;
+    this->deterministic = deterministic;
+    pmeOrder = order;
+    force.resize(4*numParticles);
+    recipEterm.resize(gridx*gridy*gridz);
+    
+    // Initialize threads.  The per-thread grids are allocated by the worker threads in runMainThread().
+    
+    tempGrid.resize(numThreads, NULL);
+    isFinished = false;
+    pthread_cond_init(&startCondition, NULL);
+    pthread_cond_init(&endCondition, NULL);
+    pthread_mutex_init(&lock, NULL);
+    pthread_create(&mainThread, NULL, threadBody, this);
+    
+    // Wait until the main thread is up and running.
+    
+    pthread_mutex_lock(&lock);
+    while (!isFinished)
+        pthread_cond_wait(&endCondition, &lock);
+    pthread_mutex_unlock(&lock);
+    
+    // Initialize FFTW.
+    
+    realGrid = tempGrid[0];
+    complexGrid = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*gridx*gridy*(gridz/2+1));
+    fftwf_plan_with_nthreads(numThreads);
+    forwardFFT = fftwf_plan_dft_r2c_3d(gridx, gridy, gridz, realGrid, complexGrid, FFTW_MEASURE);
+    backwardFFT = fftwf_plan_dft_c2r_3d(gridx, gridy, gridz, complexGrid, realGrid, FFTW_MEASURE);
+    hasCreatedPlan = true;
+    
+    // Initialize the b-spline moduli.
+
+    computeBSplineModuli(pmeOrder, gridx, gridy, gridz, bsplineModuli);
+}
+
 CpuCalcPmeReciprocalForceKernel::~CpuCalcPmeReciprocalForceKernel() {
     isDeleted = true;
     pthread_mutex_lock(&lock);
@@ -547,9 +881,20 @@ void CpuCalcPmeReciprocalForceKernel::runMainThread() {
     // This is the main thread that coordinates all the other ones.
 
     pthread_mutex_lock(&lock);
+    ThreadPool threads(numThreads, vector<int>(), useSharedThreadPool());
+
+    // Each thread allocates and clears its own grid, so on NUMA systems it is placed close to that thread.
+
+    threads.execute([&] (ThreadPool& threads, int threadIndex) {
+        int gridSize = gridx*gridy*gridz+3;
+        float* grid = (float*) fftwf_malloc(sizeof(float)*gridSize);
+        for (int i = 0; i < gridSize; i++)
+            grid[i] = 0.0f;
+        tempGrid[threadIndex] = grid;
+    });
+    threads.waitForThreads();
     isFinished = true;
     pthread_cond_signal(&endCondition);
-    ThreadPool threads(numThreads);
     while (true) {
         // Wait for the signal to start.
 
@@ -598,7 +943,7 @@ void CpuCalcPmeReciprocalForceKernel::runWorkerThread(ThreadPool& threads, int i
     int complexStart = std::max(1, ((index*complexSize)/numThreads));
     int complexEnd = (((index+1)*complexSize)/numThreads);
     const float epsilonFactor = sqrt(ONE_4PI_EPS0);
-    spreadCharge(posq, tempGrid[index], gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, index, numThreads, deterministic);
+    spreadCharge(pmeOrder, posq, tempGrid[index], gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, index, numThreads, deterministic);
     threads.syncThreads();
     int numGrids = tempGrid.size();
     for (int i = gridStart; i < gridEnd; i += 4) {
@@ -618,7 +963,7 @@ void CpuCalcPmeReciprocalForceKernel::runWorkerThread(ThreadPool& threads, int i
     }
     reciprocalConvolution(complexStart, complexEnd, complexGrid, recipEterm);
     threads.syncThreads();
-    interpolateForces(posq, &force[0], realGrid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+    interpolateForces(pmeOrder, posq, &force[0], realGrid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
 }
 
 void CpuCalcPmeReciprocalForceKernel::beginComputation(IO& io, const Vec3* periodicBoxVectors, bool includeEnergy) {
@@ -666,29 +1011,6 @@ void CpuCalcPmeReciprocalForceKernel::getPMEParameters(double& alpha, int& nx, i
     nz = gridz;
 }
 
-int CpuCalcPmeReciprocalForceKernel::findFFTDimension(int minimum, bool isZ) {
-    if (minimum < 1)
-        return 1;
-    while (true) {
-        // Attempt to factor the current value.
-
-        if (isZ && minimum%2 == 1) {
-            // Force the last dimension to be even, since this produces better performance in FFTW.
-
-            minimum++;
-            continue;
-        }
-        int unfactored = minimum;
-        for (int factor = 2; factor < 8; factor++) {
-            while (unfactored > 1 && unfactored%factor == 0)
-                unfactored /= factor;
-        }
-        if (unfactored == 1 || unfactored == 11 || unfactored == 13)
-            return minimum;
-        minimum++;
-    }
-}
-
 /*
  * Everything below here is just a clone of the above, but to handle the dispersion term
  * instead of electrostatics.
@@ -714,12 +1036,11 @@ static void* dispersionThreadBody(void* args) {
     return 0;
 }
 
-void CpuCalcDispersionPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic) {
+void CpuCalcDispersionPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic, int order) {
+    if (order < MinPmeOrder || order > MaxPmeOrder)
+        throw OpenMMException("The PME interpolation order must be between 4 and 8");
     if (!hasInitializedThreads) {
-        numThreads = getNumProcessors();
-        char* threadsEnv = getenv("OPENMM_CPU_THREADS");
-        if (threadsEnv != NULL)
-            stringstream(threadsEnv) >> numThreads;
+        numThreads = getNumPmeThreads();
         fftwf_init_threads();
         hasInitializedThreads = true;
     }
@@ -730,11 +1051,13 @@ void CpuCalcDispersionPmeReciprocalForceKernel::initialize(int xsize, int ysize,
     this->numParticles = numParticles;
     this->alpha = alpha;
     this->deterministic = deterministic;
+    pmeOrder = order;
     force.resize(4*numParticles);
     recipEterm.resize(gridx*gridy*gridz);
     
-    // Initialize threads.
+    // Initialize threads.  The per-thread grids are allocated by the worker threads in runMainThread().
     
+    tempGrid.resize(numThreads, NULL);
     isFinished = false;
     pthread_cond_init(&startCondition, NULL);
     pthread_cond_init(&endCondition, NULL);
@@ -750,8 +1073,6 @@ void CpuCalcDispersionPmeReciprocalForceKernel::initialize(int xsize, int ysize,
     
     // Initialize FFTW.
     
-    for (int i = 0; i < numThreads; i++)
-        tempGrid.push_back((float*) fftwf_malloc(sizeof(float)*(gridx*gridy*gridz+3)));
     realGrid = tempGrid[0];
     complexGrid = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*gridx*gridy*(gridz/2+1));
     fftwf_plan_with_nthreads(numThreads);
@@ -761,58 +1082,7 @@ void CpuCalcDispersionPmeReciprocalForceKernel::initialize(int xsize, int ysize,
     
     // Initialize the b-spline moduli.
 
-    int maxSize = std::max(std::max(gridx, gridy), gridz);
-    vector<double> data(PME_ORDER);
-    vector<double> ddata(PME_ORDER);
-    vector<double> bsplinesData(maxSize);
-    data[PME_ORDER-1] = 0.0;
-    data[1] = 0.0;
-    data[0] = 1.0;
-    for (int i = 3; i < PME_ORDER; i++) {
-        double div = 1.0/(i-1.0);
-        data[i-1] = 0.0;
-        for (int j = 1; j < (i-1); j++)
-            data[i-j-1] = div*(j*data[i-j-2]+(i-j)*data[i-j-1]);
-        data[0] = div*data[0];
-    }
-
-    // Differentiate.
-
-    ddata[0] = -data[0];
-    for (int i = 1; i < PME_ORDER; i++)
-        ddata[i] = data[i-1]-data[i];
-    double div = 1.0/(PME_ORDER-1);
-    data[PME_ORDER-1] = 0.0;
-    for (int i = 1; i < (PME_ORDER-1); i++)
-        data[PME_ORDER-i-1] = div*(i*data[PME_ORDER-i-2]+(PME_ORDER-i)*data[PME_ORDER-i-1]);
-    data[0] = div*data[0];
-    for (int i = 0; i < maxSize; i++)
-        bsplinesData[i] = 0.0;
-    for (int i = 1; i <= PME_ORDER; i++)
-        bsplinesData[i] = data[i-1];
-
-    // Evaluate the actual bspline moduli for X/Y/Z.
-
-    bsplineModuli[0].resize(gridx);
-    bsplineModuli[1].resize(gridy);
-    bsplineModuli[2].resize(gridz);
-    for (int dim = 0; dim < 3; dim++) {
-        int ndata = bsplineModuli[dim].size();
-        vector<float>& moduli = bsplineModuli[dim];
-        for (int i = 0; i < ndata; i++) {
-            double sc = 0.0;
-            double ss = 0.0;
-            for (int j = 0; j < ndata; j++) {
-                double arg = (2.0*M_PI*i*j)/ndata;
-                sc += bsplinesData[j]*cos(arg);
-                ss += bsplinesData[j]*sin(arg);
-            }
-            moduli[i] = (float) (sc*sc+ss*ss);
-        }
-        for (int i = 0; i < ndata; i++)
-            if (moduli[i] < 1.0e-7f)
-                moduli[i] = (moduli[i-1]+moduli[i+1])*0.5f;
-    }
+    computeBSplineModuli(pmeOrder, gridx, gridy, gridz, bsplineModuli);
 }
 
 CpuCalcDispersionPmeReciprocalForceKernel::~CpuCalcDispersionPmeReciprocalForceKernel() {
@@ -838,9 +1108,20 @@ void CpuCalcDispersionPmeReciprocalForceKernel::runMainThread() {
     // This is the main thread that coordinates all the other ones.
 
     pthread_mutex_lock(&lock);
+    ThreadPool threads(numThreads, vector<int>(), useSharedThreadPool());
+
+    // Each thread allocates and clears its own grid, so on NUMA systems it is placed close to that thread.
+
+    threads.execute([&] (ThreadPool& threads, int threadIndex) {
+        int gridSize = gridx*gridy*gridz+3;
+        float* grid = (float*) fftwf_malloc(sizeof(float)*gridSize);
+        for (int i = 0; i < gridSize; i++)
+            grid[i] = 0.0f;
+        tempGrid[threadIndex] = grid;
+    });
+    threads.waitForThreads();
     isFinished = true;
     pthread_cond_signal(&endCondition);
-    ThreadPool threads(numThreads);
     while (true) {
         // Wait for the signal to start.
 
@@ -890,7 +1171,7 @@ void CpuCalcDispersionPmeReciprocalForceKernel::runWorkerThread(ThreadPool& thre
     int complexStart = std::max(1, ((index*complexSize)/numThreads));
     int complexEnd = (((index+1)*complexSize)/numThreads);
     const float epsilonFactor = 1.0f;
-    spreadCharge(posq, tempGrid[index], gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, index, numThreads, deterministic);
+    spreadCharge(pmeOrder, posq, tempGrid[index], gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, index, numThreads, deterministic);
     threads.syncThreads();
     int numGrids = tempGrid.size();
     for (int i = gridStart; i < gridEnd; i += 4) {
@@ -912,7 +1193,7 @@ void CpuCalcDispersionPmeReciprocalForceKernel::runWorkerThread(ThreadPool& thre
     complexStart = (index*complexSize)/numThreads;
     reciprocalConvolution(complexStart, complexEnd, complexGrid, recipEterm);
     threads.syncThreads();
-    interpolateForces(posq, &force[0], realGrid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+    interpolateForces(pmeOrder, posq, &force[0], realGrid, gridx, gridy, gridz, numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
 }
 
 void CpuCalcDispersionPmeReciprocalForceKernel::beginComputation(CalcPmeReciprocalForceKernel::IO& io, const Vec3* periodicBoxVectors, bool includeEnergy) {
@@ -960,25 +1241,270 @@ void CpuCalcDispersionPmeReciprocalForceKernel::getPMEParameters(double& alpha,
     nz = gridz;
 }
 
-int CpuCalcDispersionPmeReciprocalForceKernel::findFFTDimension(int minimum, bool isZ) {
-    if (minimum < 1)
-        return 1;
-    while (true) {
-        // Attempt to factor the current value.
+/*
+ * The combined electrostatic and dispersion kernel.
+ */
 
-        if (isZ && minimum%2 == 1) {
-            // Force the last dimension to be even, since this produces better performance in FFTW.
+bool CpuCalcLJPmeReciprocalForceKernel::hasInitializedThreads = false;
+int CpuCalcLJPmeReciprocalForceKernel::numThreads = 0;
 
-            minimum++;
-            continue;
+static void* ljpmeThreadBody(void* args) {
+    CpuCalcLJPmeReciprocalForceKernel& owner = *reinterpret_cast<CpuCalcLJPmeReciprocalForceKernel*>(args);
+    owner.runMainThread();
+    return 0;
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::initialize(int xsize, int ysize, int zsize, int dispersionXsize, int dispersionYsize, int dispersionZsize,
+        int numParticles, double alpha, double dispersionAlpha, bool deterministic, int order) {
+    if (order < MinPmeOrder || order > MaxPmeOrder)
+        throw OpenMMException("The PME interpolation order must be between 4 and 8");
+    if (!hasInitializedThreads) {
+        numThreads = getNumPmeThreads();
+        fftwf_init_threads();
+        hasInitializedThreads = true;
+    }
+    threadEnergy.resize(numThreads);
+    gridx = findFFTDimension(xsize, false);
+    gridy = findFFTDimension(ysize, false);
+    gridz = findFFTDimension(zsize, true);
+    dispersionGridx = findFFTDimension(dispersionXsize, false);
+    dispersionGridy = findFFTDimension(dispersionYsize, false);
+    dispersionGridz = findFFTDimension(dispersionZsize, true);
+    this->numParticles = numParticles;
+    this->alpha = alpha;
+    this->dispersionAlpha = dispersionAlpha;
+    this->deterministic = deterministic;
+    pmeOrder = order;
+    force.resize(4*numParticles);
+    recipEterm.resize(gridx*gridy*gridz);
+    dispersionRecipEterm.resize(dispersionGridx*dispersionGridy*dispersionGridz);
+
+    // Initialize threads.  The per-thread grids are allocated by the worker threads in runMainThread().
+
+    tempGrid.resize(numThreads, NULL);
+    dispersionTempGrid.resize(numThreads, NULL);
+    isFinished = false;
+    pthread_cond_init(&startCondition, NULL);
+    pthread_cond_init(&endCondition, NULL);
+    pthread_mutex_init(&lock, NULL);
+    pthread_create(&mainThread, NULL, ljpmeThreadBody, this);
+
+    // Wait until the main thread is up and running.
+
+    pthread_mutex_lock(&lock);
+    while (!isFinished)
+        pthread_cond_wait(&endCondition, &lock);
+    pthread_mutex_unlock(&lock);
+
+    // Initialize FFTW.
+
+    realGrid = tempGrid[0];
+    dispersionRealGrid = dispersionTempGrid[0];
+    complexGrid = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*gridx*gridy*(gridz/2+1));
+    dispersionComplexGrid = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*dispersionGridx*dispersionGridy*(dispersionGridz/2+1));
+    fftwf_plan_with_nthreads(numThreads);
+    forwardFFT = fftwf_plan_dft_r2c_3d(gridx, gridy, gridz, realGrid, complexGrid, FFTW_MEASURE);
+    backwardFFT = fftwf_plan_dft_c2r_3d(gridx, gridy, gridz, complexGrid, realGrid, FFTW_MEASURE);
+    dispersionForwardFFT = fftwf_plan_dft_r2c_3d(dispersionGridx, dispersionGridy, dispersionGridz, dispersionRealGrid, dispersionComplexGrid, FFTW_MEASURE);
+    dispersionBackwardFFT = fftwf_plan_dft_c2r_3d(dispersionGridx, dispersionGridy, dispersionGridz, dispersionComplexGrid, dispersionRealGrid, FFTW_MEASURE);
+    hasCreatedPlan = true;
+
+    // Initialize the b-spline moduli.
+
+    computeBSplineModuli(pmeOrder, gridx, gridy, gridz, bsplineModuli);
+    computeBSplineModuli(pmeOrder, dispersionGridx, dispersionGridy, dispersionGridz, dispersionBsplineModuli);
+}
+
+CpuCalcLJPmeReciprocalForceKernel::~CpuCalcLJPmeReciprocalForceKernel() {
+    isDeleted = true;
+    pthread_mutex_lock(&lock);
+    pthread_cond_broadcast(&startCondition);
+    pthread_mutex_unlock(&lock);
+    pthread_join(mainThread, NULL);
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&startCondition);
+    pthread_cond_destroy(&endCondition);
+    for (auto grid : tempGrid)
+        fftwf_free(grid);
+    for (auto grid : dispersionTempGrid)
+        fftwf_free(grid);
+    if (complexGrid != NULL)
+        fftwf_free(complexGrid);
+    if (dispersionComplexGrid != NULL)
+        fftwf_free(dispersionComplexGrid);
+    if (hasCreatedPlan) {
+        fftwf_destroy_plan(forwardFFT);
+        fftwf_destroy_plan(backwardFFT);
+        fftwf_destroy_plan(dispersionForwardFFT);
+        fftwf_destroy_plan(dispersionBackwardFFT);
+    }
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::runMainThread() {
+    // This is the main thread that coordinates all the other ones.
+
+    pthread_mutex_lock(&lock);
+    ThreadPool threads(numThreads, vector<int>(), useSharedThreadPool());
+
+    // Each thread allocates and clears its own grids, so on NUMA systems they are placed close to that thread.
+
+    threads.execute([&] (ThreadPool& threads, int threadIndex) {
+        int gridSize = gridx*gridy*gridz+3;
+        float* grid = (float*) fftwf_malloc(sizeof(float)*gridSize);
+        for (int i = 0; i < gridSize; i++)
+            grid[i] = 0.0f;
+        tempGrid[threadIndex] = grid;
+        gridSize = dispersionGridx*dispersionGridy*dispersionGridz+3;
+        grid = (float*) fftwf_malloc(sizeof(float)*gridSize);
+        for (int i = 0; i < gridSize; i++)
+            grid[i] = 0.0f;
+        dispersionTempGrid[threadIndex] = grid;
+    });
+    threads.waitForThreads();
+    isFinished = true;
+    pthread_cond_signal(&endCondition);
+    while (true) {
+        // Wait for the signal to start.
+
+        pthread_cond_wait(&startCondition, &lock);
+        if (isDeleted)
+            break;
+        posq = io->getPosq();
+        c6 = io->getDispersionCoefficients();
+        atomicCounter = 0;
+        threads.execute([&] (ThreadPool& threads, int threadIndex) { runWorkerThread(threads, threadIndex); }); // Signal threads to spread charges and dispersion coefficients.
+        threads.waitForThreads();
+        threads.resumeThreads(); // Signal threads to sum the grids.
+        threads.waitForThreads();
+        fftwf_execute_dft_r2c(forwardFFT, realGrid, complexGrid);
+        fftwf_execute_dft_r2c(dispersionForwardFFT, dispersionRealGrid, dispersionComplexGrid);
+        if (lastBoxVectors[0] != periodicBoxVectors[0] || lastBoxVectors[1] != periodicBoxVectors[1] || lastBoxVectors[2] != periodicBoxVectors[2]) {
+            threads.resumeThreads(); // Signal threads to compute the reciprocal scale factors.
+            threads.waitForThreads();
         }
-        int unfactored = minimum;
-        for (int factor = 2; factor < 8; factor++) {
-            while (unfactored > 1 && unfactored%factor == 0)
-                unfactored /= factor;
+        if (includeEnergy) {
+            threads.resumeThreads(); // Signal threads to compute energy.
+            threads.waitForThreads();
+            for (auto e : threadEnergy)
+                energy += e;
         }
-        if (unfactored == 1 || unfactored == 11 || unfactored == 13)
-            return minimum;
-        minimum++;
+        threads.resumeThreads(); // Signal threads to perform reciprocal convolution.
+        threads.waitForThreads();
+        fftwf_execute_dft_c2r(backwardFFT, complexGrid, realGrid);
+        fftwf_execute_dft_c2r(dispersionBackwardFFT, dispersionComplexGrid, dispersionRealGrid);
+        atomicCounter = 0;
+        threads.resumeThreads(); // Signal threads to interpolate forces.
+        threads.waitForThreads();
+        isFinished = true;
+        lastBoxVectors[0] = periodicBoxVectors[0];
+        lastBoxVectors[1] = periodicBoxVectors[1];
+        lastBoxVectors[2] = periodicBoxVectors[2];
+        pthread_cond_signal(&endCondition);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::runWorkerThread(ThreadPool& threads, int index) {
+    const float epsilonFactor = sqrt(ONE_4PI_EPS0);
+    spreadChargeAndDispersion(pmeOrder, posq, c6, tempGrid[index], dispersionTempGrid[index], gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz,
+            numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, index, numThreads, deterministic);
+    threads.syncThreads();
+    int numGrids = tempGrid.size();
+    int gridSize = (gridx*gridy*gridz+3)/4;
+    int gridStart = 4*((index*gridSize)/numThreads);
+    int gridEnd = 4*(((index+1)*gridSize)/numThreads);
+    for (int i = gridStart; i < gridEnd; i += 4) {
+        fvec4 sum(&realGrid[i]);
+        for (int j = 1; j < numGrids; j++)
+            sum += fvec4(&tempGrid[j][i]);
+        sum.store(&realGrid[i]);
+    }
+    gridSize = (dispersionGridx*dispersionGridy*dispersionGridz+3)/4;
+    gridStart = 4*((index*gridSize)/numThreads);
+    gridEnd = 4*(((index+1)*gridSize)/numThreads);
+    for (int i = gridStart; i < gridEnd; i += 4) {
+        fvec4 sum(&dispersionRealGrid[i]);
+        for (int j = 1; j < numGrids; j++)
+            sum += fvec4(&dispersionTempGrid[j][i]);
+        sum.store(&dispersionRealGrid[i]);
+    }
+    threads.syncThreads();
+    int gridxStart = (index*gridx)/numThreads;
+    int gridxEnd = ((index+1)*gridx)/numThreads;
+    int dispersionGridxStart = (index*dispersionGridx)/numThreads;
+    int dispersionGridxEnd = ((index+1)*dispersionGridx)/numThreads;
+    if (lastBoxVectors[0] != periodicBoxVectors[0] || lastBoxVectors[1] != periodicBoxVectors[1] || lastBoxVectors[2] != periodicBoxVectors[2]) {
+        computeReciprocalEterm(gridxStart, gridxEnd, gridx, gridy, gridz, recipEterm, alpha, bsplineModuli, periodicBoxVectors, recipBoxVectors);
+        computeReciprocalDispersionEterm(dispersionGridxStart, dispersionGridxEnd, dispersionGridx, dispersionGridy, dispersionGridz, dispersionRecipEterm,
+                dispersionAlpha, dispersionBsplineModuli, periodicBoxVectors, recipBoxVectors);
+        threads.syncThreads();
+    }
+    if (includeEnergy) {
+        threadEnergy[index] = reciprocalEnergy(gridxStart, gridxEnd, complexGrid, recipEterm, gridx, gridy, gridz, alpha, bsplineModuli, periodicBoxVectors, recipBoxVectors);
+        threadEnergy[index] += reciprocalDispersionEnergy(dispersionGridxStart, dispersionGridxEnd, dispersionComplexGrid, dispersionRecipEterm, dispersionGridx,
+                dispersionGridy, dispersionGridz, dispersionAlpha, dispersionBsplineModuli, periodicBoxVectors, recipBoxVectors);
+        threads.syncThreads();
+    }
+
+    // For dispersion, we include the {0,0,0} term, so it starts from 0.
+
+    int complexSize = gridx*gridy*(gridz/2+1);
+    reciprocalConvolution(std::max(1, (index*complexSize)/numThreads), ((index+1)*complexSize)/numThreads, complexGrid, recipEterm);
+    complexSize = dispersionGridx*dispersionGridy*(dispersionGridz/2+1);
+    reciprocalConvolution((index*complexSize)/numThreads, ((index+1)*complexSize)/numThreads, dispersionComplexGrid, dispersionRecipEterm);
+    threads.syncThreads();
+    interpolateChargeAndDispersionForces(pmeOrder, posq, c6, &force[0], realGrid, dispersionRealGrid, gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz,
+            numParticles, periodicBoxVectors, recipBoxVectors, atomicCounter, epsilonFactor, numThreads);
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::beginComputation(IO& io, const Vec3* periodicBoxVectors, bool includeEnergy) {
+    this->io = &io;
+    this->periodicBoxVectors[0] = periodicBoxVectors[0];
+    this->periodicBoxVectors[1] = periodicBoxVectors[1];
+    this->periodicBoxVectors[2] = periodicBoxVectors[2];
+    this->includeEnergy = includeEnergy;
+    energy = 0.0;
+
+    // Invert the box vectors.
+
+    double determinant = periodicBoxVectors[0][0]*periodicBoxVectors[1][1]*periodicBoxVectors[2][2];
+    double scale = 1.0/determinant;
+    recipBoxVectors[0] = Vec3(periodicBoxVectors[1][1]*periodicBoxVectors[2][2], 0, 0)*scale;
+    recipBoxVectors[1] = Vec3(-periodicBoxVectors[1][0]*periodicBoxVectors[2][2], periodicBoxVectors[0][0]*periodicBoxVectors[2][2], 0)*scale;
+    recipBoxVectors[2] = Vec3(periodicBoxVectors[1][0]*periodicBoxVectors[2][1]-periodicBoxVectors[1][1]*periodicBoxVectors[2][0], -periodicBoxVectors[0][0]*periodicBoxVectors[2][1], periodicBoxVectors[0][0]*periodicBoxVectors[1][1])*scale;
+
+    // Do the calculation.
+
+    pthread_mutex_lock(&lock);
+    isFinished = false;
+    pthread_cond_signal(&startCondition);
+    pthread_mutex_unlock(&lock);
+}
+
+double CpuCalcLJPmeReciprocalForceKernel::finishComputation(IO& io) {
+    pthread_mutex_lock(&lock);
+    while (!isFinished) {
+        pthread_cond_wait(&endCondition, &lock);
     }
+    pthread_mutex_unlock(&lock);
+    io.setForce(&force[0]);
+    return energy;
+}
+
+bool CpuCalcLJPmeReciprocalForceKernel::isProcessorSupported() {
+    return isVec4Supported();
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
+    alpha = this->alpha;
+    nx = gridx;
+    ny = gridy;
+    nz = gridz;
+}
+
+void CpuCalcLJPmeReciprocalForceKernel::getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
+    alpha = dispersionAlpha;
+    nx = dispersionGridx;
+    ny = dispersionGridy;
+    nz = dispersionGridz;
 }
@@ -63,8 +63,9 @@ public:
      * @param numParticles the number of particles in the system
      * @param alpha        the Ewald blending parameter
      * @param deterministic whether it should attempt to make the resulting forces deterministic
+     * @param order        the order of the B-splines used to interpolate onto the grid
      */
-    void initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic);
+    void initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic, int order);
     ~CpuCalcPmeReciprocalForceKernel();
     /**
      * Begin computing the force and energy.
@@ -103,13 +104,9 @@ public:
      */
     void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
 private:
-    /**
-     * Select a size for one grid dimension that FFTW can handle efficiently.
-     */
-    int findFFTDimension(int minimum, bool isZ);
     static bool hasInitializedThreads;
     static int numThreads;
-    int gridx, gridy, gridz, numParticles;
+    int gridx, gridy, gridz, numParticles, pmeOrder;
     double alpha;
     bool deterministic;
     bool hasCreatedPlan, isFinished, isDeleted;
@@ -156,8 +153,9 @@ public:
      * @param numParticles the number of particles in the system
      * @param alpha        the Ewald blending parameter
      * @param deterministic whether it should attempt to make the resulting forces deterministic
+     * @param order        the order of the B-splines used to interpolate onto the grid
      */
-    void initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic);
+    void initialize(int xsize, int ysize, int zsize, int numParticles, double alpha, bool deterministic, int order);
     ~CpuCalcDispersionPmeReciprocalForceKernel();
     /**
      * Begin computing the force and energy.
@@ -197,13 +195,9 @@ public:
     void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
 private:
     class ComputeTask;
-    /**
-     * Select a size for one grid dimension that FFTW can handle efficiently.
-     */
-    int findFFTDimension(int minimum, bool isZ);
     static bool hasInitializedThreads;
     static int numThreads;
-    int gridx, gridy, gridz, numParticles;
+    int gridx, gridy, gridz, numParticles, pmeOrder;
     double alpha;
     bool deterministic;
     bool hasCreatedPlan, isFinished, isDeleted;
@@ -229,6 +223,113 @@ private:
     std::atomic<int> atomicCounter;
 };
 
+/**
+ * This is an optimized CPU implementation of CalcLJPmeReciprocalForceKernel.  It computes the electrostatic
+ * and dispersion reciprocal space interactions together, using a single set of threads: each particle is
+ * spread onto both grids and has its forces interpolated from both grids in a single pass, and the FFTs for
+ * the two grids are performed back to back.
+ */
+
+class OPENMM_EXPORT_PME CpuCalcLJPmeReciprocalForceKernel : public CalcLJPmeReciprocalForceKernel {
+public:
+    CpuCalcLJPmeReciprocalForceKernel(const std::string& name, const Platform& platform) : CalcLJPmeReciprocalForceKernel(name, platform),
+            hasCreatedPlan(false), isDeleted(false), realGrid(NULL), dispersionRealGrid(NULL), complexGrid(NULL), dispersionComplexGrid(NULL) {
+    }
+    /**
+     * Initialize the kernel.
+     * 
+     * @param gridx           the x size of the electrostatic PME grid
+     * @param gridy           the y size of the electrostatic PME grid
+     * @param gridz           the z size of the electrostatic PME grid
+     * @param dispersionGridx the x size of the dispersion PME grid
+     * @param dispersionGridy the y size of the dispersion PME grid
+     * @param dispersionGridz the z size of the dispersion PME grid
+     * @param numParticles    the number of particles in the system
+     * @param alpha           the Ewald blending parameter for electrostatics
+     * @param dispersionAlpha the Ewald blending parameter for dispersion
+     * @param deterministic   whether it should attempt to make the resulting forces deterministic
+     * @param order           the order of the B-splines used to interpolate onto the grids
+     */
+    void initialize(int xsize, int ysize, int zsize, int dispersionXsize, int dispersionYsize, int dispersionZsize,
+            int numParticles, double alpha, double dispersionAlpha, bool deterministic, int order);
+    ~CpuCalcLJPmeReciprocalForceKernel();
+    /**
+     * Begin computing the force and energy.
+     * 
+     * @param io                  an object that coordinates data transfer
+     * @param periodicBoxVectors  the vectors defining the periodic box (measured in nm)
+     * @param includeEnergy       true if potential energy should be computed
+     */
+    void beginComputation(IO& io, const Vec3* periodicBoxVectors, bool includeEnergy);
+    /**
+     * Finish computing the force and energy.
+     * 
+     * @param io   an object that coordinates data transfer
+     * @return the sum of the electrostatic and dispersion reciprocal space energies
+     */
+    double finishComputation(IO& io);
+    /**
+     * This routine contains the code executed by the main thread.
+     */
+    void runMainThread();
+    /**
+     * This routine contains the code executed by each worker thread.
+     */
+    void runWorkerThread(ThreadPool& threads, int index);
+    /**
+     * Get whether the current CPU supports all features needed by this kernel.
+     */
+    static bool isProcessorSupported();
+    /**
+     * Get the parameters being used for electrostatic PME.
+     * 
+     * @param alpha   the separation parameter
+     * @param nx      the number of grid points along the X axis
+     * @param ny      the number of grid points along the Y axis
+     * @param nz      the number of grid points along the Z axis
+     */
+    void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+    /**
+     * Get the parameters being used for dispersion PME.
+     * 
+     * @param alpha   the separation parameter
+     * @param nx      the number of grid points along the X axis
+     * @param ny      the number of grid points along the Y axis
+     * @param nz      the number of grid points along the Z axis
+     */
+    void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+private:
+    static bool hasInitializedThreads;
+    static int numThreads;
+    int gridx, gridy, gridz, dispersionGridx, dispersionGridy, dispersionGridz, numParticles, pmeOrder;
+    double alpha, dispersionAlpha;
+    bool deterministic;
+    bool hasCreatedPlan, isFinished, isDeleted;
+    std::vector<float> force;
+    std::vector<float> bsplineModuli[3], dispersionBsplineModuli[3];
+    std::vector<float> recipEterm, dispersionRecipEterm;
+    Vec3 lastBoxVectors[3];
+    std::vector<float> threadEnergy;
+    std::vector<float*> tempGrid, dispersionTempGrid;
+    float* realGrid;
+    float* dispersionRealGrid;
+    fftwf_complex* complexGrid;
+    fftwf_complex* dispersionComplexGrid;
+    fftwf_plan forwardFFT, backwardFFT, dispersionForwardFFT, dispersionBackwardFFT;
+    int waitCount;
+    pthread_cond_t startCondition, endCondition;
+    pthread_mutex_t lock;
+    pthread_t mainThread;
+    // The following variables are used to store information about the calculation currently being performed.
+    IO* io;
+    float energy;
+    float* posq;
+    float* c6;
+    Vec3 periodicBoxVectors[3], recipBoxVectors[3];
+    bool includeEnergy;
+    std::atomic<int> atomicCounter;
+};
+
 } // namespace OpenMM
 
 #endif /*OPENMM_CPU_PME_KERNELS_H_*/
@@ -42,6 +42,7 @@
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/Units.h"
 #include "../src/CpuPmeKernels.h"
+#include "ReferencePME.h"
 #include "SimTKOpenMMRealType.h"
 #include "sfmt/SFMT.h"
 #include <iostream>
@@ -62,6 +63,21 @@ public:
     }
 };
 
+class LJPmeIO : public CalcLJPmeReciprocalForceKernel::IO {
+public:
+    vector<float> posq, c6;
+    float* force;
+    float* getPosq() {
+        return &posq[0];
+    }
+    float* getDispersionCoefficients() {
+        return &c6[0];
+    }
+    void setForce(float* force) {
+        this->force = force;
+    }
+};
+
 void make_waterbox(int natoms, double boxEdgeLength, NonbondedForce *forceField,  vector<Vec3> &positions, vector<double>& eps, vector<double>& sig,
                    vector<pair<int, int> >& bonds, System &system, bool do_electrostatics) {
     const int RESSIZE = 3;
@@ -535,7 +551,7 @@ void test_water2_dpme_energies_forces_no_exclusions() {
         io.posq.push_back(c6);
         selfEwaldEnergy += dalpha6 * c6 * c6 / 12.0;
     }
-    pme.initialize(grid, grid, grid, NATOMS, dalpha, false);
+    pme.initialize(grid, grid, grid, NATOMS, dalpha, false, 5);
     Vec3 boxVectors[3];
     system.getDefaultPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
     pme.beginComputation(io, boxVectors, true);
@@ -565,7 +581,7 @@ void test_water2_dpme_energies_forces_no_exclusions() {
 }
 
 
-void testPME(bool triclinic) {
+void testPME(bool triclinic, int order) {
     // Create a cloud of random point charges.
 
     const int numParticles = 51;
@@ -599,42 +615,46 @@ void testPME(bool triclinic) {
     force->setCutoffDistance(cutoff);
     force->setReciprocalSpaceForceGroup(1);
     force->setEwaldErrorTolerance(1e-4);
-    
-    // Compute the reciprocal space forces with the reference platform.
-    
-    Platform& platform = Platform::getPlatformByName("Reference");
-    VerletIntegrator integrator(0.01);
-    Context context(system, integrator, platform);
-    context.setPositions(positions);
-    State refState = context.getState(State::Forces | State::Energy, false, 1<<1);
-    
-    // Now compute them with the optimized kernel.
-    
     double alpha;
     int gridx, gridy, gridz;
-    NonbondedForceImpl::calcPMEParameters(system, *force, alpha, gridx, gridy, gridz, false);
+    NonbondedForceImpl::calcPMEParameters(system, *force, alpha, gridx, gridy, gridz, false, order);
+
+    // Compute the reciprocal space forces with the reference implementation, using
+    // the same grid and interpolation order.
+
+    vector<double> charges(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        double sigma, epsilon;
+        force->getParticleParameters(i, charges[i], sigma, epsilon);
+    }
+    pme_t refPme;
+    int grid[3] = {gridx, gridy, gridz};
+    pme_init(&refPme, alpha, numParticles, grid, order, 1.0);
+    vector<Vec3> refForces(numParticles, Vec3());
+    double refEnergy;
+    pme_exec(refPme, positions, refForces, charges, boxVectors, &refEnergy);
+    pme_destroy(refPme);
+
+    // Now compute them with the optimized kernel.
+
+    Platform& platform = Platform::getPlatformByName("Reference");
     CpuCalcPmeReciprocalForceKernel pme(CalcPmeReciprocalForceKernel::Name(), platform);
     IO io;
-    double sumSquaredCharges = 0;
     for (int i = 0; i < numParticles; i++) {
         io.posq.push_back(positions[i][0]);
         io.posq.push_back(positions[i][1]);
         io.posq.push_back(positions[i][2]);
-        double charge, sigma, epsilon;
-        force->getParticleParameters(i, charge, sigma, epsilon);
-        io.posq.push_back(charge);
-        sumSquaredCharges += charge*charge;
+        io.posq.push_back(charges[i]);
     }
-    double ewaldSelfEnergy = -ONE_4PI_EPS0*alpha*sumSquaredCharges/sqrt(M_PI);
-    pme.initialize(gridx, gridy, gridz, numParticles, alpha, true);
+    pme.initialize(gridx, gridy, gridz, numParticles, alpha, true, order);
     pme.beginComputation(io, boxVectors, true);
     double energy = pme.finishComputation(io);
 
     // See if they match.
     
-    ASSERT_EQUAL_TOL(refState.getPotentialEnergy(), energy+ewaldSelfEnergy, 1e-3);
+    ASSERT_EQUAL_TOL(refEnergy, energy, 1e-3);
     for (int i = 0; i < numParticles; i++)
-        ASSERT_EQUAL_VEC(refState.getForces()[i], Vec3(io.force[4*i], io.force[4*i+1], io.force[4*i+2]), 1e-3);
+        ASSERT_EQUAL_VEC(refForces[i], Vec3(io.force[4*i], io.force[4*i+1], io.force[4*i+2]), 1e-3);
 }
 
 void testLJPME(bool triclinic) {
@@ -695,7 +715,7 @@ void testLJPME(bool triclinic) {
         io.posq.push_back(pow(sigma, 3.0) * 2.0*sqrt(epsilon));
         ewaldSelfEnergy += pow(alpha*sigma, 6.0) * epsilon / 3.0;
     }
-    pme.initialize(64, 64, 64, numParticles, alpha, true);
+    pme.initialize(64, 64, 64, numParticles, alpha, true, 5);
     pme.beginComputation(io, boxVectors, true);
     double energy = pme.finishComputation(io);
 
@@ -706,16 +726,94 @@ void testLJPME(bool triclinic) {
         ASSERT_EQUAL_VEC(refState.getForces()[i], Vec3(io.force[4*i], io.force[4*i+1], io.force[4*i+2]), 1e-3);
 }
 
+void testCombinedLJPME(bool triclinic, int dispersionGridSize) {
+    // Create a cloud of random particles.  Some of them have no charge and some have no dispersion coefficient.
+
+    const int numParticles = 51;
+    const double boxWidth = 5.0;
+    const double alpha = 3.1;
+    const double dispersionAlpha = 2.9;
+    const int gridSize = 48;
+    Vec3 boxVectors[3];
+    if (triclinic) {
+        boxVectors[0] = Vec3(boxWidth, 0, 0);
+        boxVectors[1] = Vec3(0.2*boxWidth, boxWidth, 0);
+        boxVectors[2] = Vec3(-0.3*boxWidth, -0.1*boxWidth, boxWidth);
+    }
+    else {
+        boxVectors[0] = Vec3(boxWidth, 0, 0);
+        boxVectors[1] = Vec3(0, boxWidth, 0);
+        boxVectors[2] = Vec3(0, 0, boxWidth);
+    }
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    IO chargeIO, dispersionIO;
+    LJPmeIO combinedIO;
+    for (int i = 0; i < numParticles; i++) {
+        Vec3 pos(boxWidth*genrand_real2(sfmt), boxWidth*genrand_real2(sfmt), boxWidth*genrand_real2(sfmt));
+        float charge = (i%3 == 1 ? 0.0f : (float) (-1.0+i*2.0/(numParticles-1)));
+        float c6 = (i%3 == 2 ? 0.0f : (float) (0.1+0.5*genrand_real2(sfmt)));
+        for (int j = 0; j < 3; j++) {
+            chargeIO.posq.push_back(pos[j]);
+            dispersionIO.posq.push_back(pos[j]);
+            combinedIO.posq.push_back(pos[j]);
+        }
+        chargeIO.posq.push_back(charge);
+        dispersionIO.posq.push_back(c6);
+        combinedIO.posq.push_back(charge);
+        combinedIO.c6.push_back(c6);
+    }
+
+    // Compute the electrostatic and dispersion terms with separate kernels.
+
+    Platform& platform = Platform::getPlatformByName("Reference");
+    CpuCalcPmeReciprocalForceKernel pme(CalcPmeReciprocalForceKernel::Name(), platform);
+    pme.initialize(gridSize, gridSize, gridSize, numParticles, alpha, true, 5);
+    pme.beginComputation(chargeIO, boxVectors, true);
+    double expectedEnergy = pme.finishComputation(chargeIO);
+    CpuCalcDispersionPmeReciprocalForceKernel dpme(CalcDispersionPmeReciprocalForceKernel::Name(), platform);
+    dpme.initialize(dispersionGridSize, dispersionGridSize, dispersionGridSize, numParticles, dispersionAlpha, true, 5);
+    dpme.beginComputation(dispersionIO, boxVectors, true);
+    expectedEnergy += dpme.finishComputation(dispersionIO);
+
+    // Compute them together with the combined kernel.  Evaluate it twice, since the second time it reuses
+    // the reciprocal scale factors.
+
+    CpuCalcLJPmeReciprocalForceKernel ljpme(CalcLJPmeReciprocalForceKernel::Name(), platform);
+    ljpme.initialize(gridSize, gridSize, gridSize, dispersionGridSize, dispersionGridSize, dispersionGridSize, numParticles, alpha, dispersionAlpha, true, 5);
+    for (int repeat = 0; repeat < 2; repeat++) {
+        ljpme.beginComputation(combinedIO, boxVectors, true);
+        double energy = ljpme.finishComputation(combinedIO);
+        ASSERT_EQUAL_TOL(expectedEnergy, energy, 1e-5);
+        for (int i = 0; i < numParticles; i++) {
+            Vec3 expectedForce(chargeIO.force[4*i]+dispersionIO.force[4*i], chargeIO.force[4*i+1]+dispersionIO.force[4*i+1], chargeIO.force[4*i+2]+dispersionIO.force[4*i+2]);
+            ASSERT_EQUAL_VEC(expectedForce, Vec3(combinedIO.force[4*i], combinedIO.force[4*i+1], combinedIO.force[4*i+2]), 1e-4);
+        }
+    }
+    double a;
+    int inx, iny, inz;
+    ljpme.getPMEParameters(a, inx, iny, inz);
+    ASSERT_EQUAL(gridSize, inx);
+    ASSERT_EQUAL_TOL(alpha, a, 1e-10);
+    ljpme.getLJPMEParameters(a, inx, iny, inz);
+    ASSERT_EQUAL(dispersionGridSize, inx);
+    ASSERT_EQUAL_TOL(dispersionAlpha, a, 1e-10);
+}
+
 int main(int argc, char* argv[]) {
     try {
         if (!CpuCalcPmeReciprocalForceKernel::isProcessorSupported()) {
             cout << "CPU is not supported.  Exiting." << endl;
             return 0;
         }
-        testPME(false);
-        testPME(true);
+        testPME(false, 5);
+        for (int order = 4; order <= 8; order++)
+            testPME(true, order);
         testLJPME(false);
         testLJPME(true);
+        testCombinedLJPME(false, 48);
+        testCombinedLJPME(true, 48);
+        testCombinedLJPME(true, 30);
         test_water2_dpme_energies_forces_no_exclusions();
     }
     catch(const exception& e) {
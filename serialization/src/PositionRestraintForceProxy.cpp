@@ -0,0 +1,85 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/PositionRestraintForceProxy.h"
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/Force.h"
+#include "openmm/PositionRestraintForce.h"
+#include <sstream>
+
+using namespace OpenMM;
+using namespace std;
+
+PositionRestraintForceProxy::PositionRestraintForceProxy() : SerializationProxy("PositionRestraintForce") {
+}
+
+void PositionRestraintForceProxy::serialize(const void* object, SerializationNode& node) const {
+    node.setIntProperty("version", 1);
+    const PositionRestraintForce& force = *reinterpret_cast<const PositionRestraintForce*>(object);
+    node.setIntProperty("forceGroup", force.getForceGroup());
+    node.setStringProperty("name", force.getName());
+    node.setBoolProperty("usesPeriodic", force.usesPeriodicBoundaryConditions());
+    node.setStringProperty("scaleParameter", force.getScaleParameterName());
+    node.setDoubleProperty("defaultScale", force.getDefaultScale());
+    SerializationNode& restraints = node.createChildNode("Restraints");
+    for (int i = 0; i < force.getNumRestraints(); i++) {
+        int particle;
+        Vec3 position;
+        double k, radius;
+        force.getRestraintParameters(i, particle, position, k, radius);
+        restraints.createChildNode("Restraint").setIntProperty("p", particle).setDoubleProperty("x", position[0]).setDoubleProperty("y", position[1])
+                .setDoubleProperty("z", position[2]).setDoubleProperty("k", k).setDoubleProperty("r", radius);
+    }
+}
+
+void* PositionRestraintForceProxy::deserialize(const SerializationNode& node) const {
+    int version = node.getIntProperty("version");
+    if (version != 1)
+        throw OpenMMException("Unsupported version number");
+    PositionRestraintForce* force = new PositionRestraintForce();
+    try {
+        force->setForceGroup(node.getIntProperty("forceGroup", 0));
+        force->setName(node.getStringProperty("name", force->getName()));
+        force->setUsesPeriodicBoundaryConditions(node.getBoolProperty("usesPeriodic"));
+        force->setScaleParameterName(node.getStringProperty("scaleParameter"));
+        force->setDefaultScale(node.getDoubleProperty("defaultScale"));
+        const SerializationNode& restraints = node.getChildNode("Restraints");
+        for (auto& restraint : restraints.getChildren()) {
+            Vec3 position(restraint.getDoubleProperty("x"), restraint.getDoubleProperty("y"), restraint.getDoubleProperty("z"));
+            force->addRestraint(restraint.getIntProperty("p"), position, restraint.getDoubleProperty("k"), restraint.getDoubleProperty("r"));
+        }
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
@@ -0,0 +1,93 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/PositionRestraintForce.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <iostream>
+#include <sstream>
+
+using namespace OpenMM;
+using namespace std;
+
+void testSerialization() {
+    // Create a Force.
+
+    PositionRestraintForce force;
+    force.setForceGroup(3);
+    force.setName("custom name");
+    force.setScaleParameterName("scale");
+    force.setDefaultScale(0.5);
+    force.addRestraint(0, Vec3(1.0, 2.0, 3.0), 100.0);
+    force.addRestraint(3, Vec3(-1.0, 0.5, 2.5), 200.0, 0.1);
+    force.addRestraint(1, Vec3(0.0, 0.0, 0.0), 300.0, 0.2);
+    force.setUsesPeriodicBoundaryConditions(true);
+
+    // Serialize and then deserialize it.
+
+    stringstream buffer;
+    XmlSerializer::serialize<PositionRestraintForce>(&force, "Force", buffer);
+    PositionRestraintForce* copy = XmlSerializer::deserialize<PositionRestraintForce>(buffer);
+
+    // Compare the two forces to see if they are identical.
+
+    PositionRestraintForce& force2 = *copy;
+    ASSERT_EQUAL(force.getForceGroup(), force2.getForceGroup());
+    ASSERT_EQUAL(force.getName(), force2.getName());
+    ASSERT_EQUAL(force.getScaleParameterName(), force2.getScaleParameterName());
+    ASSERT_EQUAL(force.getDefaultScale(), force2.getDefaultScale());
+    ASSERT_EQUAL(force.usesPeriodicBoundaryConditions(), force2.usesPeriodicBoundaryConditions());
+    ASSERT_EQUAL(force.getNumRestraints(), force2.getNumRestraints());
+    for (int i = 0; i < force.getNumRestraints(); i++) {
+        int pa, pb;
+        Vec3 xa, xb;
+        double ka, kb, ra, rb;
+        force.getRestraintParameters(i, pa, xa, ka, ra);
+        force2.getRestraintParameters(i, pb, xb, kb, rb);
+        ASSERT_EQUAL(pa, pb);
+        ASSERT_EQUAL_VEC(xa, xb, 0.0);
+        ASSERT_EQUAL(ka, kb);
+        ASSERT_EQUAL(ra, rb);
+    }
+    delete copy;
+}
+
+int main() {
+    try {
+        testSerialization();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -0,0 +1,266 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/PositionRestraintForce.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "sfmt/SFMT.h"
+#include <iostream>
+#include <vector>
+
+using namespace OpenMM;
+using namespace std;
+
+const double TOL = 1e-5;
+
+void testHarmonic() {
+    System system;
+    for (int i = 0; i < 3; i++)
+        system.addParticle(1.0);
+    PositionRestraintForce* force = new PositionRestraintForce();
+    force->addRestraint(0, Vec3(1, 2, 3), 100.0);
+    force->addRestraint(2, Vec3(-1, 0, 0.5), 50.0);
+    system.addForce(force);
+    ASSERT(!force->usesPeriodicBoundaryConditions());
+    ASSERT(!system.usesPeriodicBoundaryConditions());
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(3);
+    positions[0] = Vec3(1.5, 2, 3);
+    positions[1] = Vec3(5, 5, 5);
+    positions[2] = Vec3(-1, 0.2, 0.2);
+    context.setPositions(positions);
+    for (double scale : {1.0, 0.25, 0.0}) {
+        if (scale != 1.0)
+            context.setParameter(force->getScaleParameterName(), scale);
+        State state = context.getState(State::Forces | State::Energy);
+        const vector<Vec3>& forces = state.getForces();
+        ASSERT_EQUAL_VEC(Vec3(-scale*100.0*0.5, 0, 0), forces[0], TOL);
+        ASSERT_EQUAL_VEC(Vec3(0, 0, 0), forces[1], TOL);
+        ASSERT_EQUAL_VEC(Vec3(0, -scale*50.0*0.2, scale*50.0*0.3), forces[2], TOL);
+        ASSERT_EQUAL_TOL(scale*(0.5*100.0*0.5*0.5 + 0.5*50.0*(0.2*0.2+0.3*0.3)), state.getPotentialEnergy(), TOL);
+    }
+}
+
+void testFlatBottom() {
+    System system;
+    system.addParticle(1.0);
+    PositionRestraintForce* force = new PositionRestraintForce();
+    force->setScaleParameterName("k_scale");
+    force->setDefaultScale(2.0);
+    force->addRestraint(0, Vec3(0, 0, 0), 10.0, 0.5);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    ASSERT_EQUAL(2.0, context.getParameter("k_scale"));
+    vector<Vec3> positions(1);
+
+    // Inside the flat bottom there should be no force.
+
+    positions[0] = Vec3(0.1, -0.2, 0.3);
+    context.setPositions(positions);
+    State state = context.getState(State::Forces | State::Energy);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, 0), state.getForces()[0], TOL);
+    ASSERT_EQUAL_TOL(0.0, state.getPotentialEnergy(), TOL);
+
+    // Outside it, the restraint acts on the distance past the radius.
+
+    positions[0] = Vec3(0, 1.2, -1.6);
+    context.setPositions(positions);
+    state = context.getState(State::Forces | State::Energy);
+    double r = 2.0, dr = 1.5;
+    ASSERT_EQUAL_VEC(positions[0]*(-2.0*10.0*dr/r), state.getForces()[0], TOL);
+    ASSERT_EQUAL_TOL(0.5*2.0*10.0*dr*dr, state.getPotentialEnergy(), TOL);
+}
+
+void testPeriodic() {
+    Vec3 vx(5, 0, 0);
+    Vec3 vy(0, 6, 0);
+    Vec3 vz(1, 2, 7);
+    Vec3 ref(51, -17, 11.2);
+    double k = 3.0, radius = 0.5;
+    System system;
+    system.setDefaultPeriodicBoxVectors(vx, vy, vz);
+    system.addParticle(1.0);
+    PositionRestraintForce* force = new PositionRestraintForce();
+    force->addRestraint(0, ref, k, radius);
+    force->setUsesPeriodicBoundaryConditions(true);
+    system.addForce(force);
+    ASSERT(system.usesPeriodicBoundaryConditions());
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    positions[0] = Vec3(0, 2, 0);
+    context.setPositions(positions);
+    for (int i = 0; i < 100; i++) {
+        State state = context.getState(State::Positions | State::Forces | State::Energy);
+
+        // Apply periodic boundary conditions to the difference between the two positions.
+
+        Vec3 delta = ref-state.getPositions()[0];
+        delta -= vz*floor(delta[2]/vz[2]+0.5);
+        delta -= vy*floor(delta[1]/vy[1]+0.5);
+        delta -= vx*floor(delta[0]/vx[0]+0.5);
+
+        // Verify that the force and energy are correct.
+
+        double r = sqrt(delta.dot(delta));
+        double dr = max(0.0, r-radius);
+        ASSERT_EQUAL_VEC(delta*(k*dr/r), state.getForces()[0], TOL);
+        ASSERT_EQUAL_TOL(0.5*k*dr*dr, state.getPotentialEnergy(), TOL);
+        integrator.step(1);
+    }
+}
+
+void testCompareToCustomExternalForce() {
+    // Restrain many particles, some of them more than once, and compare to an equivalent
+    // CustomExternalForce.
+
+    const int numParticles = 500;
+    const double boxSize = 4.0;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    PositionRestraintForce* restraints = new PositionRestraintForce();
+    restraints->setUsesPeriodicBoundaryConditions(true);
+    restraints->setDefaultScale(0.7);
+    CustomExternalForce* custom = new CustomExternalForce("0.5*restraintScale*k*max(0, periodicdistance(x, y, z, x0, y0, z0)-r0)^2");
+    custom->addGlobalParameter("restraintScale", 0.7);
+    custom->addPerParticleParameter("x0");
+    custom->addPerParticleParameter("y0");
+    custom->addPerParticleParameter("z0");
+    custom->addPerParticleParameter("k");
+    custom->addPerParticleParameter("r0");
+    custom->setForceGroup(1);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        positions[i] = Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*boxSize;
+    }
+    for (int i = 0; i < 2*numParticles; i++) {
+        int particle = (i < numParticles ? (i*7)%numParticles : (int) (genrand_real2(sfmt)*numParticles));
+        Vec3 ref = positions[particle] + Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5)*2.0;
+        double k = 100.0*genrand_real2(sfmt);
+        double radius = (i%3 == 0 ? 0.0 : 0.3*genrand_real2(sfmt));
+        restraints->addRestraint(particle, ref, k, radius);
+        custom->addParticle(particle, {ref[0], ref[1], ref[2], k, radius});
+    }
+    system.addForce(restraints);
+    system.addForce(custom);
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    for (double scale : {0.7, 1.3}) {
+        context.setParameter("restraintScale", scale);
+        State state1 = context.getState(State::Forces | State::Energy, false, 1<<0);
+        State state2 = context.getState(State::Forces | State::Energy, false, 1<<1);
+        ASSERT_EQUAL_TOL(state2.getPotentialEnergy(), state1.getPotentialEnergy(), TOL);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state2.getForces()[i], state1.getForces()[i], TOL);
+    }
+}
+
+void testChangingParameters() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    PositionRestraintForce* force = new PositionRestraintForce();
+    force->addRestraint(1, Vec3(0, 0, 0), 10.0);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[0] = Vec3(0, 0, 0);
+    positions[1] = Vec3(1, 0, 0);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(0.5*10.0, context.getState(State::Energy).getPotentialEnergy(), TOL);
+
+    // Change the reference position, force constant, and radius.
+
+    force->setRestraintParameters(0, 1, Vec3(0, 2, 0), 20.0, 1.0);
+    force->updateParametersInContext(context);
+    double dr = sqrt(5.0)-1.0;
+    ASSERT_EQUAL_TOL(0.5*20.0*dr*dr, context.getState(State::Energy).getPotentialEnergy(), TOL);
+
+    // Changing which particle is restrained is not allowed.
+
+    force->setRestraintParameters(0, 0, Vec3(0, 2, 0), 20.0, 1.0);
+    bool threwException = false;
+    try {
+        force->updateParametersInContext(context);
+    }
+    catch (const exception& e) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testIllegalRadius() {
+    System system;
+    system.addParticle(1.0);
+    PositionRestraintForce* force = new PositionRestraintForce();
+    force->addRestraint(0, Vec3(0, 0, 0), 10.0, -1.0);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    bool threwException = false;
+    try {
+        Context(system, integrator, platform);
+    }
+    catch (const exception& e) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void runPlatformTests();
+
+int main(int argc, char* argv[]) {
+    try {
+        initializeTests(argc, argv);
+        testHarmonic();
+        testFlatBottom();
+        testPeriodic();
+        testCompareToCustomExternalForce();
+        testChangingParameters();
+        testIllegalRadius();
+        runPlatformTests();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -20,7 +20,7 @@ from .simulation import Simulation
 from .pdbreporter import PDBReporter, PDBxReporter
 from .amberprmtopfile import AmberPrmtopFile, HCT, OBC1, OBC2, GBn, GBn2
 from .amberinpcrdfile import AmberInpcrdFile
-from .dcdfile import DCDFile
+from .dcdfile import DCDFile, DCDTrajectory
 from .gromacsgrofile import GromacsGroFile
 from .gromacstopfile import GromacsTopFile
 from .dcdreporter import DCDReporter
@@ -117,7 +117,7 @@ class AmberPrmtopFile(object):
             # Get the element from the prmtop file if available
             if prmtop.has_atomic_number:
                 try:
-                    element = elem.Element.getByAtomicNumber(int(prmtop._raw_data['ATOMIC_NUMBER'][index]))
+                    element = elem.Element.getByAtomicNumber(int(prmtop._getArray('ATOMIC_NUMBER', int)[index]))
                 except KeyError:
                     element = None
             else:
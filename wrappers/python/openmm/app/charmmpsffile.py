@@ -38,6 +38,7 @@ from math import pi, cos, sin, sqrt
 import os
 import re
 import sys
+import numpy as np
 import openmm as mm
 from openmm.vec3 import Vec3
 import openmm.unit as u
@@ -46,6 +47,7 @@ from openmm.app.amberprmtopfile import HCT, OBC1, OBC2, GBn, GBn2
 from openmm.app.internal.customgbforces import (GBSAHCTForce,
                 GBSAOBC1Force, GBSAOBC2Force, GBSAGBnForce, GBSAGBn2Force)
 from openmm.app.internal.unitcell import computePeriodicBoxVectors
+from openmm.app.internal import compiled
 # CHARMM imports
 from openmm.app.internal.charmm.topologyobjects import (
                 ResidueList, AtomList, TrackedList, Bond, Angle, Dihedral,
@@ -264,9 +266,7 @@ class CharmmPsfFile(object):
         if len(holder) != nbond * 2:
             raise CharmmPSFError('Got %d indexes for %d bonds' %
                                  (len(holder), nbond))
-        for i in range(nbond):
-            id1 = holder[2*i  ] - 1
-            id2 = holder[2*i+1] - 1
+        for id1, id2 in _indexRows(holder, 2):
             # ignore any bond pair involving Drude or lonepairs: possible using atom's prop
             if (atom_list[id1].name[0]=='D' or atom_list[id2].name[0]=='D'):
                 drudepair_list.append([min(id1,id2), max(id1,id2)])
@@ -285,10 +285,7 @@ class CharmmPsfFile(object):
         if len(holder) != ntheta * 3:
             raise CharmmPSFError('Got %d indexes for %d angles' %
                                  (len(holder), ntheta))
-        for i in range(ntheta):
-            id1 = holder[3*i  ] - 1
-            id2 = holder[3*i+1] - 1
-            id3 = holder[3*i+2] - 1
+        for id1, id2, id3 in _indexRows(holder, 3):
             angle_list.append(
                     Angle(atom_list[id1], atom_list[id2], atom_list[id3])
             )
@@ -300,11 +297,7 @@ class CharmmPsfFile(object):
         if len(holder) != nphi * 4:
             raise CharmmPSFError('Got %d indexes for %d torsions' %
                                  (len(holder), nphi))
-        for i in range(nphi):
-            id1 = holder[4*i  ] - 1
-            id2 = holder[4*i+1] - 1
-            id3 = holder[4*i+2] - 1
-            id4 = holder[4*i+3] - 1
+        for id1, id2, id3, id4 in _indexRows(holder, 4):
             dihedral_list.append(
                     Dihedral(atom_list[id1], atom_list[id2], atom_list[id3],
                              atom_list[id4])
@@ -317,11 +310,7 @@ class CharmmPsfFile(object):
         if len(holder) != nimphi * 4:
             raise CharmmPSFError('Got %d indexes for %d impropers' %
                                  (len(holder), nimphi))
-        for i in range(nimphi):
-            id1 = holder[4*i  ] - 1
-            id2 = holder[4*i+1] - 1
-            id3 = holder[4*i+2] - 1
-            id4 = holder[4*i+3] - 1
+        for id1, id2, id3, id4 in _indexRows(holder, 4):
             improper_list.append(
                     Improper(atom_list[id1], atom_list[id2], atom_list[id3],
                              atom_list[id4])
@@ -334,9 +323,7 @@ class CharmmPsfFile(object):
         if len(holder) != ndon * 2:
             raise CharmmPSFError('Got %d indexes for %d donors' %
                                  (len(holder), ndon))
-        for i in range(ndon):
-            id1 = holder[2*i  ] - 1
-            id2 = holder[2*i+1] - 1
+        for id1, id2 in _indexRows(holder, 2):
             donor_list.append(AcceptorDonor(atom_list[id1], atom_list[id2]))
         donor_list.changed = False
         # Now handle the acceptors (what is this used for??)
@@ -346,9 +333,7 @@ class CharmmPsfFile(object):
         if len(holder) != nacc * 2:
             raise CharmmPSFError('Got %d indexes for %d acceptors' %
                                  (len(holder), ndon))
-        for i in range(nacc):
-            id1 = holder[2*i  ] - 1
-            id2 = holder[2*i+1] - 1
+        for id1, id2 in _indexRows(holder, 2):
             acceptor_list.append(AcceptorDonor(atom_list[id1], atom_list[id2]))
         acceptor_list.changed = False
         # Now get the group sections
@@ -363,10 +348,7 @@ class CharmmPsfFile(object):
         if len(holder) != ngrp * 3:
             raise CharmmPSFError('Got %d indexes for %d groups' %
                                  (len(holder), ngrp))
-        for i in range(ngrp):
-            i1 = holder[3*i  ]
-            i2 = holder[3*i+1]
-            i3 = holder[3*i+2]
+        for i1, i2, i3 in _indexRows(holder, 3, 0):
             group_list.append(Group(i1, i2, i3))
         group_list.changed = False
         # Assign all of the atoms to molecules recursively
@@ -434,15 +416,7 @@ class CharmmPsfFile(object):
         if len(holder) != ncrterm * 8:
             raise CharmmPSFError('Got %d CMAP indexes for %d cmap terms' %
                                  (len(holder), ncrterm))
-        for i in range(ncrterm):
-            id1 = holder[8*i  ] - 1
-            id2 = holder[8*i+1] - 1
-            id3 = holder[8*i+2] - 1
-            id4 = holder[8*i+3] - 1
-            id5 = holder[8*i+4] - 1
-            id6 = holder[8*i+5] - 1
-            id7 = holder[8*i+6] - 1
-            id8 = holder[8*i+7] - 1
+        for id1, id2, id3, id4, id5, id6, id7, id8 in _indexRows(holder, 8):
             cmap_list.append(
                     Cmap(atom_list[id1], atom_list[id2], atom_list[id3],
                          atom_list[id4], atom_list[id5], atom_list[id6],
@@ -546,8 +520,9 @@ class CharmmPsfFile(object):
             If one pointer is set, pointers is simply the integer that is
             value of that pointer. Otherwise it is a tuple with every pointer
             value defined in the first line
-        list
-            A list of all data in the parsed section converted to `dtype'
+        list or numpy.ndarray
+            The lines of the section for the atom, title, and lone pair
+            sections, or an array of the integers in any other section
         """
         conv = CharmmPsfFile._convert
         line = psf.readline()
@@ -581,10 +556,14 @@ class CharmmPsfFile(object):
                 data.append(line)
                 line = psf.readline().strip()
         else:
+            lines = []
             while line:
-                words = line.split()
-                data.extend([conv(w, int, 'PSF data') for w in words])
+                lines.append(line)
                 line = psf.readline().strip()
+            try:
+                data = compiled.readWhitespaceIntegers(lines)
+            except ValueError:
+                raise CharmmPSFError('Could not convert PSF data')
         return title, pointers, data
 
     def loadParameters(self, parmset):
@@ -1669,6 +1648,10 @@ class CharmmPsfFile(object):
 
 # ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
+def _indexRows(holder, width, offset=1):
+    """Split a section of 1-based atom indices into rows of 0-based indices"""
+    return (np.asarray(holder, dtype=np.int64).reshape(-1, width)-offset).tolist()
+
 def set_molecules(atom_list):
     """
     Correctly sets the molecularity of the system based on connectivity
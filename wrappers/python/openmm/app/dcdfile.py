@@ -1,5 +1,5 @@
 """
-dcdfile.py: Used for writing DCD files.
+dcdfile.py: Used for reading and writing DCD files.
 
 This is part of the OpenMM molecular simulation toolkit originating from
 Simbios, the NIH National Center for Physics-Based Simulation of
@@ -33,13 +33,18 @@ __author__ = "Peter Eastman"
 __version__ = "1.0"
 
 import array
+import mmap
 import os
 import time
 import struct
 import math
-from openmm.unit import picoseconds, nanometers, is_quantity, norm
+from openmm.unit import picoseconds, nanometers, is_quantity, norm, Quantity
 from openmm import Vec3
-from openmm.app.internal.unitcell import computeLengthsAndAngles
+from openmm.app.internal.unitcell import computeLengthsAndAngles, computePeriodicBoxVectors
+try:
+    import numpy
+except:
+    numpy = None
 
 class DCDFile(object):
     """DCDFile provides methods for creating DCD files.
@@ -117,33 +122,25 @@ class DCDFile(object):
         periodicBoxVectors : tuple of Vec3=None
             The vectors defining the periodic box.
         """
-        if len(list(self._topology.atoms())) != len(positions):
+        if self._topology.getNumAtoms() != len(positions):
             raise ValueError('The number of positions must match the number of atoms')
         if is_quantity(positions):
             positions = positions.value_in_unit(nanometers)
-        if any(math.isnan(norm(pos)) for pos in positions):
-            raise ValueError('Particle position is NaN')
-        if any(math.isinf(norm(pos)) for pos in positions):
-            raise ValueError('Particle position is infinite')
+        isArray = (numpy is not None and isinstance(positions, numpy.ndarray))
+        if isArray:
+            if numpy.isnan(positions).any():
+                raise ValueError('Particle position is NaN')
+            if numpy.isinf(positions).any():
+                raise ValueError('Particle position is infinite')
+        else:
+            if any(math.isnan(norm(pos)) for pos in positions):
+                raise ValueError('Particle position is NaN')
+            if any(math.isinf(norm(pos)) for pos in positions):
+                raise ValueError('Particle position is infinite')
         file = self._file
 
         self._modelCount += 1
-        if self._interval > 1 and self._firstStep+self._modelCount*self._interval > 1<<31:
-            # This will exceed the range of a 32 bit integer.  To avoid crashing or producing a corrupt file,
-            # update the header to say the trajectory consisted of a smaller number of larger steps (so the
-            # total trajectory length remains correct).
-            self._firstStep //= self._interval
-            self._dt *= self._interval
-            self._interval = 1
-            file.seek(0, os.SEEK_SET)
-            file.write(struct.pack('<i4c9if', 84, b'C', b'O', b'R', b'D', 0, self._firstStep, self._interval, 0, 0, 0, 0, 0, 0, self._dt))
-
-        # Update the header.
-
-        file.seek(8, os.SEEK_SET)
-        file.write(struct.pack('<i', self._modelCount))
-        file.seek(20, os.SEEK_SET)
-        file.write(struct.pack('<i', self._firstStep+self._modelCount*self._interval))
+        (self._firstStep, self._interval, self._dt) = _updateHeader(file, self._modelCount, self._firstStep, self._interval, self._dt)
 
         # Write the data.
 
@@ -156,21 +153,304 @@ class DCDFile(object):
                 if is_quantity(unitCellDimensions):
                     unitCellDimensions = unitCellDimensions.value_in_unit(nanometers)
                 boxVectors = (Vec3(unitCellDimensions[0], 0, 0), Vec3(0, unitCellDimensions[1], 0), Vec3(0, 0, unitCellDimensions[2]))*nanometers
-            (a_length, b_length, c_length, alpha, beta, gamma) = computeLengthsAndAngles(boxVectors)
-            a_length = a_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
-            b_length = b_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
-            c_length = c_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
-            angle1 = math.sin(math.pi/2-gamma)
-            angle2 = math.sin(math.pi/2-beta)
-            angle3 = math.sin(math.pi/2-alpha)
-            file.write(struct.pack('<i6di', 48, a_length, angle1, b_length, angle2, angle3, c_length, 48))
+            file.write(_packBoxVectors(boxVectors))
         length = struct.pack('<i', 4*len(positions))
         for i in range(3):
             file.write(length)
-            data = array.array('f', (10*x[i] for x in positions))
-            data.tofile(file)
+            if isArray:
+                file.write((10*positions[:,i]).astype(numpy.float32).tobytes())
+            else:
+                data = array.array('f', (10*x[i] for x in positions))
+                data.tofile(file)
             file.write(length)
         try:
             file.flush()
         except AttributeError:
             pass
+
+
+class DCDTrajectory(object):
+    """DCDTrajectory provides random access to the frames of an existing DCD file.
+
+    The file is memory mapped, and its header is parsed and validated only once when the object
+    is created.  Any frame can then be retrieved in constant time, either as positions or as a
+    NumPy view directly into the mapped file that does not copy any data.  Frames can also be
+    appended to the end of the file.  The frame count and last step stored in the header are only
+    rewritten when you call updateHeader() or close().  This class determines the number of frames
+    from the size of the file, so a stale count in the header never prevents frames from being read.
+
+    Only files with a single unit cell record (or none) per frame, and without fixed atoms, are supported.
+    This covers files written by DCDFile, CHARMM, and NAMD.
+    """
+
+    def __init__(self, file, append=False):
+        """Open an existing DCD file.
+
+        Parameters
+        ----------
+        file : string
+            the name of the file to open
+        append : bool=False
+            If True, the file is opened for writing so that appendModel() can be called.
+        """
+        if numpy is None:
+            raise ImportError('DCDTrajectory requires numpy')
+        self._file = open(file, 'r+b' if append else 'rb')
+        self._append = append
+        self._map = None
+        try:
+            self._readHeader()
+            if append and self._endian != '<':
+                raise ValueError('Appending to big endian DCD files is not supported')
+        except:
+            self._file.close()
+            raise
+
+    def _readHeader(self):
+        file = self._file
+        header = file.read(100)
+        if len(header) < 100:
+            raise ValueError('File is too short to be a DCD file')
+        for endian in '<>':
+            if struct.unpack(endian+'i', header[:4])[0] == 84:
+                break
+        else:
+            raise ValueError('File is not a DCD file, or uses an unsupported record size')
+        if header[4:8] != b'CORD':
+            raise ValueError('File is not a DCD file containing coordinates')
+        self._endian = endian
+        control = struct.unpack(endian+'9if10i', header[8:88])
+        if struct.unpack(endian+'i', header[88:92])[0] != 84:
+            raise ValueError('Invalid DCD header')
+        self._headerCount = control[0]
+        self._firstStep = control[1]
+        self._interval = control[2]
+        self._numFixedAtoms = control[8]
+        self._dt = control[9]
+        self._hasBox = (control[10] != 0)
+        if control[11] != 0:
+            raise ValueError('DCD files containing four dimensional coordinates are not supported')
+        if self._numFixedAtoms != 0:
+            raise ValueError('DCD files containing fixed atoms are not supported')
+
+        # Skip over the title record, then read the number of atoms.
+
+        titleLength = struct.unpack(endian+'i', header[92:96])[0]
+        offset = 92+4+titleLength
+        file.seek(offset, os.SEEK_SET)
+        if struct.unpack(endian+'i', file.read(4))[0] != titleLength:
+            raise ValueError('Invalid title record in DCD file')
+        (recordLength, numAtoms, recordEnd) = struct.unpack(endian+'3i', file.read(12))
+        if recordLength != 4 or recordEnd != 4:
+            raise ValueError('Invalid atom count record in DCD file')
+        self._numAtoms = numAtoms
+        self._headerSize = offset+16
+        self._boxSize = (56 if self._hasBox else 0)
+        self._axisSize = 4*numAtoms+8
+        self._frameSize = self._boxSize+3*self._axisSize
+
+        # Check the record markers of the first frame.  All frames have the same layout.
+
+        file.seek(0, os.SEEK_END)
+        self._fileSize = file.tell()
+        if self._fileSize >= self._headerSize+self._frameSize:
+            self._remap()
+            start = self._headerSize
+            if self._hasBox and struct.unpack(endian+'i', self._map[start:start+4])[0] != 48:
+                raise ValueError('Invalid unit cell record in DCD file')
+            start += self._boxSize
+            if struct.unpack(endian+'i', self._map[start:start+4])[0] != 4*numAtoms:
+                raise ValueError('Invalid coordinate record in DCD file')
+
+    def _remap(self):
+        # Views that were previously returned keep the old map alive, so it is not closed here.
+        self._map = mmap.mmap(self._file.fileno(), self._fileSize, access=mmap.ACCESS_READ)
+
+    def getNumAtoms(self):
+        """Get the number of atoms in each frame."""
+        return self._numAtoms
+
+    def getNumFrames(self):
+        """Get the number of frames in the file."""
+        return (self._fileSize-self._headerSize)//self._frameSize
+
+    def getTimeStep(self):
+        """Get the time between frames."""
+        return self._dt*self._interval*0.04888821*picoseconds
+
+    def getStep(self, frame):
+        """Get the index of the simulation step at which a frame was written.
+
+        Parameters
+        ----------
+        frame : int
+            the index of the frame
+        """
+        self._checkFrame(frame)
+        return self._firstStep+frame*self._interval
+
+    def _checkFrame(self, frame):
+        numFrames = self.getNumFrames()
+        index = (frame+numFrames if frame < 0 else frame)
+        if index < 0 or index >= numFrames:
+            raise IndexError('Frame index %d is out of range' % frame)
+        if self._map is None or len(self._map) < self._headerSize+(index+1)*self._frameSize:
+            self._remap()
+        return index
+
+    def getFrameView(self, frame):
+        """Get a read-only view of the coordinates of a frame, without copying them.
+
+        Parameters
+        ----------
+        frame : int
+            the index of the frame.  Negative values count back from the end of the file.
+
+        Returns
+        -------
+        numpy.ndarray
+            an array of shape (3, number of atoms) containing the x, y, and z coordinates of
+            every atom in angstroms, exactly as they are stored in the file
+        """
+        frame = self._checkFrame(frame)
+        start = self._headerSize+frame*self._frameSize+self._boxSize+4
+        return numpy.ndarray((3, self._numAtoms), dtype=numpy.dtype(self._endian+'f4'), buffer=self._map,
+                             offset=start, strides=(self._axisSize, 4))
+
+    def getPositions(self, frame=0, asNumpy=False):
+        """Get the atomic positions in a frame.
+
+        Parameters
+        ----------
+        frame : int=0
+            the index of the frame.  Negative values count back from the end of the file.
+        asNumpy : bool=False
+            if true, the values are returned as a numpy array instead of a list of Vec3s
+        """
+        positions = 0.1*self.getFrameView(frame).T.astype(numpy.float64)
+        if asNumpy:
+            return Quantity(positions, nanometers)
+        return Quantity([Vec3(*p) for p in positions.tolist()], nanometers)
+
+    def getPeriodicBoxVectors(self, frame=0):
+        """Get the periodic box vectors for a frame, or None if the file does not contain them.
+
+        Parameters
+        ----------
+        frame : int=0
+            the index of the frame.  Negative values count back from the end of the file.
+        """
+        if not self._hasBox:
+            return None
+        frame = self._checkFrame(frame)
+        start = self._headerSize+frame*self._frameSize+4
+        (a, gamma, b, beta, alpha, c) = struct.unpack(self._endian+'6d', self._map[start:start+48])
+        if all(-1 <= x <= 1 for x in (alpha, beta, gamma)):
+            # The angles are stored as cosines.
+            angles = [math.pi/2-math.asin(x) for x in (alpha, beta, gamma)]
+        else:
+            # Some programs store the angles in degrees.
+            angles = [x*math.pi/180 for x in (alpha, beta, gamma)]
+        return computePeriodicBoxVectors(0.1*a, 0.1*b, 0.1*c, *angles)
+
+    def appendModel(self, positions, periodicBoxVectors=None):
+        """Append a frame to the end of the file.
+
+        The header is not modified.  Call updateHeader() or close() when you are finished
+        appending frames so that other programs will see the correct number of frames.
+
+        Parameters
+        ----------
+        positions : list
+            The list of atomic positions to write
+        periodicBoxVectors : tuple of Vec3=None
+            The vectors defining the periodic box.  This is required if and only if the
+            file contains unit cell information.
+        """
+        if not self._append:
+            raise ValueError('The file was not opened for appending')
+        if is_quantity(positions):
+            positions = positions.value_in_unit(nanometers)
+        positions = numpy.asarray(positions, dtype=numpy.float64)
+        if positions.shape != (self._numAtoms, 3):
+            raise ValueError('The number of positions must match the number of atoms')
+        if not numpy.isfinite(positions).all():
+            raise ValueError('Particle position is NaN or infinite')
+        if self._hasBox != (periodicBoxVectors is not None):
+            raise ValueError('Periodic box vectors must be specified if and only if the file contains unit cell information')
+        data = []
+        if self._hasBox:
+            data.append(_packBoxVectors(periodicBoxVectors))
+        length = struct.pack('<i', 4*self._numAtoms)
+        for i in range(3):
+            data += [length, (10*positions[:,i]).astype('<f4').tobytes(), length]
+        self._file.seek(self._headerSize+self.getNumFrames()*self._frameSize, os.SEEK_SET)
+        self._file.write(b''.join(data))
+        self._file.flush()
+        self._fileSize = self._file.tell()
+
+    def updateHeader(self):
+        """Write the current number of frames to the header of the file."""
+        if not self._append:
+            return
+        numFrames = self.getNumFrames()
+        (self._firstStep, self._interval, self._dt) = _updateHeader(self._file, numFrames, self._firstStep, self._interval, self._dt)
+        self._file.flush()
+        self._headerCount = numFrames
+
+    def close(self):
+        """Close the file.  If it was opened for appending, this first updates the header."""
+        if self._file.closed:
+            return
+        self.updateHeader()
+        self._map = None
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, type, value, traceback):
+        self.close()
+
+    def __len__(self):
+        return self.getNumFrames()
+
+    def __del__(self):
+        if hasattr(self, '_file'):
+            self.close()
+
+
+def _updateHeader(file, numFrames, firstStep, interval, dt):
+    """Write the number of frames and the last step to the header of a DCD file.
+
+    Returns the values of firstStep, interval, and dt, which may have been changed to keep the
+    step numbers within the range of a 32 bit integer.
+    """
+    if interval > 1 and firstStep+numFrames*interval > 1<<31:
+        # This will exceed the range of a 32 bit integer.  To avoid crashing or producing a corrupt file,
+        # update the header to say the trajectory consisted of a smaller number of larger steps (so the
+        # total trajectory length remains correct).
+        firstStep //= interval
+        dt *= interval
+        interval = 1
+        file.seek(12, os.SEEK_SET)
+        file.write(struct.pack('<2i', firstStep, interval))
+        file.seek(44, os.SEEK_SET)
+        file.write(struct.pack('<f', dt))
+    file.seek(8, os.SEEK_SET)
+    file.write(struct.pack('<i', numFrames))
+    file.seek(20, os.SEEK_SET)
+    file.write(struct.pack('<i', firstStep+numFrames*interval))
+    return (firstStep, interval, dt)
+
+
+def _packBoxVectors(boxVectors):
+    """Create the unit cell record that precedes the coordinates of each frame."""
+    (a_length, b_length, c_length, alpha, beta, gamma) = computeLengthsAndAngles(boxVectors)
+    a_length = a_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
+    b_length = b_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
+    c_length = c_length * 10.  # computeLengthsAndAngles returns unitless nanometers, but need angstroms here.
+    angle1 = math.sin(math.pi/2-gamma)
+    angle2 = math.sin(math.pi/2-beta)
+    angle3 = math.sin(math.pi/2-alpha)
+    return struct.pack('<i6di', 48, a_length, angle1, b_length, angle2, angle3, c_length, 48)
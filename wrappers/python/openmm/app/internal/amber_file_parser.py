@@ -45,15 +45,13 @@ import re
 from math import ceil, cos, sin, asin, sqrt
 import warnings
 
-try:
-    import numpy as np
-except:
-    np = None
+import numpy as np
 
 import openmm.unit as units
 import openmm
 from openmm.app import element as elem
 from openmm.app.internal.unitcell import computePeriodicBoxVectors
+from openmm.app.internal import compiled
 from openmm.vec3 import Vec3
 from . import customgbforces as customgb
 
@@ -148,18 +146,46 @@ class PrmtopLoader(object):
                      and not self._raw_data['TITLE']:
                     self._raw_data['TITLE'] = line.rstrip()
                 else:
-                    flag=self._flags[-1]
-                    (format, numItems, itemType,
-                     iLength, itemPrecision) = self._getFormat(flag)
-                    line = line.rstrip()
-                    for index in range(0, len(line), iLength):
-                        item = line[index:index+iLength]
-                        if item:
-                            self._raw_data[flag].append(item.strip())
+                    self._raw_data[self._flags[-1]].append(line)
+        # Now that all lines have been collected, split each section into fields.
+        # Numeric sections are parsed in bulk by compiled code and stored as
+        # NumPy arrays.  Use _getArray() to access them.
+        for flag in self._flags:
+            if flag == 'TITLE' or flag not in self._raw_format:
+                continue
+            (format, numItems, itemType,
+             iLength, itemPrecision) = self._getFormat(flag)
+            lines = self._raw_data[flag]
+            if itemType in ('I', 'E', 'F', 'D'):
+                try:
+                    array = compiled.readFixedWidthArray(lines, iLength, itemType == 'I')
+                except ValueError:
+                    pass
+                else:
+                    self._raw_data[flag] = array
+                    continue
+            items = []
+            for line in lines:
+                line = line.rstrip()
+                for index in range(0, len(line), iLength):
+                    item = line[index:index+iLength]
+                    if item:
+                        items.append(item.strip())
+            self._raw_data[flag] = items
         # See if this is a CHAMBER-style topology file, which is not supported
         # for creating Systems
         self.chamber = 'CTITLE' in self._flags
 
+    def _getArray(self, flag, dtype=float):
+        """Return the contents of a numeric section as a NumPy array"""
+        data = self._raw_data[flag]
+        if not isinstance(data, np.ndarray):
+            # The section could not be parsed by the compiled reader, so convert
+            # the individual fields and store the result for future calls.
+            data = np.array([dtype(x) for x in data], dtype=dtype)
+            self._raw_data[flag] = data
+        return data
+
     def _getFormat(self, flag=None):
         if not flag:
             flag=self._flags[-1]
@@ -203,7 +229,7 @@ class PrmtopLoader(object):
             IFCAP  : set to 1 if the CAP option from edit was specified
         """
         index = POINTER_LABEL_LIST.index(pointerLabel)
-        return float(self._raw_data['POINTERS'][index])
+        return float(self._getArray('POINTERS', int)[index])
 
     def getNumAtoms(self):
         """Return the number of atoms in the system"""
@@ -230,7 +256,7 @@ class PrmtopLoader(object):
         try:
             return self._massList
         except AttributeError:
-            self._massList = [float(x) for x in self._raw_data['MASS']]
+            self._massList = self._getArray('MASS').tolist()
             return self._massList
 
     def getCharges(self):
@@ -238,7 +264,7 @@ class PrmtopLoader(object):
         try:
             return self._chargeList
         except AttributeError:
-            self._chargeList = [float(x)/18.2223 for x in self._raw_data['CHARGE']]
+            self._chargeList = (self._getArray('CHARGE')/18.2223).tolist()
             return self._chargeList
 
     def getAtomName(self, iAtom):
@@ -254,7 +280,7 @@ class PrmtopLoader(object):
         try:
             return self._atomTypeIndexes
         except AttributeError:
-            self._atomTypeIndexes = [int(x) for x in self._raw_data['ATOM_TYPE_INDEX']]
+            self._atomTypeIndexes = self._getArray('ATOM_TYPE_INDEX', int).tolist()
             return self._atomTypeIndexes
 
     def getAtomType(self, iAtom):
@@ -283,19 +309,14 @@ class PrmtopLoader(object):
 
     def _getResiduePointer(self, iAtom):
         try:
-            return self.residuePointerDict[iAtom]
-        except:
+            return self._atomResidues[iAtom]
+        except AttributeError:
             pass
-        self.residuePointerDict = {}
-        resPointers=self._raw_data['RESIDUE_POINTER']
-        firstAtom = [int(p)-1 for p in resPointers]
-        firstAtom.append(self.getNumAtoms())
-        res = 0
-        for i in range(self.getNumAtoms()):
-            while firstAtom[res+1] <= i:
-                res += 1
-            self.residuePointerDict[i] = res
-        return self.residuePointerDict[iAtom]
+        firstAtom = np.append(self._getArray('RESIDUE_POINTER', int)-1, self.getNumAtoms())
+        residueSizes = np.diff(firstAtom)
+        residueSizes[0] += firstAtom[0]
+        self._atomResidues = np.repeat(np.arange(len(residueSizes)), residueSizes).tolist()
+        return self._atomResidues[iAtom]
 
     def getNonbondTerms(self):
         """
@@ -311,42 +332,46 @@ class PrmtopLoader(object):
         except AttributeError:
             pass
         # Check if there are any non-zero HBOND terms
-        for x, y in zip(self._raw_data['HBOND_ACOEF'], self._raw_data['HBOND_BCOEF']):
-            if float(x) or float(y):
-                raise Exception('10-12 interactions are not supported')
-        self._nonbondTerms=[]
+        if np.any(self._getArray('HBOND_ACOEF')) or np.any(self._getArray('HBOND_BCOEF')):
+            raise Exception('10-12 interactions are not supported')
         lengthConversionFactor = units.angstrom.conversion_factor_to(units.nanometer)
         energyConversionFactor = units.kilocalorie_per_mole.conversion_factor_to(units.kilojoule_per_mole)
         numTypes = self.getNumTypes()
-        atomTypeIndexes=self._getAtomTypeIndexes()
-        type_parameters = [(0, 0) for i in range(numTypes)]
-        for iAtom in range(self.getNumAtoms()):
-            index=(numTypes+1)*(atomTypeIndexes[iAtom]-1)
-            nbIndex=int(self._raw_data['NONBONDED_PARM_INDEX'][index])-1
-            if nbIndex<0:
-                raise Exception("10-12 interactions are not supported")
-            acoef = float(self._raw_data['LENNARD_JONES_ACOEF'][nbIndex])
-            bcoef = float(self._raw_data['LENNARD_JONES_BCOEF'][nbIndex])
-            try:
-                rMin = (2*acoef/bcoef)**(1/6.0)
-                epsilon = 0.25*bcoef*bcoef/acoef
-            except ZeroDivisionError:
-                rMin = 1.0
-                epsilon = 0.0
-            type_parameters[atomTypeIndexes[iAtom]-1] = (rMin/2.0, epsilon)
-            rVdw = rMin/2.0*lengthConversionFactor
-            epsilon = epsilon*energyConversionFactor
-            self._nonbondTerms.append( (rVdw, epsilon) )
+        nbParmIndex = self._getArray('NONBONDED_PARM_INDEX', int)
+        acoefList = self._getArray('LENNARD_JONES_ACOEF')
+        bcoefList = self._getArray('LENNARD_JONES_BCOEF')
+
+        # Compute the parameters once for each type that is used by some atom.
+
+        atomTypes = self._getArray('ATOM_TYPE_INDEX', int)-1
+        usedTypes = np.unique(atomTypes)
+        nbIndex = nbParmIndex[(numTypes+1)*usedTypes]-1
+        if np.any(nbIndex < 0):
+            raise Exception("10-12 interactions are not supported")
+        acoef = acoefList[nbIndex]
+        bcoef = bcoefList[nbIndex]
+        valid = (acoef != 0) & (bcoef != 0)
+        safeA = np.where(valid, acoef, 1.0)
+        safeB = np.where(valid, bcoef, 1.0)
+        rMin = np.where(valid, (2*safeA/safeB)**(1/6.0), 1.0)
+        epsilon = np.where(valid, 0.25*safeB*safeB/safeA, 0.0)
+        typeRadius = np.zeros(numTypes)
+        typeEpsilon = np.zeros(numTypes)
+        typeRadius[usedTypes] = rMin/2.0
+        typeEpsilon[usedTypes] = epsilon
+        type_parameters = list(zip(typeRadius.tolist(), typeEpsilon.tolist()))
+        self._nonbondTerms = list(zip((typeRadius[atomTypes]*lengthConversionFactor).tolist(),
+                                      (typeEpsilon[atomTypes]*energyConversionFactor).tolist()))
         # Check if we have any off-diagonal modified LJ terms that would require
         # an NBFIX-like solution
         for i in range(numTypes):
             for j in range(numTypes):
-                index = int(self._raw_data['NONBONDED_PARM_INDEX'][numTypes*i+j]) - 1
+                index = int(nbParmIndex[numTypes*i+j]) - 1
                 if index < 0: continue
                 rij = type_parameters[i][0] + type_parameters[j][0]
                 wdij = sqrt(type_parameters[i][1] * type_parameters[j][1])
-                a = float(self._raw_data['LENNARD_JONES_ACOEF'][index])
-                b = float(self._raw_data['LENNARD_JONES_BCOEF'][index])
+                a = float(acoefList[index])
+                b = float(bcoefList[index])
                 if a == 0 or b == 0:
                     if a != 0 or b != 0 or (wdij != 0 and rij != 0):
                         self._has_nbfix_terms = True
@@ -361,24 +386,21 @@ class PrmtopLoader(object):
                                        'for individual atoms.')
         return self._nonbondTerms
 
-    def _getBonds(self, bondPointers):
-        forceConstant=self._raw_data["BOND_FORCE_CONSTANT"]
-        bondEquil=self._raw_data["BOND_EQUIL_VALUE"]
-        returnList=[]
+    def _getBonds(self, flag):
+        forceConstant=self._getArray("BOND_FORCE_CONSTANT")
+        bondEquil=self._getArray("BOND_EQUIL_VALUE")
         forceConstConversionFactor = (units.kilocalorie_per_mole/(units.angstrom*units.angstrom)).conversion_factor_to(units.kilojoule_per_mole/(units.nanometer*units.nanometer))
         lengthConversionFactor = units.angstrom.conversion_factor_to(units.nanometer)
-        for ii in range(0,len(bondPointers),3):
-             if int(bondPointers[ii])<0 or \
-                int(bondPointers[ii+1])<0:
-                 raise Exception("Found negative bonded atom pointers %s"
-                                 % ((bondPointers[ii],
-                                     bondPointers[ii+1]),))
-             iType=int(bondPointers[ii+2])-1
-             returnList.append((int(bondPointers[ii])//3,
-                                int(bondPointers[ii+1])//3,
-                                float(forceConstant[iType])*forceConstConversionFactor,
-                                float(bondEquil[iType])*lengthConversionFactor))
-        return returnList
+        bondPointers = self._getArray(flag, int).reshape(-1, 3)
+        negative = np.any(bondPointers[:,:2] < 0, axis=1)
+        if np.any(negative):
+            raise Exception("Found negative bonded atom pointers %s"
+                            % (tuple(bondPointers[np.argmax(negative),:2].tolist()),))
+        iType = bondPointers[:,2]-1
+        return list(zip((bondPointers[:,0]//3).tolist(),
+                        (bondPointers[:,1]//3).tolist(),
+                        (forceConstant[iType]*forceConstConversionFactor).tolist(),
+                        (bondEquil[iType]*lengthConversionFactor).tolist()))
 
     def getBondsWithH(self):
         """Return list of bonded atom pairs, K, and Rmin for each bond with a hydrogen"""
@@ -386,8 +408,7 @@ class PrmtopLoader(object):
             return self._bondListWithH
         except AttributeError:
             pass
-        bondPointers=self._raw_data["BONDS_INC_HYDROGEN"]
-        self._bondListWithH = self._getBonds(bondPointers)
+        self._bondListWithH = self._getBonds("BONDS_INC_HYDROGEN")
         return self._bondListWithH
 
 
@@ -397,8 +418,7 @@ class PrmtopLoader(object):
             return self._bondListNoH
         except AttributeError:
             pass
-        bondPointers=self._raw_data["BONDS_WITHOUT_HYDROGEN"]
-        self._bondListNoH = self._getBonds(bondPointers)
+        self._bondListNoH = self._getBonds("BONDS_WITHOUT_HYDROGEN")
         return self._bondListNoH
 
     def getAngles(self):
@@ -407,26 +427,21 @@ class PrmtopLoader(object):
             return self._angleList
         except AttributeError:
             pass
-        forceConstant=self._raw_data["ANGLE_FORCE_CONSTANT"]
-        angleEquil=self._raw_data["ANGLE_EQUIL_VALUE"]
-        anglePointers = self._raw_data["ANGLES_INC_HYDROGEN"] \
-                       +self._raw_data["ANGLES_WITHOUT_HYDROGEN"]
-        self._angleList=[]
+        forceConstant=self._getArray("ANGLE_FORCE_CONSTANT")
+        angleEquil=self._getArray("ANGLE_EQUIL_VALUE")
+        anglePointers = np.concatenate((self._getArray("ANGLES_INC_HYDROGEN", int),
+                                        self._getArray("ANGLES_WITHOUT_HYDROGEN", int))).reshape(-1, 4)
         forceConstConversionFactor = (units.kilocalorie_per_mole/(units.radian*units.radian)).conversion_factor_to(units.kilojoule_per_mole/(units.radian*units.radian))
-        for ii in range(0,len(anglePointers),4):
-             if int(anglePointers[ii])<0 or \
-                int(anglePointers[ii+1])<0 or \
-                int(anglePointers[ii+2])<0:
-                 raise Exception("Found negative angle atom pointers %s"
-                                 % ((anglePointers[ii],
-                                     anglePointers[ii+1],
-                                     anglePointers[ii+2]),))
-             iType=int(anglePointers[ii+3])-1
-             self._angleList.append((int(anglePointers[ii])//3,
-                                int(anglePointers[ii+1])//3,
-                                int(anglePointers[ii+2])//3,
-                                float(forceConstant[iType])*forceConstConversionFactor,
-                                float(angleEquil[iType])))
+        negative = np.any(anglePointers[:,:3] < 0, axis=1)
+        if np.any(negative):
+            raise Exception("Found negative angle atom pointers %s"
+                            % (tuple(anglePointers[np.argmax(negative),:3].tolist()),))
+        iType = anglePointers[:,3]-1
+        self._angleList = list(zip((anglePointers[:,0]//3).tolist(),
+                                   (anglePointers[:,1]//3).tolist(),
+                                   (anglePointers[:,2]//3).tolist(),
+                                   (forceConstant[iType]*forceConstConversionFactor).tolist(),
+                                   angleEquil[iType].tolist()))
         return self._angleList
 
     def getDihedrals(self):
@@ -435,30 +450,30 @@ class PrmtopLoader(object):
             return self._dihedralList
         except AttributeError:
             pass
-        forceConstant=self._raw_data["DIHEDRAL_FORCE_CONSTANT"]
-        phase=self._raw_data["DIHEDRAL_PHASE"]
-        periodicity=self._raw_data["DIHEDRAL_PERIODICITY"]
-        dihedralPointers = self._raw_data["DIHEDRALS_INC_HYDROGEN"] \
-                          +self._raw_data["DIHEDRALS_WITHOUT_HYDROGEN"]
-        self._dihedralList=[]
+        forceConstant=self._getArray("DIHEDRAL_FORCE_CONSTANT")
+        phase=self._getArray("DIHEDRAL_PHASE")
+        periodicity=self._getArray("DIHEDRAL_PERIODICITY")
+        dihedralPointers = self._getDihedralPointers()
         forceConstConversionFactor = (units.kilocalorie_per_mole).conversion_factor_to(units.kilojoule_per_mole)
-        for ii in range(0,len(dihedralPointers),5):
-             if int(dihedralPointers[ii])<0 or int(dihedralPointers[ii+1])<0:
-                 raise Exception("Found negative dihedral atom pointers %s"
-                                 % ((dihedralPointers[ii],
-                                    dihedralPointers[ii+1],
-                                    dihedralPointers[ii+2],
-                                    dihedralPointers[ii+3]),))
-             iType=int(dihedralPointers[ii+4])-1
-             self._dihedralList.append((int(dihedralPointers[ii])//3,
-                                int(dihedralPointers[ii+1])//3,
-                                abs(int(dihedralPointers[ii+2]))//3,
-                                abs(int(dihedralPointers[ii+3]))//3,
-                                float(forceConstant[iType])*forceConstConversionFactor,
-                                float(phase[iType]),
-                                int(0.5+float(periodicity[iType]))))
+        negative = np.any(dihedralPointers[:,:2] < 0, axis=1)
+        if np.any(negative):
+            raise Exception("Found negative dihedral atom pointers %s"
+                            % (tuple(dihedralPointers[np.argmax(negative),:4].tolist()),))
+        iType = dihedralPointers[:,4]-1
+        self._dihedralList = list(zip((dihedralPointers[:,0]//3).tolist(),
+                                      (dihedralPointers[:,1]//3).tolist(),
+                                      (np.abs(dihedralPointers[:,2])//3).tolist(),
+                                      (np.abs(dihedralPointers[:,3])//3).tolist(),
+                                      (forceConstant[iType]*forceConstConversionFactor).tolist(),
+                                      phase[iType].tolist(),
+                                      np.trunc(0.5+periodicity[iType]).astype(int).tolist()))
         return self._dihedralList
 
+    def _getDihedralPointers(self):
+        """Return the dihedral pointers, both with and without hydrogen, as an array of shape (N, 5)"""
+        return np.concatenate((self._getArray("DIHEDRALS_INC_HYDROGEN", int),
+                               self._getArray("DIHEDRALS_WITHOUT_HYDROGEN", int))).reshape(-1, 5)
+
     def getNumMaps(self):
         """Return number of CMAPs. Return 0 if CMAP does not exist"""
         try:
@@ -466,7 +481,7 @@ class PrmtopLoader(object):
         except AttributeError:
             pass
         if "CMAP_COUNT" in self._raw_data.keys():
-            self._numCMAP=int(self._raw_data["CMAP_COUNT"][1])
+            self._numCMAP=int(self._getArray("CMAP_COUNT", int)[1])
             return self._numCMAP
         return 0
 
@@ -477,14 +492,14 @@ class PrmtopLoader(object):
         except AttributeError:
             pass
         if "CMAP_RESOLUTION" in self._raw_data.keys():
-            self._cmapResolution=self._raw_data["CMAP_RESOLUTION"]
+            self._cmapResolution=self._getArray("CMAP_RESOLUTION", int).tolist()
             return self._cmapResolution
         return 0
 
     def getCMAPParameters(self, index):
         """Return list of CMAP energy values"""
         flag="CMAP_PARAMETER_{:02d}".format(index)
-        return [float(pointer) for pointer in self._raw_data[flag]]
+        return self._getArray(flag).tolist()
 
     def getCMAPDihedrals(self):
         """Return CMAP type, list of first four atoms, and list of second four atoms"""
@@ -492,35 +507,32 @@ class PrmtopLoader(object):
             return self._cmapList
         except AttributeError:
             pass
-        cmapPointers = self._raw_data["CMAP_INDEX"]
-        self._cmapList=[]
-        forceConstConversionFactor = (units.kilocalorie_per_mole).conversion_factor_to(units.kilojoule_per_mole)
-        for ii in range(0,len(cmapPointers),6):
-            if any([int(cmapPointers[ii+jj])<0 for jj in range(5)]):
-                raise ValueError("Found negative cmap atom pointers %s"
-                                % ((cmapPointers[ii],
-                                   cmapPointers[ii+1],
-                                   cmapPointers[ii+2],
-                                   cmapPointers[ii+3],
-                                   cmapPointers[ii+4]),))
-            iType=int(cmapPointers[ii+5])-1
-            self._cmapList.append((int(iType),
-                               int(cmapPointers[ii])-1,
-                               int(cmapPointers[ii+1])-1,
-                               int(cmapPointers[ii+2])-1,
-                               int(cmapPointers[ii+3])-1,
-                               int(cmapPointers[ii+1])-1,
-                               int(cmapPointers[ii+2])-1,
-                               int(cmapPointers[ii+3])-1,
-                               int(cmapPointers[ii+4])-1))
+        cmapPointers = self._getArray("CMAP_INDEX", int).reshape(-1, 6)
+        negative = np.any(cmapPointers[:,:5] < 0, axis=1)
+        if np.any(negative):
+            raise ValueError("Found negative cmap atom pointers %s"
+                             % (tuple(cmapPointers[np.argmax(negative),:5].tolist()),))
+        cmapPointers = cmapPointers-1
+        self._cmapList = list(zip(cmapPointers[:,5].tolist(),
+                                  cmapPointers[:,0].tolist(),
+                                  cmapPointers[:,1].tolist(),
+                                  cmapPointers[:,2].tolist(),
+                                  cmapPointers[:,3].tolist(),
+                                  cmapPointers[:,1].tolist(),
+                                  cmapPointers[:,2].tolist(),
+                                  cmapPointers[:,3].tolist(),
+                                  cmapPointers[:,4].tolist()))
         return self._cmapList
 
     def get14Interactions(self):
         """Return list of atom pairs, chargeProduct, rMin and epsilon for each 1-4 interaction"""
-        dihedralPointers = self._raw_data["DIHEDRALS_INC_HYDROGEN"] \
-                          +self._raw_data["DIHEDRALS_WITHOUT_HYDROGEN"]
-        returnList=[]
-        charges=self.getCharges()
+        dihedralPointers = self._getDihedralPointers()
+        dihedralPointers = dihedralPointers[(dihedralPointers[:,2] > 0) & (dihedralPointers[:,3] > 0)]
+        iAtom = dihedralPointers[:,0]//3
+        lAtom = dihedralPointers[:,3]//3
+        iidx = dihedralPointers[:,4]-1
+        charges = np.array(self.getCharges())
+        chargeProd = charges[iAtom]*charges[lAtom]
         try:
             nonbondTerms = self.getNonbondTerms()
         except NbfixPresent:
@@ -529,61 +541,38 @@ class PrmtopLoader(object):
             length_conv = units.angstrom.conversion_factor_to(units.nanometers)
             ene_conv = units.kilocalories_per_mole.conversion_factor_to(
                                 units.kilojoules_per_mole)
-            parm_acoef = [float(x) for x in self._raw_data['LENNARD_JONES_ACOEF']]
-            parm_bcoef = [float(x) for x in self._raw_data['LENNARD_JONES_BCOEF']]
-            nbidx = [int(x) for x in self._raw_data['NONBONDED_PARM_INDEX']]
+            parm_acoef = self._getArray('LENNARD_JONES_ACOEF')
+            parm_bcoef = self._getArray('LENNARD_JONES_BCOEF')
+            nbidx = self._getArray('NONBONDED_PARM_INDEX', int)
             numTypes = self.getNumTypes()
-            atomTypeIndexes=self._getAtomTypeIndexes()
-            for ii in range(0, len(dihedralPointers), 5):
-                if int(dihedralPointers[ii+2])>0 and int(dihedralPointers[ii+3])>0:
-                    iAtom = int(dihedralPointers[ii])//3
-                    lAtom = int(dihedralPointers[ii+3])//3
-                    iidx = int(dihedralPointers[ii+4]) - 1
-                    chargeProd = charges[iAtom]*charges[lAtom]
-                    typ1 = atomTypeIndexes[iAtom] - 1
-                    typ2 = atomTypeIndexes[lAtom] - 1
-                    idx = nbidx[numTypes*typ1+typ2] - 1
-                    if idx < 0: continue
-                    a = parm_acoef[idx]
-                    b = parm_bcoef[idx]
-                    try:
-                        epsilon = b * b / (4 * a) * ene_conv
-                        rMin = (2 * a / b) ** (1/6.0) * length_conv
-                    except ZeroDivisionError:
-                        rMin = 1
-                        epsilon = 0
-                    try:
-                        iScee = float(self._raw_data['SCEE_SCALE_FACTOR'][iidx])
-                    except KeyError:
-                        iScee = 1.2
-                    try:
-                        iScnb = float(self._raw_data['SCNB_SCALE_FACTOR'][iidx])
-                    except KeyError:
-                        iScnb = 2.0
-                    returnList.append((iAtom, lAtom, chargeProd, rMin, epsilon, iScee, iScnb))
+            atomTypeIndexes = self._getArray('ATOM_TYPE_INDEX', int)
+            typ1 = atomTypeIndexes[iAtom] - 1
+            typ2 = atomTypeIndexes[lAtom] - 1
+            idx = nbidx[numTypes*typ1+typ2] - 1
+            keep = (idx >= 0)
+            iAtom, lAtom, iidx, chargeProd, idx = iAtom[keep], lAtom[keep], iidx[keep], chargeProd[keep], idx[keep]
+            a = parm_acoef[idx]
+            b = parm_bcoef[idx]
+            valid = (a != 0) & (b != 0)
+            safeA = np.where(valid, a, 1.0)
+            safeB = np.where(valid, b, 1.0)
+            epsilon = np.where(valid, safeB * safeB / (4 * safeA) * ene_conv, 0.0)
+            rMin = np.where(valid, (2 * safeA / safeB) ** (1/6.0) * length_conv, 1.0)
         else:
             # This block gets hit if NbfixPresent is _not_ caught
-            for ii in range(0,len(dihedralPointers),5):
-                if int(dihedralPointers[ii+2])>0 and int(dihedralPointers[ii+3])>0:
-                    iAtom = int(dihedralPointers[ii])//3
-                    lAtom = int(dihedralPointers[ii+3])//3
-                    iidx = int(dihedralPointers[ii+4]) - 1
-                    chargeProd = charges[iAtom]*charges[lAtom]
-                    (rVdwI, epsilonI) = nonbondTerms[iAtom]
-                    (rVdwL, epsilonL) = nonbondTerms[lAtom]
-                    rMin = (rVdwI+rVdwL)
-                    epsilon = sqrt(epsilonI*epsilonL)
-                    try:
-                        iScee = float(self._raw_data["SCEE_SCALE_FACTOR"][iidx])
-                    except KeyError:
-                        iScee = 1.2
-                    try:
-                        iScnb = float(self._raw_data["SCNB_SCALE_FACTOR"][iidx])
-                    except KeyError:
-                        iScnb = 2.0
-
-                    returnList.append((iAtom, lAtom, chargeProd, rMin, epsilon, iScee, iScnb))
-        return returnList
+            nonbondTerms = np.array(nonbondTerms).reshape(-1, 2)
+            rMin = nonbondTerms[iAtom,0]+nonbondTerms[lAtom,0]
+            epsilon = np.sqrt(nonbondTerms[iAtom,1]*nonbondTerms[lAtom,1])
+        if 'SCEE_SCALE_FACTOR' in self._raw_data:
+            iScee = self._getArray('SCEE_SCALE_FACTOR')[iidx]
+        else:
+            iScee = np.full(len(iidx), 1.2)
+        if 'SCNB_SCALE_FACTOR' in self._raw_data:
+            iScnb = self._getArray('SCNB_SCALE_FACTOR')[iidx]
+        else:
+            iScnb = np.full(len(iidx), 2.0)
+        return list(zip(iAtom.tolist(), lAtom.tolist(), chargeProd.tolist(), rMin.tolist(),
+                        epsilon.tolist(), iScee.tolist(), iScnb.tolist()))
 
     def getExcludedAtoms(self):
         """Return list of lists, giving all pairs of atoms that should have no non-bond interactions"""
@@ -591,29 +580,19 @@ class PrmtopLoader(object):
             return self._excludedAtoms
         except AttributeError:
             pass
-        self._excludedAtoms=[]
-        numExcludedAtomsList=self._raw_data["NUMBER_EXCLUDED_ATOMS"]
-        excludedAtomsList=self._raw_data["EXCLUDED_ATOMS_LIST"]
-        total=0
-        for iAtom in range(self.getNumAtoms()):
-            index0=total
-            n=int(numExcludedAtomsList[iAtom])
-            total+=n
-            index1=total
-            atomList=[]
-            for jAtom in excludedAtomsList[index0:index1]:
-                j=int(jAtom)
-                if j>0:
-                    atomList.append(j-1)
-            self._excludedAtoms.append(atomList)
+        numAtoms = self.getNumAtoms()
+        numExcludedAtoms = self._getArray("NUMBER_EXCLUDED_ATOMS", int)[:numAtoms]
+        excludedAtoms = self._getArray("EXCLUDED_ATOMS_LIST", int)[:np.sum(numExcludedAtoms)]
+        owner = np.repeat(np.arange(numAtoms), numExcludedAtoms)
+        keep = (excludedAtoms > 0)
+        offsets = np.concatenate(([0], np.cumsum(np.bincount(owner[keep], minlength=numAtoms)))).tolist()
+        excluded = (excludedAtoms[keep]-1).tolist()
+        self._excludedAtoms = [excluded[offsets[i]:offsets[i+1]] for i in range(numAtoms)]
         return self._excludedAtoms
 
     def getBoxBetaAndDimensions(self):
         """Return periodic boundary box beta angle and dimensions"""
-        beta=float(self._raw_data["BOX_DIMENSIONS"][0])
-        x=float(self._raw_data["BOX_DIMENSIONS"][1])
-        y=float(self._raw_data["BOX_DIMENSIONS"][2])
-        z=float(self._raw_data["BOX_DIMENSIONS"][3])
+        beta, x, y, z = self._getArray("BOX_DIMENSIONS")[:4].tolist()
         return (units.Quantity(beta, units.degree),
                 units.Quantity(x, units.angstrom),
                 units.Quantity(y, units.angstrom),
@@ -627,6 +606,13 @@ class PrmtopLoader(object):
     def has_atomic_number(self):
         return 'ATOMIC_NUMBER' in self._raw_data
 
+def _typePairTable(prmtop, coefficients):
+    """Expand per type pair coefficients into the flattened numTypes x numTypes table used by a Discrete2DFunction"""
+    numTypes = prmtop.getNumTypes()
+    nbidx = prmtop._getArray('NONBONDED_PARM_INDEX', int)[:numTypes*numTypes].reshape(numTypes, numTypes)-1
+    table = np.where(nbidx >= 0, coefficients[np.maximum(nbidx, 0)], 0.0)
+    return table.T.flatten().tolist()
+
 #=============================================================================================
 # AMBER System builder (based on, but not identical to, systemManager from 'zander')
 #=============================================================================================
@@ -711,7 +697,7 @@ def readAmberSystem(topology, prmtop_filename=None, prmtop_loader=None, shake=No
 
     has_1264 = 'LENNARD_JONES_CCOEF' in prmtop._raw_data.keys()
     if has_1264:
-        parm_ccoef = [float(x) for x in prmtop._raw_data['LENNARD_JONES_CCOEF']]
+        parm_ccoef = prmtop._getArray('LENNARD_JONES_CCOEF')
 
     # Use pyopenmm implementation of OpenMM by default.
     if mm is None:
@@ -883,29 +869,15 @@ def readAmberSystem(topology, prmtop_filename=None, prmtop_loader=None, shake=No
         for charge in prmtop.getCharges():
             force.addParticle(charge, 1.0, 0.0)
         numTypes = prmtop.getNumTypes()
-        parm_acoef = [float(x) for x in prmtop._raw_data['LENNARD_JONES_ACOEF']]
-        parm_bcoef = [float(x) for x in prmtop._raw_data['LENNARD_JONES_BCOEF']]
-        nbidx = [int(x) for x in prmtop._raw_data['NONBONDED_PARM_INDEX']]
-        acoef = [0 for i in range(numTypes*numTypes)]
-        bcoef = acoef[:] # copy
         ene_conv = units.kilocalories_per_mole.conversion_factor_to(units.kilojoules_per_mole)
         length_conv = units.angstroms.conversion_factor_to(units.nanometers)
         afac = sqrt(ene_conv) * length_conv**6
         bfac = ene_conv * length_conv**6
-        for i in range(numTypes):
-            for j in range(numTypes):
-                idx = nbidx[numTypes*i+j] - 1
-                if idx < 0: continue
-                acoef[i+numTypes*j] = sqrt(parm_acoef[idx]) * afac
-                bcoef[i+numTypes*j] = parm_bcoef[idx] * bfac
+        acoef = _typePairTable(prmtop, np.sqrt(prmtop._getArray('LENNARD_JONES_ACOEF')) * afac)
+        bcoef = _typePairTable(prmtop, prmtop._getArray('LENNARD_JONES_BCOEF') * bfac)
         if has_1264:
             cfac = ene_conv * length_conv**4
-            ccoef = [0 for i in range(numTypes*numTypes)]
-            for i in range(numTypes):
-                for j in range(numTypes):
-                    idx = nbidx[numTypes*i+j] - 1
-                    if idx < 0: continue
-                    ccoef[i+numTypes*j] = parm_ccoef[idx] * cfac
+            ccoef = _typePairTable(prmtop, parm_ccoef * cfac)
             cforce = mm.CustomNonbondedForce('(a/r6)^2-b/r6-c/r^4; r6=r^6;'
                                              'a=acoef(type1, type2);'
                                              'b=bcoef(type1, type2);'
@@ -930,16 +902,10 @@ def readAmberSystem(topology, prmtop_filename=None, prmtop_loader=None, shake=No
             force.addParticle(charge, sigma, epsilon)
         if has_1264:
             numTypes = prmtop.getNumTypes()
-            nbidx = [int(x) for x in prmtop._raw_data['NONBONDED_PARM_INDEX']]
-            ccoef = [0 for i in range(numTypes*numTypes)]
             ene_conv = units.kilocalories_per_mole.conversion_factor_to(units.kilojoules_per_mole)
             length_conv = units.angstroms.conversion_factor_to(units.nanometers)
             cfac = ene_conv * length_conv**4
-            for i in range(numTypes):
-                for j in range(numTypes):
-                    idx = nbidx[numTypes*i+j] - 1
-                    if idx < 0: continue
-                    ccoef[i+numTypes*j] = parm_ccoef[idx] * cfac
+            ccoef = _typePairTable(prmtop, parm_ccoef * cfac)
             cforce = mm.CustomNonbondedForce('-c/r^4; c=ccoef(type1, type2)')
             cforce.addTabulatedFunction('ccoef',
                         mm.Discrete2DFunction(numTypes, numTypes, ccoef))
@@ -1090,19 +1056,16 @@ def readAmberSystem(topology, prmtop_filename=None, prmtop_loader=None, shake=No
         # Replace radii and screen, but screen *only* gets replaced by the
         # prmtop contents for HCT, OBC1, and OBC2. GBn and GBn2 both override
         # the prmtop screen factors from LEaP in sander and pmemd
+        standard = np.array([gb_parm[:2] for gb_parm in gb_parms], dtype=float).reshape(-1, 2)
         if gbmodel in ('HCT', 'OBC1', 'OBC2'):
-            screen = [float(s) for s in prmtop._raw_data['SCREEN']]
+            screen = prmtop._getArray('SCREEN')
         else:
-            screen = [gb_parm[1] for gb_parm in gb_parms]
-        radii = [float(r)/10 for r in prmtop._raw_data['RADII']]
-        warned = False
-        for i, (r, s) in enumerate(zip(radii, screen)):
-            if abs(r - gb_parms[i][0]) > 1e-4 or abs(s - gb_parms[i][1]) > 1e-4:
-                if not warned:
-                    warnings.warn(
-                        'Non-optimal GB parameters detected for GB model %s' % gbmodel)
-                    warned = True
-            gb_parms[i][0], gb_parms[i][1] = r, s
+            screen = standard[:,1]
+        radii = prmtop._getArray('RADII')/10
+        if np.any(np.abs(radii-standard[:,0]) > 1e-4) or np.any(np.abs(screen-standard[:,1]) > 1e-4):
+            warnings.warn('Non-optimal GB parameters detected for GB model %s' % gbmodel)
+        for gb_parm, r, s in zip(gb_parms, radii.tolist(), screen.tolist()):
+            gb_parm[0], gb_parm[1] = r, s
 
         for charge, gb_parm in zip(charges, gb_parms):
             if gbmodel == 'OBC2' and implicitSolventKappa == 0:
@@ -36,6 +36,9 @@ __author__ = "Peter Eastman"
 __version__ = "1.0"
 
 from heapq import heappush, heappop
+import numpy as np
+from libc.stdlib cimport strtoll, strtod
+from libc.string cimport memcpy
 
 cdef extern from "math.h":
     double round(double x)
@@ -224,3 +227,101 @@ def _findAtomMatches(templateAtoms, bondedTo, templateBondedTo, matches, hasMatc
                     return True
                 hasMatch[i] = False
     return False
+
+
+def readFixedWidthArray(lines, int width, bint isInteger):
+    """Parse a section of a file in which numbers are stored in fixed width fields, such as
+    the numeric sections of an AMBER prmtop file.  This is used heavily in AmberPrmtopFile.
+
+    Parameters
+    ----------
+    lines : list of str
+        The lines making up the section.  Each one is split into fields of the specified width.
+    width : int
+        The width of each field in characters
+    isInteger : bool
+        If true, the fields are parsed as integers.  Otherwise they are parsed as floating
+        point numbers.
+
+    Returns
+    -------
+    numpy.ndarray
+        an array of type int64 or float64 containing the values in the section
+    """
+    cdef char buffer[64]
+    cdef char* end
+    cdef const char* text
+    cdef Py_ssize_t length, start, fieldLength, i, count
+    if width < 1 or width > 63:
+        raise ValueError('Illegal field width: %d' % width)
+    encoded = [line.rstrip().encode() for line in lines]
+    count = 0
+    for line in encoded:
+        count += (len(line)+width-1)//width
+    result = np.empty(count, dtype=(np.int64 if isInteger else np.float64))
+    cdef long long[:] intValues
+    cdef double[:] floatValues
+    if isInteger:
+        intValues = result
+    else:
+        floatValues = result
+    count = 0
+    for line in encoded:
+        text = line
+        length = len(line)
+        for start in range(0, length, width):
+            fieldLength = min(width, length-start)
+            memcpy(buffer, text+start, fieldLength)
+            buffer[fieldLength] = 0
+            if not isInteger:
+                # Fortran allows D as the exponent character.  strtod() also accepts hexadecimal
+                # values, which are not valid in these files.
+                for i in range(fieldLength):
+                    if buffer[i] == b'D' or buffer[i] == b'd':
+                        buffer[i] = b'E'
+                    elif buffer[i] == b'x' or buffer[i] == b'X':
+                        raise ValueError('Could not parse value: %s' % line[start:start+fieldLength].decode())
+            if isInteger:
+                intValues[count] = strtoll(buffer, &end, 10)
+            else:
+                floatValues[count] = strtod(buffer, &end)
+            while end[0] == b' ':
+                end += 1
+            if end == buffer or end[0] != 0:
+                raise ValueError('Could not parse value: %s' % line[start:start+fieldLength].decode())
+            count += 1
+    return result
+
+
+def readWhitespaceIntegers(lines):
+    """Parse a section of a file that contains integers separated by whitespace, such as the
+    bond, angle, and dihedral sections of a CHARMM PSF file.  This is used heavily in CharmmPsfFile.
+
+    Parameters
+    ----------
+    lines : list of str
+        The lines making up the section
+
+    Returns
+    -------
+    numpy.ndarray
+        an array of type int64 containing all values in the section, in order
+    """
+    cdef const char* text
+    cdef char* end
+    cdef Py_ssize_t count = 0
+    encoded = ' '.join(lines).encode()
+    text = encoded
+    result = np.empty(len(encoded)//2+1, dtype=np.int64)
+    cdef long long[:] values = result
+    while True:
+        while text[0] == b' ' or text[0] == b'\t' or text[0] == b'\n' or text[0] == b'\r':
+            text += 1
+        if text[0] == 0:
+            break
+        values[count] = strtoll(text, &end, 10)
+        if end == text or not (end[0] == 0 or end[0] == b' ' or end[0] == b'\t' or end[0] == b'\n' or end[0] == b'\r'):
+            raise ValueError('Could not parse value: %s' % encoded[text-<const char*>encoded:].split()[0].decode())
+        text = end
+        count += 1
+    return result[:count].copy()
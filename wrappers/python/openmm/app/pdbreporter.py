@@ -95,7 +95,7 @@ class PDBReporter(object):
             PDBFile.writeHeader(simulation.topology, self._out)
             self._topology = simulation.topology
             self._nextModel += 1
-        PDBFile.writeModel(simulation.topology, state.getPositions(), self._out, self._nextModel)
+        PDBFile.writeModel(simulation.topology, state.getPositions(asNumpy=True), self._out, self._nextModel)
         self._nextModel += 1
         if hasattr(self._out, 'flush') and callable(self._out.flush):
             self._out.flush()
@@ -124,7 +124,7 @@ class PDBxReporter(PDBReporter):
         if self._nextModel == 0:
             PDBxFile.writeHeader(simulation.topology, self._out)
             self._nextModel += 1
-        PDBxFile.writeModel(simulation.topology, state.getPositions(), self._out, self._nextModel)
+        PDBxFile.writeModel(simulation.topology, state.getPositions(asNumpy=True), self._out, self._nextModel)
         self._nextModel += 1
         if hasattr(self._out, 'flush') and callable(self._out.flush):
             self._out.flush()
@@ -668,6 +668,14 @@ class Quantity(object):
                 factor_is_identity = True
         except ValueError:
             pass
+        # Lists of Vec3 (such as positions) are the most common large values.  Vec3 is
+        # immutable, so a shallow copy is sufficient, and the elements can be scaled directly.
+        value = _convert_vec3_list(self._value, factor, factor_is_identity)
+        if value is not None:
+            result = Quantity(value, new_unit)
+            if (new_unit.is_dimensionless()):
+                return result._value
+            return result
         if factor_is_identity:
             # No multiplication required
             result = Quantity(copy.deepcopy(self._value), new_unit)
@@ -784,6 +792,32 @@ class Quantity(object):
     # list.sort with a comparison function cannot be done correctly
 
 
+def _convert_vec3_list(value, factor, factor_is_identity):
+    """
+    If value is a nonempty list of Vec3 objects, return a new list in which every element
+    has been multiplied by factor.  This bypasses Vec3.__mul__, which must check whether its
+    argument is a Unit.  Returns None if value is anything else or the factor is not a plain
+    number, in which case the caller should fall back to the general conversion.
+    """
+    if type(value) is not list or len(value) == 0:
+        return None
+    if not factor_is_identity and not isinstance(factor, (int, float)):
+        return None
+    from ..vec3 import Vec3
+    if factor_is_identity:
+        for x in value:
+            if type(x) is not Vec3:
+                return None
+        return list(value)
+    new = tuple.__new__
+    result = []
+    append = result.append
+    for x in value:
+        if type(x) is not Vec3:
+            return None
+        append(new(Vec3, (factor*x[0], factor*x[1], factor*x[2])))
+    return result
+
 def is_quantity(x):
     """
     Returns True if x is a Quantity, False otherwise.
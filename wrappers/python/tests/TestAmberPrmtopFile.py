@@ -432,5 +432,26 @@ class TestAmberPrmtopFile(unittest.TestCase):
                 OpenMM_CMAP_E = simulation.context.getState(getEnergy=True, groups=1<<i).getPotentialEnergy().value_in_unit(kilojoules_per_mole)/conversion
                 self.assertAlmostEqual(OpenMM_CMAP_E, sander_CMAP_E, places=4)
 
+    def testFixedWidthParsing(self):
+        """Test the compiled parser for the numeric sections of prmtop files."""
+        from openmm.app.internal import compiled
+        ints = compiled.readFixedWidthArray(['       1      -2     300', '       4'], 8, True)
+        self.assertEqual([1, -2, 300, 4], ints.tolist())
+        floats = compiled.readFixedWidthArray(['  1.00000000E+00 -2.50000000E-01', '  3.0000000D+00'], 16, False)
+        self.assertEqual([1.0, -0.25, 3.0], floats.tolist())
+        self.assertRaises(ValueError, lambda: compiled.readFixedWidthArray(['       1     abc'], 8, True))
+        self.assertRaises(ValueError, lambda: compiled.readFixedWidthArray(['          0x10p0'], 16, False))
+
+        # The vectorized accessors should agree with the raw data.
+
+        prmtop = prmtop1._prmtop
+        bonds = prmtop.getBondsWithH()
+        pointers = prmtop._getArray('BONDS_INC_HYDROGEN', int)
+        self.assertEqual(len(pointers)//3, len(bonds))
+        for i, bond in enumerate(bonds):
+            self.assertEqual(pointers[3*i]//3, bond[0])
+            self.assertEqual(pointers[3*i+1]//3, bond[1])
+            self.assertAlmostEqual(prmtop._getArray('BOND_EQUIL_VALUE')[pointers[3*i+2]-1]*0.1, bond[3])
+
 if __name__ == '__main__':
     unittest.main()
@@ -584,6 +584,15 @@ class TestCharmmFiles(unittest.TestCase):
             self.assertAlmostEqual(system_charmm.getConstraintParameters(i)[2],
                                    system_openmm.getConstraintParameters(i)[2], delta=1e-7 * nanometers)
 
+    def test_IntegerParsing(self):
+        """Test the compiled parser for the integer sections of PSF files."""
+        from openmm.app.internal import compiled
+        values = compiled.readWhitespaceIntegers(['       1       2      -3', '  40\t5'])
+        self.assertEqual([1, 2, -3, 40, 5], values.tolist())
+        self.assertRaises(ValueError, lambda: compiled.readWhitespaceIntegers(['1 2x 3']))
+        psf = CharmmPsfFile('systems/ala_ala_ala.psf')
+        self.assertEqual(32, len(psf.bond_list))
+
 if __name__ == '__main__':
     unittest.main()
 
@@ -66,6 +66,64 @@ class TestDCDFile(unittest.TestCase):
         del dcd
         os.remove(fname)
 
+    def testRead(self):
+        """Test reading and appending to a trajectory with DCDTrajectory."""
+        fname = tempfile.mktemp(suffix='.dcd')
+        pdb = app.PDBFile('systems/alanine-dipeptide-explicit.pdb')
+        natom = pdb.topology.getNumAtoms()
+        box = pdb.topology.getPeriodicBoxVectors()
+        frames = [[mm.Vec3(random(), random(), random()) for j in range(natom)]*unit.nanometers for i in range(4)]
+        with open(fname, 'wb') as f:
+            dcd = app.DCDFile(f, pdb.topology, 0.002, firstStep=100, interval=10)
+            for positions in frames:
+                dcd.writeModel(positions, periodicBoxVectors=box)
+        with app.DCDTrajectory(fname) as traj:
+            self.assertEqual(natom, traj.getNumAtoms())
+            self.assertEqual(4, traj.getNumFrames())
+            self.assertEqual(120, traj.getStep(2))
+            for i in (3, 0, 2, -3):
+                positions = traj.getPositions(i, asNumpy=True).value_in_unit(unit.nanometers)
+                for p1, p2 in zip(positions, frames[i].value_in_unit(unit.nanometers)):
+                    for j in range(3):
+                        self.assertAlmostEqual(p1[j], p2[j], places=5)
+                view = traj.getFrameView(i)
+                self.assertEqual((3, natom), view.shape)
+                self.assertAlmostEqual(10*frames[i][5][1].value_in_unit(unit.nanometers), view[1,5], places=4)
+                for v1, v2 in zip(traj.getPeriodicBoxVectors(i).value_in_unit(unit.nanometers), box.value_in_unit(unit.nanometers)):
+                    for j in range(3):
+                        self.assertAlmostEqual(v1[j], v2[j], places=5)
+            self.assertRaises(IndexError, lambda: traj.getPositions(4))
+
+        # Append frames and check that they can be read.
+
+        with app.DCDTrajectory(fname, append=True) as traj:
+            for i in range(3):
+                traj.appendModel(frames[i], periodicBoxVectors=box)
+                self.assertEqual(5+i, traj.getNumFrames())
+            positions = traj.getPositions(-1).value_in_unit(unit.nanometers)
+            self.assertAlmostEqual(frames[2][7][2].value_in_unit(unit.nanometers), positions[7][2], places=5)
+        with app.DCDTrajectory(fname) as traj:
+            self.assertEqual(7, traj.getNumFrames())
+            self.assertEqual(7, traj._headerCount)
+        os.remove(fname)
+
+    def testAppendLongTrajectory(self):
+        """Test appending with DCDTrajectory past 2^31 steps."""
+        fname = tempfile.mktemp(suffix='.dcd')
+        pdb = app.PDBFile('systems/alanine-dipeptide-implicit.pdb')
+        positions = [mm.Vec3(random(), random(), random()) for j in range(pdb.topology.getNumAtoms())]*unit.nanometers
+        with open(fname, 'wb') as f:
+            dcd = app.DCDFile(f, pdb.topology, 0.001, interval=1000000000)
+            dcd.writeModel(positions)
+        with app.DCDTrajectory(fname, append=True) as traj:
+            for i in range(4):
+                traj.appendModel(positions)
+        with app.DCDTrajectory(fname) as traj:
+            self.assertEqual(5, traj.getNumFrames())
+            self.assertEqual(4, traj.getStep(4))
+            self.assertAlmostEqual(1000000, traj.getTimeStep().value_in_unit(unit.picoseconds), delta=1)
+        os.remove(fname)
+
 
 if __name__ == '__main__':
     unittest.main()
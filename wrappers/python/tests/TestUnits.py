@@ -261,6 +261,21 @@ class TestUnits(QuantityTestCase):
         x *= u.meters
         self.assertEqual(x, [100, 200, 300] * u.centimeters**2)
 
+    def testVec3ListQuantities(self):
+        """ Tests unit conversion of lists of Vec3 """
+        from openmm import Vec3
+        positions = [Vec3(1.0, 2.0, 3.0), Vec3(-4.0, 5.5, 0.0)] * u.nanometers
+        converted = positions.value_in_unit(u.angstroms)
+        self.assertEqual(converted, [Vec3(10.0, 20.0, 30.0), Vec3(-40.0, 55.0, 0.0)])
+        self.assertTrue(all(isinstance(v, Vec3) for v in converted))
+        # Converting to the same unit returns a copy.
+        same = positions.value_in_unit(u.nanometers)
+        self.assertEqual(same, positions._value)
+        self.assertIsNot(same, positions._value)
+        same[0] = Vec3(0.0, 0.0, 0.0)
+        self.assertEqual(positions[0], Vec3(1.0, 2.0, 3.0)*u.nanometers)
+        self.assertRaises(TypeError, lambda: positions.value_in_unit(u.seconds))
+
     def testReduceUnit(self):
         """ Tests the reduce_unit functionality """
         x = u.nanometer**2 / u.angstrom**2